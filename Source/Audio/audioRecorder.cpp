@@ -52,6 +52,8 @@ bool AudioRecorder::startRecording(std::string filename)
         }
 
         wavHeader.writeHeader(wavFile);
+        writerStop = false;
+        writerThread = std::thread(&AudioRecorder::writerThreadFunc, this);
     }
 
     // calculate buffer size (in samples)
@@ -81,15 +83,45 @@ void AudioRecorder::recordChunk()
     else if (pcm > 0)
     {
         int framesRead = (int)pcm;
-        int bytesPerSample = sizeof(int16_t);
         int samplesRead = framesRead * channels;
-        int bytesRead = samplesRead * bytesPerSample;
 
         if (recordToWav)
+        {
+            // hand the period to the writer and continue in a recycled buffer;
+            // if the writer is 64 periods behind, the oldest one is lost
+            std::vector<int16_t> chunk;
+            if (!freeChunks.tryPop(chunk))
+            {
+                chunk.reserve(buffer.size());
+            }
+            chunk.assign(buffer.begin(), buffer.begin() + samplesRead);
+            filledChunks.pushDropOldest(std::move(chunk));
+        }
+    }
+}
+
+void AudioRecorder::writerThreadFunc()
+{
+    std::vector<std::vector<int16_t>> chunks;
+    while (true)
+    {
+        chunks.clear();
+        // read the flag first: once it is set nothing more is pushed, so an
+        // empty pop after that means everything is written
+        bool stopping = writerStop.load();
+        if (filledChunks.popBatchWait(chunks, 16, std::chrono::milliseconds(100)) == 0)
+        {
+            if (stopping)
+                break;
+            continue;
+        }
+        for (auto &chunk : chunks)
         {
             // write raw bytes to WAV
-            wavFile.write(reinterpret_cast<const char *>(buffer.data()), bytesRead);
+            int bytesRead = chunk.size() * sizeof(int16_t);
+            wavFile.write(reinterpret_cast<const char *>(chunk.data()), bytesRead);
             bytesRecorded += bytesRead;
+            freeChunks.tryPush(std::move(chunk));
         }
     }
 }
@@ -102,6 +134,15 @@ void AudioRecorder::stopRecording()
 
     if (recordToWav)
     {
+        // the writer drains what is queued before it exits
+        writerStop = true;
+        if (writerThread.joinable())
+            writerThread.join();
+
+        auto counters = filledChunks.getCounters();
+        if (counters.dropped > 0)
+            fprintf(stderr, "Writer fell behind, %llu periods lost\n", (unsigned long long)counters.dropped);
+
         wavHeader.finalizeHeader(wavFile, bytesRecorded);
         wavFile.close();
     }
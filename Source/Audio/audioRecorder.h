@@ -1,14 +1,21 @@
 #pragma once
 #include "wavHeader.h"
+#include "Utility/RingQueue.h"
 #include <alsa/asoundlib.h>
+#include <atomic>
 #include <vector>
 #include <memory>
+#include <thread>
 
 #define PCM_MICROPHONE "plughw:3,0"
 
 // Code generated by ChatGPT, edited by me.
 // Assistance in understanding and implementing ALSA recording functionality provided by Github Copilot.
 
+// recordChunk() only reads from ALSA and hands the period to a writer thread,
+// so a slow SD card can never make the capture overrun. Period buffers go
+// round between the two threads through a pair of rings and are reused.
+
 class AudioRecorder
 {
 public:
@@ -19,12 +26,21 @@ public:
     void recordChunk();
     void stopRecording();
     
+private:
+    void writerThreadFunc();
+
 private:
     bool recordToWav = false;
     WAVHeader wavHeader;
     std::ofstream wavFile;
     int bytesRecorded = 0;
 
+    // capture -> writer: filled periods; writer -> capture: empty ones
+    SpscRing<std::vector<int16_t>> filledChunks{ 64 };
+    SpscRing<std::vector<int16_t>> freeChunks{ 64 };
+    std::thread writerThread;
+    std::atomic<bool> writerStop{ false };
+
 private:
     snd_pcm_t* pcmHandle;
     snd_pcm_hw_params_t* params;
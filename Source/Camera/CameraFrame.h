@@ -0,0 +1,38 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+enum class PixelFormat
+{
+    BGR,
+    NV12, // Y plane, then interleaved UV at half resolution
+    I420  // Y plane, then U and V planes at half resolution
+};
+
+// One inference frame plus when it was taken. captureTime/captureWallMs come
+// from the buffer's PTS, i.e. when the sensor delivered the frame rather than
+// when the application got to it, and sequence numbers frames as they leave
+// the camera, so gaps are frames inference never saw. The pixels usually live in a
+// GStreamer buffer that stays mapped until the last FrameRef is dropped, so
+// consumers share one image and must treat it as read-only.
+//
+// Frames stay in the camera's YUV layout. For NV12/I420, image is the single
+// channel height*3/2 x width Mat OpenCV's COLOR_YUV2*_NV12/_I420 conversions
+// expect, so use width/height rather than image.cols/rows for the picture size.
+struct CameraFrame
+{
+    cv::Mat image;
+    PixelFormat format = PixelFormat::BGR;
+    int width = 0;
+    int height = 0;
+    std::chrono::steady_clock::time_point captureTime;
+    int64_t captureWallMs = 0;  // wall clock, milliseconds since epoch
+    int64_t pts = -1;           // running time of the buffer, ns; -1 if the source set none
+    uint64_t sequence = 0;
+};
+
+using FrameRef = std::shared_ptr<const CameraFrame>;
@@ -0,0 +1,418 @@
+#include "ClipRecorder.h"
+
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <json.hpp>
+#include <sstream>
+
+namespace
+{
+int64_t WallNowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+const char* EventTypeName(MetricEventType type)
+{
+    switch (type)
+    {
+    case MetricEventType::Enter:
+        return "enter";
+    case MetricEventType::Pass:
+        return "pass";
+    case MetricEventType::Exit:
+        return "exit";
+    case MetricEventType::ZoneEnter:
+        return "zoneEnter";
+    case MetricEventType::ZoneExit:
+        return "zoneExit";
+    }
+    return "unknown";
+}
+
+// Rebase a timestamp so the clip starts at 0
+GstClockTime Rebase(GstClockTime t, GstClockTime base)
+{
+    if (!GST_CLOCK_TIME_IS_VALID(t))
+    {
+        return t;
+    }
+    return t >= base ? t - base : 0;
+}
+} // namespace
+
+ClipRecorder::ClipRecorder() = default;
+
+ClipRecorder::~ClipRecorder()
+{
+    stop();
+}
+
+void ClipRecorder::setClipCallback(ClipFunc fn)
+{
+    std::lock_guard<std::mutex> lk(callbackMutex);
+    clipCallback = std::move(fn);
+}
+
+void ClipRecorder::start()
+{
+    if (running.load()) return;
+
+    {
+        std::lock_guard<std::mutex> lk(closingMutex);
+        stopRequested = false;
+    }
+    bytesEncoded.store(0);
+    bytesWritten.store(0);
+    running.store(true);
+    finisherThread = std::thread(&ClipRecorder::finisherThreadFunc, this);
+}
+
+void ClipRecorder::stop()
+{
+    if (!running.load()) return;
+
+    {
+        std::lock_guard<std::mutex> lk(clipMutex);
+        takeEvents(WallNowMs());
+        if (clip)
+        {
+            closeClip();
+        }
+        pendingEvents.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lk(closingMutex);
+        stopRequested = true;
+    }
+    closingCondVar.notify_all();
+    if (finisherThread.joinable())
+    {
+        finisherThread.join();
+    }
+
+    clearRing();
+    if (caps)
+    {
+        gst_caps_unref(caps);
+        caps = nullptr;
+    }
+    running.store(false);
+
+    uint64_t encoded = bytesEncoded.load();
+    if (encoded > 0)
+    {
+        std::cerr << "[ClipRecorder] kept " << bytesWritten.load() / 1024 << " KiB of " << encoded / 1024
+                  << " KiB encoded (" << std::fixed << std::setprecision(1)
+                  << 100.0 * static_cast<double>(bytesWritten.load()) / static_cast<double>(encoded) << "%)\n";
+    }
+}
+
+void ClipRecorder::markActivity()
+{
+    lastActivityNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count());
+}
+
+void ClipRecorder::addEvent(const MetricEvent& event)
+{
+    markActivity();
+    eventQueue.pushDropOldest(MetricEvent(event));
+}
+
+void ClipRecorder::takeEvents(int64_t nowMs)
+{
+    MetricEvent event;
+    bool queued = false;
+    while (eventQueue.tryPop(event))
+    {
+        if (clip)
+        {
+            clip->events.push_back(std::move(event));
+        }
+        else
+        {
+            pendingEvents.push_back(std::move(event));
+            queued = true;
+        }
+    }
+    if (queued)
+    {
+        // No clip yet: it opens with a later frame and reaches back preRoll
+        int64_t oldest = nowMs - options.preRoll.count() - options.postRoll.count();
+        pendingEvents.erase(std::remove_if(pendingEvents.begin(), pendingEvents.end(),
+                                           [oldest](const MetricEvent& e) { return e.timestampMs < oldest; }),
+                            pendingEvents.end());
+    }
+}
+
+void ClipRecorder::push(GstSample* sample, int64_t captureWallMs)
+{
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    if (!buffer)
+    {
+        return;
+    }
+    GstCaps* sampleCaps = gst_sample_get_caps(sample);
+    if (sampleCaps && (!caps || !gst_caps_is_equal(caps, sampleCaps)))
+    {
+        if (caps) gst_caps_unref(caps);
+        caps = gst_caps_ref(sampleCaps);
+    }
+
+    Frame frame{ gst_buffer_ref(buffer), Clock::now(), captureWallMs > 0 ? captureWallMs : WallNowMs(),
+                 !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT) };
+    bytesEncoded.fetch_add(gst_buffer_get_size(buffer));
+    ring.push_back(frame);
+    trimRing(frame.arrival);
+
+    int64_t last = lastActivityNs.load();
+    bool active = last != 0 &&
+                  frame.arrival - Clock::time_point(std::chrono::nanoseconds(last)) <= options.postRoll;
+
+    std::lock_guard<std::mutex> lk(clipMutex);
+    takeEvents(frame.wallMs);
+    if (clip)
+    {
+        if (!active)
+        {
+            closeClip();
+            return;
+        }
+        if (frame.keyframe && frame.arrival - clip->started >= options.maxClip)
+        {
+            // Still busy: continue in a new clip from this keyframe, without
+            // repeating the pre-roll the previous clip already holds
+            closeClip();
+            while (ring.size() > 1)
+            {
+                gst_buffer_unref(ring.front().buffer);
+                ring.pop_front();
+            }
+        }
+        else
+        {
+            writeFrame(frame);
+            return;
+        }
+    }
+
+    if (!active || ring.empty() || !ring.front().keyframe || !caps)
+    {
+        return; // a clip can only start on a keyframe
+    }
+    if (!openClip(caps, ring.front()))
+    {
+        return;
+    }
+    for (const Frame& buffered : ring)
+    {
+        writeFrame(buffered);
+    }
+}
+
+void ClipRecorder::trimRing(Clock::time_point now)
+{
+    // Frames ahead of the first keyframe can never start a clip
+    while (!ring.empty() && !ring.front().keyframe)
+    {
+        gst_buffer_unref(ring.front().buffer);
+        ring.pop_front();
+    }
+
+    // Drop whole GOPs while the next one still starts before the pre-roll window
+    const Clock::time_point cutoff = now - options.preRoll;
+    while (true)
+    {
+        size_t next = 1;
+        while (next < ring.size() && !ring[next].keyframe)
+        {
+            ++next;
+        }
+        if (next >= ring.size() || ring[next].arrival > cutoff)
+        {
+            break;
+        }
+        for (size_t i = 0; i < next; ++i)
+        {
+            gst_buffer_unref(ring.front().buffer);
+            ring.pop_front();
+        }
+    }
+}
+
+void ClipRecorder::clearRing()
+{
+    for (Frame& frame : ring)
+    {
+        gst_buffer_unref(frame.buffer);
+    }
+    ring.clear();
+}
+
+bool ClipRecorder::openClip(GstCaps* streamCaps, const Frame& first)
+{
+    std::time_t seconds = static_cast<std::time_t>(first.wallMs / 1000);
+    std::tm tm{};
+    localtime_r(&seconds, &tm);
+    std::ostringstream name;
+    name << "clip_" << std::put_time(&tm, "%Y-%m-%d_%H:%M:%S") << "." << std::setw(3) << std::setfill('0')
+         << first.wallMs % 1000 << ".mp4";
+
+    std::error_code ec;
+    std::filesystem::create_directories(options.directory, ec);
+    auto next = std::make_unique<Clip>();
+    next->path = options.directory + "/" + name.str();
+
+    // The ring holds byte-stream with SPS/PPS on every keyframe; h264parse
+    // turns it into what mp4mux wants
+    std::string description = "appsrc name=src format=time is-live=false max-bytes=0 block=false "
+                              "! h264parse ! mp4mux faststart=true ! filesink location=\"" + next->path + "\" sync=false";
+    GError* error = nullptr;
+    next->pipeline = gst_parse_launch(description.c_str(), &error);
+    if (!next->pipeline)
+    {
+        std::cerr << "[ClipRecorder] Cannot build clip writer: " << (error ? error->message : "unknown error") << std::endl;
+        if (error) g_error_free(error);
+        return false;
+    }
+    if (error) g_error_free(error);
+
+    next->src = GST_APP_SRC(gst_bin_get_by_name(GST_BIN(next->pipeline), "src"));
+    gst_app_src_set_caps(next->src, streamCaps);
+    if (gst_element_set_state(next->pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    {
+        std::cerr << "[ClipRecorder] Cannot start clip writer for " << next->path << std::endl;
+        gst_element_set_state(next->pipeline, GST_STATE_NULL);
+        gst_object_unref(next->src);
+        gst_object_unref(next->pipeline);
+        return false;
+    }
+
+    next->started = first.arrival;
+    next->startMs = first.wallMs;
+    next->endMs = first.wallMs;
+    for (const MetricEvent& event : pendingEvents)
+    {
+        if (event.timestampMs >= next->startMs)
+        {
+            next->events.push_back(event);
+        }
+    }
+    pendingEvents.clear();
+
+    std::cerr << "[ClipRecorder] clip started '" << next->path << "'\n";
+    clip = std::move(next);
+    return true;
+}
+
+void ClipRecorder::writeFrame(const Frame& frame)
+{
+    // Metadata copy only; the encoded bytes are shared with the ring
+    GstBuffer* out = gst_buffer_copy(frame.buffer);
+    if (!GST_CLOCK_TIME_IS_VALID(clip->base))
+    {
+        clip->base = GST_BUFFER_DTS_OR_PTS(out);
+    }
+    GST_BUFFER_PTS(out) = Rebase(GST_BUFFER_PTS(out), clip->base);
+    GST_BUFFER_DTS(out) = Rebase(GST_BUFFER_DTS(out), clip->base);
+
+    size_t size = gst_buffer_get_size(out);
+    if (gst_app_src_push_buffer(clip->src, out) == GST_FLOW_OK)
+    {
+        clip->bytes += size;
+        bytesWritten.fetch_add(size);
+    }
+    clip->endMs = frame.wallMs;
+}
+
+void ClipRecorder::closeClip()
+{
+    gst_app_src_end_of_stream(clip->src);
+    {
+        std::lock_guard<std::mutex> lk(closingMutex);
+        closing.push_back(std::move(clip));
+    }
+    closingCondVar.notify_all();
+}
+
+void ClipRecorder::finisherThreadFunc()
+{
+    std::unique_lock<std::mutex> lk(closingMutex);
+    while (true)
+    {
+        closingCondVar.wait(lk, [this] { return stopRequested || !closing.empty(); });
+        if (closing.empty())
+        {
+            break; // stop requested and nothing left to finish
+        }
+        std::unique_ptr<Clip> done = std::move(closing.front());
+        closing.pop_front();
+        lk.unlock();
+
+        // mp4mux writes the moov (faststart) once EOS reaches it
+        GstBus* bus = gst_element_get_bus(done->pipeline);
+        GstMessage* message = gst_bus_timed_pop_filtered(bus, 10 * GST_SECOND,
+            static_cast<GstMessageType>(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+        bool complete = message && GST_MESSAGE_TYPE(message) == GST_MESSAGE_EOS;
+        if (message) gst_message_unref(message);
+        gst_object_unref(bus);
+        gst_element_set_state(done->pipeline, GST_STATE_NULL);
+        gst_object_unref(done->src);
+        gst_object_unref(done->pipeline);
+
+        if (!complete)
+        {
+            std::cerr << "[ClipRecorder] Clip writer did not finish " << done->path << std::endl;
+        }
+        writeSidecar(*done);
+        std::cerr << "[ClipRecorder] clip closed '" << done->path << "' " << (done->endMs - done->startMs) / 1000
+                  << " s, " << done->bytes / 1024 << " KiB, " << done->events.size() << " events\n";
+        {
+            std::lock_guard<std::mutex> cb(callbackMutex);
+            if (clipCallback)
+            {
+                clipCallback(done->path);
+            }
+        }
+
+        lk.lock();
+    }
+}
+
+bool ClipRecorder::writeSidecar(const Clip& clip)
+{
+    nlohmann::json events = nlohmann::json::array();
+    for (const MetricEvent& event : clip.events)
+    {
+        events.push_back({
+            {"timestampMs", event.timestampMs},
+            {"offsetMs", std::max<int64_t>(0, event.timestampMs - clip.startMs)},
+            {"trackId", event.trackId},
+            {"type", EventTypeName(event.type)},
+            {"zone", event.zone},
+        });
+    }
+    nlohmann::json sidecar = {
+        {"video", std::filesystem::path(clip.path).filename().string()},
+        {"startMs", clip.startMs},
+        {"endMs", clip.endMs},
+        {"bytes", clip.bytes},
+        {"events", events},
+    };
+
+    std::string path = std::filesystem::path(clip.path).replace_extension(".json").string();
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open())
+    {
+        std::cerr << "[ClipRecorder] Cannot write " << path << std::endl;
+        return false;
+    }
+    out << std::setw(4) << sidecar << std::endl;
+    return true;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Metrics/MetricStruct.h"
+#include "Utility/RingQueue.h"
+
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Event-triggered recording. Encoded H.264 access units are kept in a ring
+// covering at least preRoll (trimmed a whole GOP at a time, so it always
+// starts on a keyframe) and thrown away while nobody is in view. Once
+// markActivity() is called, the ring is written out as the head of a clip and
+// every following frame is appended until postRoll has passed without
+// activity. Nothing is re-encoded: clips are muxed from the same bitstream the
+// ring holds.
+//
+// Each clip <name>.mp4 gets a <name>.json sidecar with its wall-clock span and
+// the counting events that happened during it, with their offset into the
+// video, so every counted person can be found in the footage.
+class ClipRecorder
+{
+public:
+    struct Options
+    {
+        std::chrono::milliseconds preRoll{ 5000 };
+        std::chrono::milliseconds postRoll{ 5000 };
+        std::chrono::seconds maxClip{ 600 };         // continue in a new clip past this
+        std::string directory = "build/Data/Videos/Clips";
+    };
+
+    // Called on the clip finisher thread once a clip and its sidecar are on disk
+    using ClipFunc = std::function<void(const std::string& path)>;
+
+public:
+    ClipRecorder();
+    ~ClipRecorder();
+
+    ClipRecorder(const ClipRecorder&) = delete;
+    ClipRecorder& operator=(const ClipRecorder&) = delete;
+
+    void configure(const Options& options) { this->options = options; }
+    void setClipCallback(ClipFunc fn);
+
+    void start();
+    // Close the open clip (if any) and wait for every clip to be finished
+    void stop();
+
+    // One encoded access unit (byte-stream, SPS/PPS in-band) and the wall-clock
+    // time its frame was captured (0 = now); streaming thread
+    void push(GstSample* sample, int64_t captureWallMs = 0);
+    // Someone is in view right now; keeps a clip open for another postRoll
+    void markActivity();
+    // A counting event, linked into the clip that covers it. Queued without a
+    // lock; the streaming thread files it with the next frame.
+    void addEvent(const MetricEvent& event);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Frame
+    {
+        GstBuffer* buffer;
+        Clock::time_point arrival;
+        int64_t wallMs;
+        bool keyframe;
+    };
+
+    struct Clip
+    {
+        GstElement* pipeline = nullptr;
+        GstAppSrc* src = nullptr;
+        std::string path;
+        GstClockTime base = GST_CLOCK_TIME_NONE; // first timestamp, becomes 0 in the file
+        Clock::time_point started;
+        int64_t startMs = 0;
+        int64_t endMs = 0;
+        uint64_t bytes = 0;
+        std::vector<MetricEvent> events;
+    };
+
+    bool openClip(GstCaps* caps, const Frame& first);
+    void writeFrame(const Frame& frame);
+    void closeClip();
+    void trimRing(Clock::time_point now);
+    void takeEvents(int64_t nowMs);
+    void clearRing();
+    void finisherThreadFunc();
+    static bool writeSidecar(const Clip& clip);
+
+private:
+    Options options;
+
+    std::mutex callbackMutex;
+    ClipFunc clipCallback;
+
+    // Streaming thread only
+    std::deque<Frame> ring;
+    GstCaps* caps = nullptr;
+
+    // Counting events on their way from addEvent() to the streaming thread
+    MpmcRing<MetricEvent> eventQueue{ 256 };
+
+    // Open clip, shared by the streaming thread and stop()
+    std::mutex clipMutex;
+    std::unique_ptr<Clip> clip;
+    std::vector<MetricEvent> pendingEvents; // counted before the clip opened
+
+    std::atomic<int64_t> lastActivityNs{ 0 }; // steady clock; 0 = never
+
+    // Clips that got EOS and are waiting for the muxer to finish
+    std::thread finisherThread;
+    std::mutex closingMutex;
+    std::condition_variable closingCondVar;
+    std::deque<std::unique_ptr<Clip>> closing;
+    bool stopRequested = false;
+    std::atomic<bool> running{ false };
+
+    std::atomic<uint64_t> bytesEncoded{ 0 };
+    std::atomic<uint64_t> bytesWritten{ 0 };
+};
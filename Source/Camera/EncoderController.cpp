@@ -0,0 +1,411 @@
+#include "EncoderController.h"
+
+#include <gst/video/video.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+int64_t SteadyNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+gulong AddBufferProbe(GstElement* element, const char* padName, GstPadProbeCallback callback, gpointer user_data)
+{
+    GstPad* pad = gst_element_get_static_pad(element, padName);
+    if (!pad)
+    {
+        return 0;
+    }
+    gulong id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, callback, user_data, nullptr);
+    gst_object_unref(pad);
+    return id;
+}
+} // namespace
+
+EncoderController::~EncoderController()
+{
+    detach();
+}
+
+bool EncoderController::readCpuTimes(uint64_t& idle, uint64_t& total)
+{
+    // First line of /proc/stat: cpu user nice system idle iowait irq softirq steal ...
+    std::ifstream in("/proc/stat");
+    std::string label;
+    if (!(in >> label) || label != "cpu")
+    {
+        return false;
+    }
+    uint64_t value = 0;
+    idle = 0;
+    total = 0;
+    for (int field = 0; field < 8 && (in >> value); ++field)
+    {
+        total += value;
+        if (field == 3 || field == 4)
+        {
+            idle += value;
+        }
+    }
+    return total > 0;
+}
+
+std::string EncoderController::pickPreset()
+{
+    double idle = 0.0;
+    {
+        std::lock_guard<std::mutex> lk(statsMutex);
+        idle = stats.cpuIdle;
+    }
+    if (!running.load())
+    {
+        // No recent sample from the control thread; take a short one
+        uint64_t idle0 = 0, total0 = 0, idle1 = 0, total1 = 0;
+        if (readCpuTimes(idle0, total0))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            if (readCpuTimes(idle1, total1) && total1 > total0)
+            {
+                idle = static_cast<double>(idle1 - idle0) / static_cast<double>(total1 - total0);
+            }
+        }
+    }
+
+    if (idle >= 0.5)
+    {
+        return "veryfast";
+    }
+    if (idle >= 0.3)
+    {
+        return "superfast";
+    }
+    return "ultrafast";
+}
+
+int EncoderController::keyIntMax() const
+{
+    // Counted in frames, so size it for the quiet rate: at busyFps a quiet
+    // scene's 5 fps would stretch the GOP six-fold
+    return std::max(1, static_cast<int>(options.quietKeyInterval.count()) * std::max(1, options.quietFps));
+}
+
+int EncoderController::targetBitrate(double activity) const
+{
+    const int low = std::min(options.quietBitrateKbps, maxBitrateKbps);
+    return low + static_cast<int>(activity * (maxBitrateKbps - low));
+}
+
+int EncoderController::initialBitrateKbps(int maxBitrateKbps) const
+{
+    const int low = std::min(options.quietBitrateKbps, maxBitrateKbps);
+    return liveTracks.load() > 0 ? maxBitrateKbps : low;
+}
+
+void EncoderController::attach(GstElement* queue, GstElement* encoder, int maxBitrateKbps, const std::string& preset)
+{
+    detach();
+    if (!queue || !encoder)
+    {
+        std::cerr << "[EncoderController] Recording branch is missing elements, not steering the encoder" << std::endl;
+        return;
+    }
+
+    this->queue = GST_ELEMENT(gst_object_ref(queue));
+    this->encoder = GST_ELEMENT(gst_object_ref(encoder));
+    this->encoderSrcPad = gst_element_get_static_pad(encoder, "src");
+    this->maxBitrateKbps = maxBitrateKbps;
+
+    framesIn.store(0);
+    framesQueued.store(0);
+    framesDroppedRate.store(0);
+    maxFps.store(options.busyFps);
+    lastPassedPts = GST_CLOCK_TIME_NONE;
+    framesEncoded.store(0);
+    bytesEncoded.store(0);
+    std::pair<GstClockTime, std::chrono::steady_clock::time_point> stale;
+    while (inFlight.tryPop(stale))
+    {
+    }
+    encodeNsSum.store(0);
+    encodeSamples.store(0);
+
+    // Frames entering the leaky queue vs. leaving it tell how many the encoder
+    // could not keep up with
+    AddBufferProbe(queue, "sink", countProbe, &framesIn);
+    AddBufferProbe(queue, "src", rateProbe, this);
+    AddBufferProbe(encoder, "sink", encoderInProbe, this);
+    AddBufferProbe(encoder, "src", encoderOutProbe, this);
+
+    g_object_get(encoder, "bitrate", &appliedBitrate, nullptr);
+    appliedFps = options.busyFps;
+    fpsCap = options.busyFps;
+    lastBytes = 0;
+    lastUpdate = std::chrono::steady_clock::now();
+    lastKeyframe = lastUpdate;
+    wasQuiet = true;
+    readCpuTimes(lastIdle, lastTotal);
+    {
+        std::lock_guard<std::mutex> lk(statsMutex);
+        stats = Stats{};
+        stats.preset = preset;
+        stats.targetBitrateKbps = appliedBitrate;
+        stats.targetFps = appliedFps;
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(wakeMutex);
+        stopRequested = false;
+    }
+    running.store(true);
+    controlThread = std::thread(&EncoderController::controlThreadFunc, this);
+}
+
+void EncoderController::detach()
+{
+    if (running.load())
+    {
+        {
+            std::lock_guard<std::mutex> lk(wakeMutex);
+            stopRequested = true;
+        }
+        wakeCondVar.notify_all();
+        if (controlThread.joinable())
+        {
+            controlThread.join();
+        }
+        running.store(false);
+
+        Stats last = getStats();
+        std::cerr << "[EncoderController] " << last.framesEncoded << " of " << last.framesIn << " frames encoded, "
+                  << last.droppedRate << " dropped for frame rate, " << last.droppedOverload << " for overload\n";
+    }
+
+    // Probes go away with the elements once the branch is torn down
+    if (encoderSrcPad)
+    {
+        gst_object_unref(encoderSrcPad);
+        encoderSrcPad = nullptr;
+    }
+    for (GstElement** element : { &queue, &encoder })
+    {
+        if (*element)
+        {
+            gst_object_unref(*element);
+            *element = nullptr;
+        }
+    }
+}
+
+void EncoderController::setActivity(int liveTracks)
+{
+    this->liveTracks.store(liveTracks);
+    if (liveTracks > 0)
+    {
+        lastTracksNs.store(SteadyNowNs());
+    }
+}
+
+GstPadProbeReturn EncoderController::countProbe(GstPad*, GstPadProbeInfo*, gpointer user_data)
+{
+    static_cast<std::atomic<uint64_t>*>(user_data)->fetch_add(1, std::memory_order_relaxed);
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn EncoderController::rateProbe(GstPad*, GstPadProbeInfo* info, gpointer user_data)
+{
+    auto* self = static_cast<EncoderController*>(user_data);
+    self->framesQueued.fetch_add(1, std::memory_order_relaxed);
+
+    const GstClockTime pts = GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info));
+    const int fps = self->maxFps.load(std::memory_order_relaxed);
+    // At the full rate every frame passes, whatever the camera's timestamp jitter
+    if (fps > 0 && fps < self->options.busyFps && GST_CLOCK_TIME_IS_VALID(pts) &&
+        GST_CLOCK_TIME_IS_VALID(self->lastPassedPts) && pts > self->lastPassedPts)
+    {
+        // A little slack so 5 fps out of 30 keeps every sixth frame
+        const GstClockTime minGap = GST_SECOND / static_cast<GstClockTime>(fps);
+        if (pts - self->lastPassedPts + minGap / 8 < minGap)
+        {
+            self->framesDroppedRate.fetch_add(1, std::memory_order_relaxed);
+            return GST_PAD_PROBE_DROP;
+        }
+    }
+    self->lastPassedPts = pts;
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn EncoderController::encoderInProbe(GstPad*, GstPadProbeInfo* info, gpointer user_data)
+{
+    auto* self = static_cast<EncoderController*>(user_data);
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    self->inFlight.pushDropOldest({ GST_BUFFER_PTS(buffer), std::chrono::steady_clock::now() });
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn EncoderController::encoderOutProbe(GstPad*, GstPadProbeInfo* info, gpointer user_data)
+{
+    auto* self = static_cast<EncoderController*>(user_data);
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    self->framesEncoded.fetch_add(1, std::memory_order_relaxed);
+    self->bytesEncoded.fetch_add(gst_buffer_get_size(buffer), std::memory_order_relaxed);
+
+    const GstClockTime pts = GST_BUFFER_PTS(buffer);
+    const auto now = std::chrono::steady_clock::now();
+    // Frames ahead of this one that never came out were dropped by x264enc
+    std::pair<GstClockTime, std::chrono::steady_clock::time_point> entry;
+    while (self->inFlight.tryPop(entry))
+    {
+        if (entry.first == pts)
+        {
+            self->encodeNsSum.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now - entry.second).count(),
+                std::memory_order_relaxed);
+            self->encodeSamples.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+void EncoderController::controlThreadFunc()
+{
+    std::unique_lock<std::mutex> lk(wakeMutex);
+    while (!wakeCondVar.wait_for(lk, options.interval, [this] { return stopRequested; }))
+    {
+        lk.unlock();
+        update();
+        lk.lock();
+    }
+}
+
+void EncoderController::update()
+{
+    const auto now = std::chrono::steady_clock::now();
+    const double seconds = std::max(1e-3, std::chrono::duration<double>(now - lastUpdate).count());
+    lastUpdate = now;
+
+    // CPU headroom over the last interval
+    double cpuIdle = 1.0;
+    uint64_t idle = 0, total = 0;
+    if (readCpuTimes(idle, total) && total > lastTotal)
+    {
+        cpuIdle = static_cast<double>(idle - lastIdle) / static_cast<double>(total - lastTotal);
+        lastIdle = idle;
+        lastTotal = total;
+    }
+
+    // Scene activity: 0 once nobody has been tracked for quietAfter, otherwise
+    // the share of busyTracks currently in view (at least one track's worth
+    // while people are still around)
+    const int tracks = liveTracks.load();
+    const int64_t lastSeen = lastTracksNs.load();
+    const bool quiet = lastSeen == 0 ||
+                       now - std::chrono::steady_clock::time_point(std::chrono::nanoseconds(lastSeen)) > options.quietAfter;
+    double activity = 0.0;
+    if (!quiet)
+    {
+        const int busyTracks = std::max(1, options.busyTracks);
+        activity = static_cast<double>(std::clamp(tracks, 1, busyTracks)) / busyTracks;
+    }
+
+    // Frame rate: full while anyone is around, but give way to inference when
+    // the CPU runs short, and recover slowly once there is room again
+    if (cpuIdle < options.minIdleShare)
+    {
+        fpsCap = std::max(options.quietFps, fpsCap * 2 / 3);
+    }
+    else if (cpuIdle > 2.0 * options.minIdleShare)
+    {
+        fpsCap = std::min(options.busyFps, fpsCap + std::max(1, fpsCap / 5));
+    }
+    const int fps = std::min(quiet ? options.quietFps : options.busyFps, fpsCap);
+    const int bitrate = targetBitrate(activity);
+    // x264enc budgets bits per frame from the caps rate (busyFps), which the
+    // drop probe leaves untouched; scale the setting up so the frames that do
+    // reach it still add up to the target
+    const int encoderBitrate = static_cast<int>(static_cast<int64_t>(bitrate) * options.busyFps / std::max(1, fps));
+
+    // bitrate is one of the few x264enc properties it picks up while playing
+    if (appliedBitrate == 0 || std::abs(encoderBitrate - appliedBitrate) * 10 > appliedBitrate)
+    {
+        g_object_set(encoder, "bitrate", static_cast<guint>(encoderBitrate), nullptr);
+        appliedBitrate = encoderBitrate;
+    }
+    const bool wokeUp = wasQuiet && !quiet;
+    wasQuiet = quiet;
+    if (fps != appliedFps)
+    {
+        maxFps.store(fps);
+        appliedFps = fps;
+    }
+
+    // Short GOPs only while busy: a keyframe as soon as someone shows up, then
+    // every busyKeyInterval
+    if (!quiet && encoderSrcPad && (wokeUp || now - lastKeyframe >= options.busyKeyInterval))
+    {
+        gst_pad_send_event(encoderSrcPad,
+                           gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, FALSE, 0));
+        lastKeyframe = now;
+    }
+
+    const uint64_t bytes = bytesEncoded.load();
+    // Samples and sum are swapped out separately; a frame landing in between
+    // skews one interval's average by a single frame
+    double encodeMs = 0.0;
+    const uint64_t samples = encodeSamples.exchange(0);
+    const uint64_t ns = encodeNsSum.exchange(0);
+    if (samples > 0)
+    {
+        encodeMs = static_cast<double>(ns) / 1e6 / static_cast<double>(samples);
+    }
+    const uint64_t in = framesIn.load();
+    const uint64_t queued = framesQueued.load();
+
+    std::lock_guard<std::mutex> lk(statsMutex);
+    stats.bitrateKbps = static_cast<double>(bytes - lastBytes) * 8.0 / 1000.0 / seconds;
+    stats.encodeMsPerFrame = encodeMs;
+    stats.cpuIdle = cpuIdle;
+    stats.targetBitrateKbps = bitrate;
+    stats.targetFps = fps;
+    stats.liveTracks = tracks;
+    stats.framesIn = in;
+    stats.framesEncoded = framesEncoded.load();
+    stats.droppedOverload = in > queued ? in - queued : 0;
+    stats.droppedRate = framesDroppedRate.load();
+    lastBytes = bytes;
+}
+
+EncoderController::Stats EncoderController::getStats() const
+{
+    std::lock_guard<std::mutex> lk(statsMutex);
+    return stats;
+}
+
+std::string EncoderController::statsJson() const
+{
+    Stats s = getStats();
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1)
+       << "{\"bitrateKbps\":" << s.bitrateKbps
+       << ",\"cpuIdle\":" << std::setprecision(3) << s.cpuIdle
+       << ",\"droppedOverload\":" << s.droppedOverload
+       << ",\"droppedRate\":" << s.droppedRate
+       << ",\"encodeMsPerFrame\":" << std::setprecision(2) << s.encodeMsPerFrame
+       << ",\"framesEncoded\":" << s.framesEncoded
+       << ",\"framesIn\":" << s.framesIn
+       << ",\"liveTracks\":" << s.liveTracks
+       << ",\"preset\":\"" << s.preset << "\""
+       << ",\"recording\":" << (running.load() ? "true" : "false")
+       << ",\"targetBitrateKbps\":" << s.targetBitrateKbps
+       << ",\"targetFps\":" << s.targetFps
+       << "}";
+    return ss.str();
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Utility/RingQueue.h"
+
+#include <gst/gst.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Steers the recording encoder from scene activity and CPU headroom, once a
+// second on its own thread:
+//   - bitrate (x264enc, changed while playing) scales with the number of live
+//     tracks, from quietBitrateKbps with nobody around up to the recorder's
+//     configured bitrate, and is set scaled by busyFps / fps because x264enc
+//     budgets per frame at the negotiated rate;
+//   - frame rate drops to quietFps when the scene has been empty for
+//     quietAfter, and is capped further while the CPU is short, so the
+//     encoder never competes with inference. Frames are dropped by a probe
+//     behind the branch queue rather than by videorate: changing videorate's
+//     max-rate renegotiates the framerate, which mp4mux refuses mid-file;
+//   - keyframe interval: the encoder is built with key-int-max spanning
+//     quietKeyInterval at quietFps, and keyframes are forced every
+//     busyKeyInterval while people are in view.
+// x264enc cannot change its speed preset while playing, so pickPreset() only
+// chooses one from the current headroom when a recording branch is built.
+class EncoderController
+{
+public:
+    struct Options
+    {
+        int quietBitrateKbps = 300;
+        int quietFps = 5;
+        int busyFps = 30;
+        int busyTracks = 3;                        // live tracks that get the full bitrate
+        std::chrono::seconds quietAfter{ 10 };     // no tracks this long = quiet scene
+        std::chrono::seconds quietKeyInterval{ 10 };
+        std::chrono::seconds busyKeyInterval{ 2 };
+        double minIdleShare = 0.15;                // CPU left over below which frame rate is cut
+        std::chrono::milliseconds interval{ 1000 };
+    };
+
+    struct Stats
+    {
+        double bitrateKbps = 0.0;       // achieved over the last interval
+        double encodeMsPerFrame = 0.0;  // x264enc sink -> src, last interval
+        double cpuIdle = 1.0;           // share of all cores left idle
+        int targetBitrateKbps = 0;
+        int targetFps = 0;
+        int liveTracks = 0;
+        std::string preset;
+        uint64_t framesIn = 0;          // frames that reached the recording branch
+        uint64_t framesEncoded = 0;
+        uint64_t droppedOverload = 0;   // leaky queue: encoder fell behind
+        uint64_t droppedRate = 0;       // frame-rate cap
+    };
+
+public:
+    EncoderController() = default;
+    ~EncoderController();
+
+    EncoderController(const EncoderController&) = delete;
+    EncoderController& operator=(const EncoderController&) = delete;
+
+    void configure(const Options& options) { this->options = options; }
+
+    // Speed preset for an encoder about to be built
+    std::string pickPreset();
+    // key-int-max for that encoder: the quiet keyframe interval at the quiet rate
+    int keyIntMax() const;
+    // Bitrate to build the encoder with (the current target)
+    int initialBitrateKbps(int maxBitrateKbps) const;
+
+    // Start steering a freshly built branch; the elements are referenced until detach()
+    void attach(GstElement* queue, GstElement* encoder, int maxBitrateKbps, const std::string& preset);
+    void detach();
+
+    // Detection thread: people currently tracked
+    void setActivity(int liveTracks);
+
+    Stats getStats() const;
+    std::string statsJson() const;
+
+private:
+    void controlThreadFunc();
+    void update();
+    int targetBitrate(double activity) const;
+    static bool readCpuTimes(uint64_t& idle, uint64_t& total);
+
+    static GstPadProbeReturn countProbe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn rateProbe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn encoderInProbe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn encoderOutProbe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+
+private:
+    Options options;
+
+    GstElement* queue{ nullptr };
+    GstElement* encoder{ nullptr };
+    GstPad* encoderSrcPad{ nullptr };
+    int maxBitrateKbps = 2000;
+
+    std::atomic<int> liveTracks{ 0 };
+    std::atomic<int64_t> lastTracksNs{ 0 };  // steady clock; 0 = never
+
+    // Streaming threads
+    std::atomic<uint64_t> framesIn{ 0 };
+    std::atomic<uint64_t> framesQueued{ 0 };
+    std::atomic<uint64_t> framesDroppedRate{ 0 };
+    std::atomic<int> maxFps{ 30 };
+    GstClockTime lastPassedPts = GST_CLOCK_TIME_NONE;
+    std::atomic<uint64_t> framesEncoded{ 0 };
+    std::atomic<uint64_t> bytesEncoded{ 0 };
+    // Encoder sink pad -> src pad; drop-oldest so frames x264enc skips never pile up
+    SpscRing<std::pair<GstClockTime, std::chrono::steady_clock::time_point>> inFlight{ 64 };
+    std::atomic<uint64_t> encodeNsSum{ 0 };
+    std::atomic<uint64_t> encodeSamples{ 0 };
+
+    // Control thread
+    uint64_t lastIdle = 0;
+    uint64_t lastTotal = 0;
+    uint64_t lastBytes = 0;
+    std::chrono::steady_clock::time_point lastUpdate;
+    std::chrono::steady_clock::time_point lastKeyframe;
+    int fpsCap = 0;
+    bool wasQuiet = true;
+    int appliedBitrate = 0;
+    int appliedFps = 0;
+
+    mutable std::mutex statsMutex;
+    Stats stats;
+
+    std::thread controlThread;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondVar;
+    bool stopRequested = false;
+    std::atomic<bool> running{ false };
+};
@@ -0,0 +1,226 @@
+#include "FragmentUploader.h"
+#include "Metrics/UploadQueue.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <json.hpp>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+uint32_t ReadBE32(const uint8_t* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+uint64_t ReadBE64(const uint8_t* p)
+{
+    return (uint64_t(ReadBE32(p)) << 32) | ReadBE32(p + 4);
+}
+} // namespace
+
+FragmentUploader::~FragmentUploader()
+{
+    if (running.load())
+    {
+        finish();
+    }
+}
+
+bool FragmentUploader::start(const std::string& videoPath, const std::string& videoName)
+{
+    if (running.load()) return false;
+
+    std::error_code ec;
+    std::filesystem::create_directories(stateDirectory, ec);
+
+    state = State{};
+    state.videoPath = videoPath;
+    state.videoName = videoName;
+    statePath = stateDirectory + "/" + videoName + ".json";
+    if (!saveState(statePath, state))
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(stopMutex);
+        stopRequested = false;
+    }
+    running.store(true);
+    tailThread = std::thread(&FragmentUploader::tailThreadFunc, this);
+    return true;
+}
+
+void FragmentUploader::finish()
+{
+    if (!running.load()) return;
+
+    {
+        std::lock_guard<std::mutex> lk(stopMutex);
+        stopRequested = true;
+    }
+    stopCondVar.notify_one();
+    if (tailThread.joinable())
+        tailThread.join();
+
+    queueParts(true);
+    running.store(false);
+}
+
+void FragmentUploader::tailThreadFunc()
+{
+    std::unique_lock<std::mutex> lk(stopMutex);
+    while (!stopCondVar.wait_for(lk, pollInterval, [this] { return stopRequested; }))
+    {
+        lk.unlock();
+        queueParts(false);
+        lk.lock();
+    }
+}
+
+bool FragmentUploader::queueParts(bool lastPart)
+{
+    return queueRemaining(state, statePath, minPartBytes, lastPart);
+}
+
+bool FragmentUploader::queueRemaining(State& state, const std::string& statePath, uint64_t minPartBytes, bool lastPart)
+{
+    int fd = ::open(state.videoPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        // The muxer may not have created the file yet
+        return false;
+    }
+    struct stat st{};
+    fstat(fd, &st);
+    uint64_t end = completeBoxesEnd(fd, state.offset, static_cast<uint64_t>(st.st_size));
+    ::close(fd);
+
+    uint64_t length = end - state.offset;
+    if (!lastPart && length < minPartBytes)
+    {
+        return true;
+    }
+
+    if (length > 0 || lastPart)
+    {
+        UploadQueue::GetInstance().EnqueueVideoPart(state.videoPath, state.videoName, state.nextPart,
+                                                    state.offset, length, lastPart);
+        state.offset = end;
+        ++state.nextPart;
+    }
+
+    if (lastPart)
+    {
+        // Every byte is in the upload journal now; the state file is no longer needed
+        state.final = true;
+        std::error_code ec;
+        std::filesystem::remove(statePath, ec);
+        return true;
+    }
+    return saveState(statePath, state);
+}
+
+uint64_t FragmentUploader::completeBoxesEnd(int fd, uint64_t from, uint64_t fileSize)
+{
+    // Walk top-level boxes: 32-bit big-endian size + fourcc, size 1 means a
+    // 64-bit size follows, size 0 means "to end of file" (never complete while recording).
+    uint8_t header[16];
+    while (from + 8 <= fileSize)
+    {
+        ssize_t n = ::pread(fd, header, sizeof(header), static_cast<off_t>(from));
+        if (n < 8)
+        {
+            break;
+        }
+        uint64_t size = ReadBE32(header);
+        if (size == 1)
+        {
+            if (n < 16)
+            {
+                break;
+            }
+            size = ReadBE64(header + 8);
+        }
+        if (size < 8 || from + size > fileSize)
+        {
+            break;
+        }
+        from += size;
+    }
+    return from;
+}
+
+bool FragmentUploader::loadState(const std::string& path, State& state)
+{
+    std::ifstream in(path);
+    if (!in.is_open()) return false;
+
+    nlohmann::json json = nlohmann::json::parse(in, nullptr, false);
+    if (json.is_discarded()) return false;
+
+    state.videoPath = json.value("path", "");
+    state.videoName = json.value("name", "");
+    state.offset = json.value("offset", uint64_t{ 0 });
+    state.nextPart = json.value("nextPart", 0);
+    state.final = json.value("final", false);
+    return !state.videoPath.empty();
+}
+
+bool FragmentUploader::saveState(const std::string& path, const State& state)
+{
+    nlohmann::json json = {
+        {"path", state.videoPath},
+        {"name", state.videoName},
+        {"offset", state.offset},
+        {"nextPart", state.nextPart},
+        {"final", state.final},
+    };
+
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::trunc);
+        if (!out.is_open())
+        {
+            std::cerr << "[FragmentUploader] Cannot write state file " << tempPath << std::endl;
+            return false;
+        }
+        out << json.dump() << "\n";
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    return !ec;
+}
+
+size_t FragmentUploader::resumePending(const std::string& stateDirectory)
+{
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (!fs::is_directory(stateDirectory, ec)) return 0;
+
+    size_t resumed = 0;
+    for (const auto& entry : fs::directory_iterator(stateDirectory, ec))
+    {
+        if (!entry.is_regular_file() || entry.path().extension() != ".json") continue;
+
+        State state;
+        std::string path = entry.path().string();
+        if (!loadState(path, state) || !fs::exists(state.videoPath))
+        {
+            std::cerr << "[FragmentUploader] Dropping stale state file " << path << std::endl;
+            fs::remove(path, ec);
+            continue;
+        }
+
+        // The recording was cut off: send whatever complete fragments made it to disk
+        std::cout << "[FragmentUploader] Resuming " << state.videoName << " from byte " << state.offset << std::endl;
+        queueRemaining(state, path, 0, true);
+        ++resumed;
+    }
+    return resumed;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Tails a fragmented MP4 while it is being recorded and hands every run of
+// finished top-level boxes (ftyp/moov, then moof/mdat pairs) to the
+// UploadQueue as a numbered part, so an hour of video goes out in small
+// pieces instead of one burst at rollover. Progress is kept in a small state
+// file per recording; resumePending() finishes recordings that were cut off
+// by a crash or power loss.
+class FragmentUploader
+{
+public:
+    FragmentUploader() = default;
+    ~FragmentUploader();
+
+    FragmentUploader(const FragmentUploader&) = delete;
+    FragmentUploader& operator=(const FragmentUploader&) = delete;
+
+    void setMinPartBytes(uint64_t bytes) { minPartBytes = bytes; }
+    void setStateDirectory(const std::string& directory) { stateDirectory = directory; }
+
+    bool start(const std::string& videoPath, const std::string& videoName);
+    // Call once the muxer has finished the file: uploads the tail as the last part.
+    void finish();
+    bool isRunning() const { return running.load(); }
+
+    // Queue the rest of every recording whose state file is not marked final.
+    static size_t resumePending(const std::string& stateDirectory = kDefaultStateDirectory);
+
+    static constexpr const char* kDefaultStateDirectory = "build/Data/Uploads/Parts";
+
+private:
+    struct State
+    {
+        std::string videoPath;
+        std::string videoName;
+        uint64_t offset = 0;  // bytes already queued
+        int nextPart = 0;
+        bool final = false;
+    };
+
+    void tailThreadFunc();
+    // Queue complete boxes past state.offset; lastPart queues even a short tail.
+    bool queueParts(bool lastPart);
+
+    static uint64_t completeBoxesEnd(int fd, uint64_t from, uint64_t fileSize);
+    static bool loadState(const std::string& path, State& state);
+    static bool saveState(const std::string& path, const State& state);
+    static bool queueRemaining(State& state, const std::string& statePath, uint64_t minPartBytes, bool lastPart);
+
+private:
+    uint64_t minPartBytes = 2 * 1024 * 1024;
+    std::chrono::milliseconds pollInterval{ 1000 };
+    std::string stateDirectory = kDefaultStateDirectory;
+
+    State state;
+    std::string statePath;
+
+    std::thread tailThread;
+    std::mutex stopMutex;
+    std::condition_variable stopCondVar;
+    std::atomic<bool> running{ false };
+    bool stopRequested = false;
+};
@@ -1,30 +1,73 @@
 #include "GStreamer.h"
 #include "ImageRec/onnx_classifier.h"
 
+#include <gst/video/video.h>
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <filesystem>
+#include <iomanip>
 #include <iostream>
 #include <memory>
-#include <opencv2/videoio.hpp>
 #include <sstream>
+#include <thread>
 #include <vector>
 #include <wiringPi.h>
 #include <ctime>
 #include <chrono>
+#include <json.hpp>
 
 // For recording
 static const int DEFAULT_BITRATE_KBPS = 2000;
 
+// Capture restarts: first attempt at once, then back off up to the maximum
+static const std::chrono::milliseconds RESTART_BACKOFF_MIN(500);
+static const std::chrono::milliseconds RESTART_BACKOFF_MAX(30000);
+// How long a restart waits for the caller to drop frames of the failed pipeline
+static const std::chrono::milliseconds RESTART_RELEASE_WAIT(2000);
+
+GStreamer::GStreamer()
+{
+    gst_init(nullptr, nullptr);
+    recorder = std::make_unique<GstRecorder>();
+}
+
+GStreamer::~GStreamer()
+{
+    closeCapture();
+}
+
 bool GStreamer::openCapture(CaptureBackend backend, int w, int h, int fps)
 {
     std::string pipeline;
 
+    // Also forgets the pipeline a restart would rebuild
+    closeCapture();
+
     this->w = w;
     this->h = h;
     this->fps = fps;
 
+    inferenceSize = cv::Size();
+    if (inferenceBox.width > 0 && inferenceBox.height > 0 && (w > inferenceBox.width || h > inferenceBox.height))
+    {
+        // Even sizes: 4:2:0 chroma is subsampled in both directions
+        double scale = std::min(static_cast<double>(inferenceBox.width) / w, static_cast<double>(inferenceBox.height) / h);
+        inferenceSize = cv::Size(std::max(2, static_cast<int>(w * scale) & ~1), std::max(2, static_cast<int>(h * scale) & ~1));
+    }
+
     if (backend == CaptureBackend::LIBCAMERA)
     {
+        if (!inferenceSize.empty())
+        {
+            if (open_capture_with_pipeline(gst_pipeline_libcamera_dual()))
+            {
+                std::cout << "[GStreamer] Recording " << w << "x" << h << ", inference " << inferenceSize.width << "x"
+                          << inferenceSize.height << " from the camera's second stream\n";
+                return true;
+            }
+            std::cerr << "[GStreamer] Camera has no second stream; scaling inference frames in the pipeline\n";
+        }
         pipeline = gst_pipeline_libcamera();
     }
     else // V4L2
@@ -32,36 +75,383 @@ bool GStreamer::openCapture(CaptureBackend backend, int w, int h, int fps)
         pipeline = gst_pipeline_v4l2();
     }
 
-    return open_capture_with_pipeline(pipeline);
+    return open_capture_with_pipeline(pipeline + gst_pipeline_branches());
+}
+
+void GStreamer::closeCapture()
+{
+    // Deliberately closed: nothing to restart
+    releaseCapture();
+    capturePipeline.clear();
+    restartPending = false;
+    releasePending = false;
+    {
+        std::lock_guard<std::mutex> lock(healthMutex);
+        health.restarting = false;
+    }
+}
+
+void GStreamer::releaseCapture()
+{
+    // The recording branch lives in the pipeline; finish the file first. The
+    // bus thread has to run until then to see the last segment close.
+    stopRecording();
+    stopBusThread();
+    if (pendingSample)
+    {
+        gst_sample_unref(pendingSample);
+        pendingSample = nullptr;
+    }
+    if (pipeline)
+    {
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+    }
+    if (appsink)
+    {
+        gst_object_unref(appsink);
+        appsink = nullptr;
+    }
+    if (tee)
+    {
+        gst_object_unref(tee);
+        tee = nullptr;
+    }
+    if (pipeline)
+    {
+        gst_object_unref(pipeline);
+        pipeline = nullptr;
+    }
+    recorder->attach(nullptr, nullptr);
+}
+
+FrameRef GStreamer::captureFrame()
+{
+    if (capturePipeline.empty())
+    {
+        return nullptr;
+    }
+    if (!restartPending && captureFailed.load())
+    {
+        beginRestart();
+        return nullptr;
+    }
+    if (releasePending)
+    {
+        // Frames still map buffers of the failed pipeline: the caller publishes
+        // the nullptr it got, then the detector finishes with its frame. Tear the
+        // pipeline down only after that, or after RESTART_RELEASE_WAIT at worst.
+        const int held = mappedFrames->load();
+        if (held > 0 && std::chrono::steady_clock::now() - failedAt < RESTART_RELEASE_WAIT)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            return nullptr;
+        }
+        if (held > 0)
+        {
+            std::cerr << "[GStreamer] " << held << " frame(s) of the failed pipeline still held; releasing it anyway\n";
+        }
+        releasePending = false;
+        // Closes the recording file so far; the bus thread sees it finish
+        releaseCapture();
+    }
+    if (restartPending && !tryRestart())
+    {
+        return nullptr;
+    }
+
+    GstSample* sample = pendingSample;
+    pendingSample = nullptr;
+    if (!sample)
+    {
+        sample = gst_app_sink_try_pull_sample(appsink, 2 * GST_SECOND);
+    }
+    if (!sample)
+    {
+        // A camera that stops delivering often posts nothing on the bus
+        markCaptureFailed(gst_app_sink_is_eos(appsink) ? "end of stream" : "no frame for 2 s");
+        beginRestart();
+        return nullptr;
+    }
+    return wrapSample(sample);
+}
+
+void GStreamer::markCaptureFailed(const std::string& reason)
+{
+    {
+        std::lock_guard<std::mutex> lock(healthMutex);
+        health.lastError = reason;
+    }
+    captureFailed.store(true);
+}
+
+void GStreamer::beginRestart()
+{
+    std::string reason;
+    {
+        std::lock_guard<std::mutex> lock(healthMutex);
+        ++health.failures;
+        health.restarting = true;
+        reason = health.lastError;
+    }
+    std::cerr << "[GStreamer] Capture failed (" << reason << "); restarting the pipeline\n";
+
+    restartPending = true;
+    restartAttempts = 0;
+    failedAt = std::chrono::steady_clock::now();
+    nextRestartAt = failedAt;
+    resumeRecording = isRecording();
+    // The next captureFrame() calls release the old pipeline once the caller
+    // has let go of its frames
+    releasePending = true;
+}
+
+// One rebuild attempt once the backoff has passed. Runs on the captureFrame()
+// thread so nothing else is using the appsink while it is replaced.
+bool GStreamer::tryRestart()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now < nextRestartAt)
+    {
+        // Keep the caller's loop from spinning, but let it look at its exit conditions
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(nextRestartAt - now,
+                                                                                  std::chrono::milliseconds(200)));
+        return false;
+    }
+
+    ++restartAttempts;
+    if (!open_capture_with_pipeline(capturePipeline))
+    {
+        auto backoff = std::min<std::chrono::milliseconds>(RESTART_BACKOFF_MAX,
+                                                           RESTART_BACKOFF_MIN * (1 << std::min(restartAttempts - 1, 6)));
+        nextRestartAt = std::chrono::steady_clock::now() + backoff;
+        {
+            std::lock_guard<std::mutex> lock(healthMutex);
+            ++health.failedAttempts;
+        }
+        std::cerr << "[GStreamer] Restart attempt " << restartAttempts << " failed; retrying in "
+                  << backoff.count() << " ms\n";
+        return false;
+    }
+
+    // open_capture_with_pipeline() only succeeds once a frame has arrived
+    double recoveryMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - failedAt).count();
+    restartPending = false;
+    {
+        std::lock_guard<std::mutex> lock(healthMutex);
+        ++health.restarts;
+        health.restarting = false;
+        health.lastRecoveryMs = recoveryMs;
+        health.maxRecoveryMs = std::max(health.maxRecoveryMs, recoveryMs);
+        health.totalRecoveryMs += recoveryMs;
+    }
+    std::cout << "[GStreamer] Capture recovered in " << static_cast<int64_t>(recoveryMs) << " ms after "
+              << restartAttempts << " attempt(s)\n";
+
+    if (resumeRecording && recordingLocation && !recorder->start(recordingLocation, bitrate_kbps))
+    {
+        std::cerr << "[GStreamer Error] Failed to resume recording after restart.\n";
+    }
+    return true;
 }
 
-cv::Mat GStreamer::captureFrame()
+GStreamer::CaptureHealth GStreamer::captureHealth() const
 {
-    cv::Mat frame;
-    if (!cap->read(frame) || frame.empty())
+    std::lock_guard<std::mutex> lock(healthMutex);
+    return health;
+}
+
+std::string GStreamer::captureHealthJson() const
+{
+    CaptureHealth h = captureHealth();
+    nlohmann::json j;
+    j["failedAttempts"] = h.failedAttempts;
+    j["failures"] = h.failures;
+    j["lastError"] = h.lastError;
+    j["lastRecoveryMs"] = h.lastRecoveryMs;
+    j["maxRecoveryMs"] = h.maxRecoveryMs;
+    j["meanRecoveryMs"] = h.restarts > 0 ? h.totalRecoveryMs / h.restarts : 0.0;
+    j["qosDropped"] = h.qosDropped;
+    j["qosMessages"] = h.qosMessages;
+    j["restarting"] = h.restarting;
+    j["restarts"] = h.restarts;
+    return j.dump();
+}
+
+namespace
+{
+// The planes of a mapped NV12/I420 buffer, as the single height*3/2 x width
+// Mat OpenCV uses for those formats. Most buffers already have that layout and
+// are wrapped in place; padded ones (e.g. height aligned to 16 rows) are copied.
+// NV12 keeps its layout with any row stride, but OpenCV's I420 conversions
+// pack two w/2 chroma rows into each w-wide Mat row, so I420 is only wrapped
+// when its rows are unpadded.
+cv::Mat WrapYuvPlanes(const GstVideoInfo& info, uint8_t* data, bool& copied)
+{
+    const int w = GST_VIDEO_INFO_WIDTH(&info);
+    const int h = GST_VIDEO_INFO_HEIGHT(&info);
+    const bool nv12 = GST_VIDEO_INFO_FORMAT(&info) == GST_VIDEO_FORMAT_NV12;
+    const int stride = GST_VIDEO_INFO_PLANE_STRIDE(&info, 0);
+    const size_t yBytes = static_cast<size_t>(stride) * h;
+
+    bool packed = GST_VIDEO_INFO_PLANE_OFFSET(&info, 0) == 0 && GST_VIDEO_INFO_PLANE_OFFSET(&info, 1) == yBytes;
+    if (nv12)
+    {
+        packed = packed && GST_VIDEO_INFO_PLANE_STRIDE(&info, 1) == stride;
+    }
+    else
     {
-        throw std::runtime_error("Failed to read frame from GStreamer capture.");
+        packed = packed && stride == w && stride % 2 == 0 &&
+                 GST_VIDEO_INFO_PLANE_STRIDE(&info, 1) == stride / 2 &&
+                 GST_VIDEO_INFO_PLANE_STRIDE(&info, 2) == stride / 2 &&
+                 GST_VIDEO_INFO_PLANE_OFFSET(&info, 2) == yBytes + yBytes / 4;
+    }
+    copied = !packed;
+    if (packed)
+    {
+        return cv::Mat(h * 3 / 2, w, CV_8UC1, data, stride);
     }
-    writeFrame(frame);
 
-    return frame;
+    cv::Mat planes(h * 3 / 2, w, CV_8UC1);
+    auto copyPlane = [&](int plane, uint8_t* dst, int rows, int rowBytes, size_t dstStride)
+    {
+        const uint8_t* src = data + GST_VIDEO_INFO_PLANE_OFFSET(&info, plane);
+        const int srcStride = GST_VIDEO_INFO_PLANE_STRIDE(&info, plane);
+        for (int y = 0; y < rows; ++y)
+        {
+            std::memcpy(dst + y * dstStride, src + static_cast<size_t>(y) * srcStride, rowBytes);
+        }
+    };
+    copyPlane(0, planes.data, h, w, w);
+    if (nv12)
+    {
+        copyPlane(1, planes.ptr(h), h / 2, w, w);
+    }
+    else
+    {
+        copyPlane(1, planes.ptr(h), h / 2, w / 2, w / 2);
+        copyPlane(2, planes.ptr(h) + (w / 2) * (h / 2), h / 2, w / 2, w / 2);
+    }
+    return planes;
 }
 
-void GStreamer::writeFrame(const cv::Mat& frame)
+// How long ago the buffer was captured, from its PTS against the pipeline
+// clock. Sources stamp buffers with their capture time (libcamerasrc uses the
+// sensor timestamp), so this covers the ISP, conversion and the appsink queue.
+bool CaptureAge(GstElement* pipeline, GstSample* sample, GstBuffer* buffer, GstClockTime& runningTime,
+                GstClockTimeDiff& age)
 {
-    if (!isRecording() || frame.empty())
-        return;
+    const GstSegment* segment = gst_sample_get_segment(sample);
+    if (!segment || !GST_BUFFER_PTS_IS_VALID(buffer))
+    {
+        return false;
+    }
+    runningTime = gst_segment_to_running_time(segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+    GstClock* clock = gst_element_get_clock(pipeline);
+    if (!clock || !GST_CLOCK_TIME_IS_VALID(runningTime))
+    {
+        if (clock) gst_object_unref(clock);
+        return false;
+    }
+    age = GST_CLOCK_DIFF(gst_element_get_base_time(pipeline) + runningTime, gst_clock_get_time(clock));
+    gst_object_unref(clock);
+    // A source with a different idea of time would give nonsense; fall back to arrival
+    return age >= 0 && age < 10 * GST_SECOND;
+}
+} // namespace
+
+FrameRef GStreamer::wrapSample(GstSample* sample)
+{
+    // Map the appsink buffer and keep it mapped for as long as any FrameRef to
+    // it lives: no copy between GStreamer and the detector.
+    struct MappedSample
+    {
+        GstSample* sample;
+        GstBuffer* buffer;
+        GstMapInfo map;
+        CameraFrame frame;
+    };
+
+    GstVideoInfo info;
+    GstCaps* caps = gst_sample_get_caps(sample);
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    if (!caps || !buffer || !gst_video_info_from_caps(&info, caps))
+    {
+        gst_sample_unref(sample);
+        return nullptr;
+    }
 
-    if (frame.size() != cv::Size(w, h))
+    auto* mapped = new MappedSample{ sample, buffer, {}, {} };
+    if (!gst_buffer_map(buffer, &mapped->map, GST_MAP_READ))
     {
-        cv::Mat resized;
-        cv::resize(frame, resized, cv::Size(w, h));
-        recorder->pushFrame(resized);
-        //writer->write(resized);
+        gst_sample_unref(sample);
+        delete mapped;
+        return nullptr;
+    }
+
+    CameraFrame& frame = mapped->frame;
+    frame.width = GST_VIDEO_INFO_WIDTH(&info);
+    frame.height = GST_VIDEO_INFO_HEIGHT(&info);
+    const auto steadyNow = std::chrono::steady_clock::now();
+    const auto wallNow = std::chrono::system_clock::now();
+    GstClockTime runningTime = GST_CLOCK_TIME_NONE;
+    GstClockTimeDiff age = 0;
+    if (CaptureAge(pipeline, sample, buffer, runningTime, age))
+    {
+        frame.pts = static_cast<int64_t>(runningTime);
     }
     else
-        recorder->pushFrame(frame);
-        //writer->write(frame);
+    {
+        age = 0;
+    }
+    frame.captureTime = steadyNow - std::chrono::nanoseconds(age);
+    frame.captureWallMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        (wallNow - std::chrono::nanoseconds(age)).time_since_epoch()).count();
+    frame.sequence = ++frameSequence;
+
+    bool copied = false;
+    switch (GST_VIDEO_INFO_FORMAT(&info))
+    {
+    case GST_VIDEO_FORMAT_NV12:
+        frame.format = PixelFormat::NV12;
+        frame.image = WrapYuvPlanes(info, mapped->map.data, copied);
+        break;
+    case GST_VIDEO_FORMAT_I420:
+        frame.format = PixelFormat::I420;
+        frame.image = WrapYuvPlanes(info, mapped->map.data, copied);
+        break;
+    case GST_VIDEO_FORMAT_BGR:
+        frame.format = PixelFormat::BGR;
+        frame.image = cv::Mat(frame.height, frame.width, CV_8UC3, mapped->map.data,
+                              GST_VIDEO_INFO_PLANE_STRIDE(&info, 0));
+        break;
+    default:
+        std::cerr << "[GStreamer] Unexpected appsink format " << GST_VIDEO_INFO_NAME(&info) << std::endl;
+        gst_buffer_unmap(buffer, &mapped->map);
+        gst_sample_unref(sample);
+        delete mapped;
+        return nullptr;
+    }
+
+    auto release = [](MappedSample* m)
+    {
+        gst_buffer_unmap(m->buffer, &m->map);
+        gst_sample_unref(m->sample);
+    };
+    if (copied)
+    {
+        // The frame owns its pixels now; give the buffer back straight away
+        release(mapped);
+        return FrameRef(&mapped->frame, [mapped](const CameraFrame*) { delete mapped; });
+    }
+    // Counted so a restart can wait for the last mapped frame before tearing down
+    std::shared_ptr<std::atomic<int>> held = mappedFrames;
+    held->fetch_add(1);
+    return FrameRef(&mapped->frame, [mapped, release, held](const CameraFrame*)
+    {
+        release(mapped);
+        delete mapped;
+        held->fetch_sub(1);
+    });
 }
 
 bool GStreamer::startRecording(const std::string &filename, int bitrate_kbps)
@@ -74,157 +464,269 @@ bool GStreamer::startRecording(const std::string &filename, int bitrate_kbps)
     this->bitrate_kbps = bitrate_kbps;
     recordingFilename = "build/Data/Videos/" + filename;
 
-    // Determine effective fps for the writer. Prefer camera-negotiated fps if available,
-    // otherwise fall back to the requested fps. If camera reports 0, sample a few frames
-    // to estimate the real capture framerate.
-    double cam_reported_fps = 0.0;
-    if (cap && cap->isOpened())
-        cam_reported_fps = cap->get(cv::CAP_PROP_FPS);
+    // A recording resumed after a capture restart must not overwrite this
+    // file, so its segments get the time they were opened appended
+    std::filesystem::path path(recordingFilename);
+    recordingLocation = [stem = (path.parent_path() / path.stem()).string(), ext = path.extension().string()](unsigned)
+    {
+        auto t = std::time(0);
+        std::tm tm{};
+        localtime_r(&t, &tm);
+        std::ostringstream oss;
+        oss << stem << "_" << std::put_time(&tm, "%Y-%m-%d_%H:%M:%S") << ext;
+        return oss.str();
+    };
 
-    double measured_fps = 0.0;
-    if (cam_reported_fps > 0.5 && cam_reported_fps < 120.0)
+    // The encoder takes its timing from the camera's buffer timestamps, so no
+    // frame rate has to be measured or forced here.
+    if (!recorder->start(recordingFilename, bitrate_kbps))
     {
-        measured_fps = cam_reported_fps;
-        std::cerr << "[GStreamer] Using camera-reported FPS=" << measured_fps << "\n";
+        std::cerr << "[GStreamer Error] Failed to start recorder.\n";
+        return false;
     }
-    else
+
+    return true;
+}
+
+bool GStreamer::startRecordingDateTime(int bitrate_kbps, const std::string &filenamePrefix)
+{
+    if (isRecording())
     {
-        measured_fps = measureCaptureFps(8);
-        std::cerr << "[GStreamer] Measured FPS=" << measured_fps << " (camera reported=" << cam_reported_fps << ")\n";
+        std::cerr << "[GStreamer Warning] Recording already in progress.\n";
+        return false;
     }
+    this->bitrate_kbps = bitrate_kbps;
 
-    double effective_fps = (measured_fps > 0.5 && measured_fps < 120.0) ? measured_fps : static_cast<double>(fps);
-    fps = static_cast<int>(effective_fps);
-
-    if (!recorder->start(recordingFilename, w, h, effective_fps, bitrate_kbps, 30))
+    // Every segment is named for the date/time it was opened
+    auto location = [filenamePrefix](unsigned)
+    {
+        auto t = std::time(0);
+        std::tm tm{};
+        localtime_r(&t, &tm);
+        std::ostringstream oss;
+        oss << "build/Data/Videos/";
+        if (!filenamePrefix.empty()) oss << filenamePrefix << "_";
+        oss << std::put_time(&tm, "%Y-%m-%d_%H:%M:%S") << ".mp4";
+        return oss.str();
+    };
+    recordingLocation = location;
+    if (!recorder->start(location, bitrate_kbps))
     {
         std::cerr << "[GStreamer Error] Failed to start recorder.\n";
         return false;
     }
 
     return true;
-
-    // Use CAP_GSTREAMER backend
-    //std::string pipeline = get_pipeline_encoderMp4();
-    
-    //writer = std::make_unique<cv::VideoWriter>(pipeline, cv::CAP_GSTREAMER, 0, effective_fps, cv::Size(w, h), true);
-    
-    // if (!writer->isOpened())
-    // {
-    //     std::cerr << "GStreamer VideoWriter failed to open pipeline: " << pipeline << std::endl;
-    //     writer.reset();
-    //     return false;
-    // }
 }
 
-bool GStreamer::startRecordingDateTime(int bitrate_kbps, const std::string &filenamePrefix)
+bool GStreamer::rotateRecording()
 {
-    // Get current date/time for filename
-    auto t = std::time(0);
-    auto tm = *std::localtime(&t);
-    std::ostringstream oss;
-    if (!filenamePrefix.empty()) oss << filenamePrefix << "_";
-    oss << std::put_time(&tm, "%Y-%m-%d_%H:%M:%S") << ".mp4";
-    return startRecording(oss.str(), bitrate_kbps);
+    return isRecording() && recorder->rotate();
 }
 
-void GStreamer::stopRecording(bool upload)
+void GStreamer::stopRecording()
 {
     if (isRecording())
     {
-        recorder->stop(upload);
-        // writer->release();
-        // writer.reset();
+        recorder->stop();
     }
 }
 
-double GStreamer::measureCaptureFps(int samples)
+void GStreamer::busThreadFunc(GstBus* bus)
 {
-    if (!cap || !cap->isOpened() || samples <= 0)
-        return 0.0;
-    cv::Mat tmp;
-    int framesRetrieved = 0;
-
-    auto t0 = std::chrono::steady_clock::now();
-    for (int i = 0; i < samples; ++i)
+    // Nothing else pops this bus, so it is drained here whether or not anyone
+    // is interested in the message
+    while (!busStopRequested.load())
     {
-        if (!cap->read(tmp) || tmp.empty())
+        GstMessage* message = gst_bus_timed_pop(bus, 200 * GST_MSECOND);
+        if (!message)
+        {
+            continue;
+        }
+        switch (GST_MESSAGE_TYPE(message))
+        {
+        case GST_MESSAGE_ERROR:
+        case GST_MESSAGE_WARNING:
+        {
+            GError* error = nullptr;
+            gchar* debug = nullptr;
+            if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR)
+                gst_message_parse_error(message, &error, &debug);
+            else
+                gst_message_parse_warning(message, &error, &debug);
+            std::string text = std::string(GST_OBJECT_NAME(GST_MESSAGE_SRC(message))) + ": " +
+                               (error ? error->message : "unknown");
+            std::cerr << "[GStreamer] " << text << std::endl;
+            if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR)
+            {
+                // The pipeline stops streaming after an error; captureFrame() rebuilds it
+                markCaptureFailed(text);
+            }
+            if (error) g_error_free(error);
+            g_free(debug);
             break;
-        ++framesRetrieved;
+        }
+        case GST_MESSAGE_EOS:
+            markCaptureFailed("end of stream");
+            break;
+        case GST_MESSAGE_QOS:
+        {
+            GstFormat format = GST_FORMAT_UNDEFINED;
+            guint64 processed = 0, dropped = 0;
+            gst_message_parse_qos_stats(message, &format, &processed, &dropped);
+            std::lock_guard<std::mutex> lock(healthMutex);
+            ++health.qosMessages;
+            if (format == GST_FORMAT_BUFFERS || format == GST_FORMAT_DEFAULT)
+            {
+                uint64_t& last = qosDroppedBy[GST_OBJECT_NAME(GST_MESSAGE_SRC(message))];
+                if (dropped > last)
+                {
+                    health.qosDropped += dropped - last;
+                    last = dropped;
+                }
+            }
+            break;
+        }
+        case GST_MESSAGE_LATENCY:
+            // An element's latency changed (e.g. the encoder queue); redistribute it
+            gst_bin_recalculate_latency(GST_BIN(pipeline));
+            break;
+        case GST_MESSAGE_ELEMENT:
+            recorder->handleBusMessage(message);
+            break;
+        default:
+            break;
+        }
+        gst_message_unref(message);
+    }
+    gst_object_unref(bus);
+}
+
+void GStreamer::stopBusThread()
+{
+    busStopRequested.store(true);
+    if (busThread.joinable())
+    {
+        busThread.join();
     }
-    auto t1 = std::chrono::steady_clock::now();
-    double secs = std::chrono::duration_cast<std::chrono::duration<double>>(t1 - t0).count();
-    return (framesRetrieved > 1 && secs > 0.0) ? static_cast<double>(framesRetrieved) / secs : 0.0;
+    busStopRequested.store(false);
 }
 
-// Build a safer libcamerasrc pipeline: avoid forcing a possibly-unsupported format
-// and let videoconvert handle conversions. End with appsink with a name so
-// OpenCV can negotiate caps.
+// NV12 is what the Pi ISP produces, so nothing downstream has to convert:
+// x264enc takes it as is and YOLO converts only the downscaled input.
 std::string GStreamer::gst_pipeline_libcamera()
 {
     std::ostringstream ss;
-    ss << "libcamerasrc ! video/x-raw,width=" << w << ",height=" << h << ",framerate=" << fps
-       << "/1 "
-       << "! videoconvert ! video/x-raw,format=BGR ! appsink name=appsink emit-signals=false "
-          "sync=false max-buffers=1 drop=true";
+    ss << "libcamerasrc ! video/x-raw,format=NV12,width=" << w << ",height=" << h << ",framerate=" << fps
+       << "/1 ";
     return ss.str();
 }
 
-// v4l2 path: prefer to ask for a common raw format and convert downstream.
+// Two ISP outputs: the full-size stream feeds the tee and the recorder, the
+// second (request pad src_0) is scaled by the hardware for inference.
+std::string GStreamer::gst_pipeline_libcamera_dual()
+{
+    std::ostringstream ss;
+    ss << "libcamerasrc name=cam "
+       << "cam.src ! video/x-raw,format=NV12,width=" << w << ",height=" << h << ",framerate=" << fps
+       << "/1 ! tee name=t allow-not-linked=true "
+       << "cam.src_0 ! video/x-raw,format=NV12,width=" << inferenceSize.width << ",height=" << inferenceSize.height
+       << ",framerate=" << fps << "/1 ! " << gst_pipeline_inference(false);
+    return ss.str();
+}
+
+// v4l2 path: USB cameras differ (YUY2, NV12, ...), so take what the camera
+// offers; the branches convert only when it isn't a 4:2:0 format already.
 std::string GStreamer::gst_pipeline_v4l2()
 {
     std::ostringstream ss;
     ss << "v4l2src device=/dev/video0 ! video/x-raw,width=" << w << ",height=" << h
-       << ",framerate=" << fps << "/1 "
-       << "! videoconvert ! video/x-raw,format=BGR ! appsink name=appsink emit-signals=false "
-          "sync=false max-buffers=1 drop=true";
+       << ",framerate=" << fps << "/1 ";
     return ss.str();
 }
 
-std::string GStreamer::get_pipeline_encoderMp4()
+// tee the source: the inference branch keeps only the newest frame (leaky
+// queue, appsink drop=true) so a slow detector never holds back the camera or
+// the recorder. GstRecorder links its encoder branch to the tee on demand.
+std::string GStreamer::gst_pipeline_branches()
+{
+    return "! tee name=t allow-not-linked=true t. ! " + gst_pipeline_inference(!inferenceSize.empty());
+}
+
+// Frames stay YUV 4:2:0; videoconvert is a passthrough unless the camera
+// delivers something else. Scaling comes first so any conversion runs on the
+// small frame.
+std::string GStreamer::gst_pipeline_inference(bool scale)
 {
     std::ostringstream ss;
-    ss << "appsrc name=appsrc0 is-live=true do-timestamp=true format=time block=true ! "
-       << "video/x-raw,format=BGR,width=" << w << ",height=" << h << " ! "
-       << "videoconvert ! videorate ! video/x-raw,framerate=" << fps << "/1 ! "
-       << "queue ! x264enc bitrate=" << bitrate_kbps
-       << " speed-preset=ultrafast tune=zerolatency ! "
-       << "video/x-h264,stream-format=byte-stream ! "
-       << "h264parse ! mp4mux ! filesink location=" << recordingFilename << " sync=true";
+    ss << "queue leaky=downstream max-size-buffers=1 max-size-bytes=0 max-size-time=0 ";
+    if (scale)
+    {
+        ss << "! videoscale ";
+    }
+    ss << "! videoconvert ! video/x-raw,format=(string){NV12,I420}";
+    if (scale)
+    {
+        ss << ",width=" << inferenceSize.width << ",height=" << inferenceSize.height << ",pixel-aspect-ratio=1/1";
+    }
+    ss << " ! appsink name=appsink emit-signals=false sync=false max-buffers=1 drop=true";
     return ss.str();
 }
 
 // Try to open a pipeline and print helpful diagnostics.
-bool GStreamer::open_capture_with_pipeline(const std::string &pipeline)
+bool GStreamer::open_capture_with_pipeline(const std::string &pipelineStr)
 {
-    // std::cerr << "Trying pipeline: " << pipeline << std::endl;
+    // std::cerr << "Trying pipeline: " << pipelineStr << std::endl;
     //  Ask GStreamer to be a bit more verbose (helps when launching from the terminal)
     //  Only set if not already set in the environment
     if (!std::getenv("GST_DEBUG"))
         setenv("GST_DEBUG", "3", 0);
 
-    cap->open(pipeline, cv::CAP_GSTREAMER);
-    if (!cap->isOpened())
+    releaseCapture();
+
+    GError* error = nullptr;
+    pipeline = gst_parse_launch(pipelineStr.c_str(), &error);
+    if (!pipeline)
     {
-        std::cerr << "cv::VideoCapture failed to open pipeline.\n";
+        std::cerr << "gst_parse_launch failed: " << (error ? error->message : "unknown error") << std::endl;
+        if (error) g_error_free(error);
         return false;
     }
+    if (error)
+    {
+        // Recoverable parse warning, e.g. a missing optional property
+        std::cerr << "gst_parse_launch: " << error->message << std::endl;
+        g_error_free(error);
+    }
 
-    // Try to query a few properties; if these fail the pipeline didn't negotiate caps
-    double w = cap->get(cv::CAP_PROP_FRAME_WIDTH);
-    double h = cap->get(cv::CAP_PROP_FRAME_HEIGHT);
-    double fps = cap->get(cv::CAP_PROP_FPS);
-    // std::cerr << "Opened capture: width=" << w << " height=" << h << " fps=" << fps << std::endl;
+    tee = gst_bin_get_by_name(GST_BIN(pipeline), "t");
+    appsink = GST_APP_SINK(gst_bin_get_by_name(GST_BIN(pipeline), "appsink"));
+    if (!tee || !appsink || gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    {
+        std::cerr << "Capture pipeline failed to start.\n";
+        releaseCapture();
+        return false;
+    }
 
-    // If width/height/fps are not reported, the pipeline likely didn't negotiate caps.
-    // Treat this as a failure so caller can try a different pipeline.
-    if (w <= 0 || h <= 0 || fps <= 0)
+    // If no frame arrives the pipeline didn't negotiate caps (or the camera is
+    // missing). Treat this as a failure so caller can try a different pipeline.
+    pendingSample = gst_app_sink_try_pull_sample(appsink, 5 * GST_SECOND);
+    if (!pendingSample)
     {
-        std::cerr << "Capture opened but video properties invalid (caps negotiation likely "
+        std::cerr << "Capture pipeline opened but produced no frames (caps negotiation likely "
                      "failed). Releasing and reporting failure.\n";
-        cap->release();
+        releaseCapture();
         return false;
     }
 
+    capturePipeline = pipelineStr;
+    {
+        // Element names repeat in a rebuilt pipeline, but their QoS counts start over
+        std::lock_guard<std::mutex> lock(healthMutex);
+        qosDroppedBy.clear();
+    }
+    captureFailed.store(false);
+    busThread = std::thread(&GStreamer::busThreadFunc, this, gst_element_get_bus(pipeline));
+    recorder->attach(pipeline, tee);
     return true;
-}
\ No newline at end of file
+}
@@ -1,10 +1,40 @@
 #pragma once
+#include "CameraFrame.h"
 #include "GstRecorder.h"
 
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
 #include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <map>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <thread>
 
+// One capture pipeline for everything:
+//
+//   camera (NV12) ! tee ! queue (leaky) ! [videoscale] ! appsink (NV12/I420)  -> captureFrame()
+//                      \ [GstRecorder branch: queue ! x264enc ! splitmuxsink (mp4mux)]
+//
+// Frames stay in the camera's YUV 4:2:0 format end to end. Nothing converts
+// them at full resolution: the encoder takes YUV, and YOLOModel converts to RGB
+// while it scales down to the network input.
+//
+// With setInferenceSize() the two consumers get different resolutions: the
+// recording keeps the full w x h, inference frames are pre-scaled to fit the
+// network input. libcamera produces the small stream on its second ISP output
+// at no CPU cost; otherwise videoscale on the inference branch does it.
+//
+// A bus thread drains the pipeline's messages while it is open: recorder
+// segment notifications are passed to GstRecorder, QoS drops are counted and
+// latency changes are redistributed. An error, end of stream or 2 s without a
+// frame marks the capture failed; captureFrame() then tears the pipeline down
+// once the caller has dropped the frames mapping its buffers, and rebuilds
+// the same one with exponential backoff (0.5 s up to 30 s) on its own thread.
+// The caller keeps its model and tracker and only sees nullptr frames
+// meanwhile; a recording that was running continues in a new file.
 class GStreamer
 {
 public:
@@ -14,40 +44,120 @@ public:
         V4L2
     };
 
-public:
-    GStreamer() 
-    { 
-        cap = std::make_unique<cv::VideoCapture>(); 
-        recorder = std::make_unique<GstRecorder>();
+    struct CaptureHealth
+    {
+        uint64_t failures = 0;        // times the pipeline was found broken
+        uint64_t restarts = 0;        // rebuilt and delivering frames again
+        uint64_t failedAttempts = 0;  // rebuilds that did not produce a frame
+        double lastRecoveryMs = 0.0;  // failure detected to first frame again
+        double maxRecoveryMs = 0.0;
+        double totalRecoveryMs = 0.0;
+        uint64_t qosMessages = 0;
+        uint64_t qosDropped = 0;      // buffers elements reported dropping, summed over elements
+        bool restarting = false;
+        std::string lastError;
     };
 
+public:
+    GStreamer();
+    ~GStreamer();
+
     bool openCapture(CaptureBackend backend, int w, int h, int fps);
-    cv::Mat captureFrame();
-    void writeFrame(const cv::Mat& frame);
+    // Scale inference frames to fit inside size (aspect kept, so the model's
+    // letterbox only pads). Takes effect on the next openCapture; 0x0 sends the
+    // recording resolution to inference as well.
+    void setInferenceSize(const cv::Size& size) { inferenceBox = size; }
+    void closeCapture();
+    // Blocks until the next inference frame. The frame shares the appsink's
+    // buffer, so treat the pixels as read-only. Returns nullptr while the
+    // pipeline is being restarted (or after closeCapture()); never throws.
+    FrameRef captureFrame();
+    CaptureHealth captureHealth() const;
+    std::string captureHealthJson() const;
 
     bool startRecording(const std::string& filename, int bitrate_kbps = 2000);
     bool startRecordingDateTime(int bitrate_kbps = 2000, const std::string& filenamePrefix = "");
     bool isRecording() const {
         return recorder->isRunning();
-        //return (writer && writer->isOpened());
     }
-    void stopRecording(bool upload = false);
-    
-private:
-    double measureCaptureFps(int samples = 3);
+    // Close the current file and continue in a new one without stopping the encoder
+    bool rotateRecording();
+    void stopRecording();
+    // Called on the bus thread for every finished recording file
+    void setSegmentCallback(GstRecorder::SegmentFunc fn) { recorder->setSegmentCallback(std::move(fn)); }
+    // Rotate on its own once a file reaches this duration or size (0 = no limit)
+    bool setSegmentLimits(std::chrono::seconds maxDuration, uint64_t maxBytes = 0)
+    {
+        return recorder->configureSegments(maxDuration, maxBytes);
+    }
+    // Keep only footage around activity; see ClipRecorder
+    bool setEventClips(bool enabled, const ClipRecorder::Options& options = ClipRecorder::Options{})
+    {
+        return recorder->configureEventClips(enabled, options);
+    }
+    void markActivity() { recorder->markActivity(); }
+    void addClipEvent(const MetricEvent& event) { recorder->addEvent(event); }
+    // Recording bitrate/frame rate follow the number of people in view; see EncoderController
+    void setSceneActivity(int liveTracks) { recorder->setSceneActivity(liveTracks); }
+    EncoderController::Stats encoderStats() const { return recorder->encoderStats(); }
+    std::string encoderStatsJson() const { return recorder->encoderStatsJson(); }
+    // Record fragmented MP4 and upload it while recording; see GstRecorder::configureFragments
+    bool setFragmentedRecording(int fragmentDurationMs, bool uploadWhileRecording = true)
+    {
+        return recorder->configureFragments(fragmentDurationMs, uploadWhileRecording);
+    }
 
+private:
     std::string gst_pipeline_libcamera();
+    std::string gst_pipeline_libcamera_dual();
     std::string gst_pipeline_v4l2();
-    std::string get_pipeline_encoderMp4();
+    std::string gst_pipeline_branches();
+    std::string gst_pipeline_inference(bool scale);
 
     bool open_capture_with_pipeline(const std::string &pipeline);
+    void releaseCapture();
+    void busThreadFunc(GstBus* bus);
+    void stopBusThread();
+    void markCaptureFailed(const std::string& reason);
+    void beginRestart();
+    bool tryRestart();
+    FrameRef wrapSample(GstSample* sample);
 
 private:
-    std::unique_ptr<cv::VideoCapture> cap;
+    GstElement* pipeline{ nullptr };
+    GstElement* tee{ nullptr };
+    GstAppSink* appsink{ nullptr };
+    // First sample, pulled while opening to confirm caps negotiated
+    GstSample* pendingSample{ nullptr };
     std::unique_ptr<GstRecorder> recorder;
-    std::unique_ptr<cv::VideoWriter> writer;
+    std::thread busThread;
+    std::atomic<bool> busStopRequested{ false };
 
     int w, h, fps;
+    cv::Size inferenceBox;
+    cv::Size inferenceSize; // fitted into inferenceBox for the current w x h
     int bitrate_kbps;
+    uint64_t frameSequence = 0;
     std::string recordingFilename;
-};
\ No newline at end of file
+    // Names the files of a recording resumed after a restart
+    GstRecorder::LocationFunc recordingLocation;
+
+    // The pipeline that opened; a restart rebuilds exactly this one
+    std::string capturePipeline;
+    // Set by the bus thread, acted on by captureFrame()
+    std::atomic<bool> captureFailed{ false };
+    mutable std::mutex healthMutex;
+    CaptureHealth health;
+    std::map<std::string, uint64_t> qosDroppedBy; // per element; QoS counts are cumulative
+
+    // FrameRefs alive that still map an appsink buffer; shared with their deleters
+    std::shared_ptr<std::atomic<int>> mappedFrames = std::make_shared<std::atomic<int>>(0);
+
+    // Restart state, only touched on the captureFrame() thread
+    bool restartPending = false;
+    bool releasePending = false; // failed pipeline not torn down yet
+    bool resumeRecording = false;
+    int restartAttempts = 0;
+    std::chrono::steady_clock::time_point failedAt;
+    std::chrono::steady_clock::time_point nextRestartAt;
+};
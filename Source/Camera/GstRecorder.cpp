@@ -1,8 +1,5 @@
 #include "GstRecorder.h"
-#include "Metrics/MongoLink.h"
 
-#include <gst/video/video.h>
-#include <gst/app/gstappsrc.h>
 #include <iostream>
 #include <sstream>
 #include <filesystem>
@@ -22,275 +19,414 @@ GstRecorder::~GstRecorder()
     stop();
 }
 
-bool GstRecorder::start(const std::string& filename, int width, int height, double fps, int bitrate_kbps, size_t maxQueueSize)
+void GstRecorder::attach(GstElement* pipeline, GstElement* tee)
+{
+    this->pipeline = pipeline;
+    this->tee = tee;
+}
+
+void GstRecorder::setSegmentCallback(SegmentFunc fn)
+{
+    std::lock_guard<std::mutex> lk(callbackMutex);
+    segmentCallback = std::move(fn);
+}
+
+bool GstRecorder::start(const std::string& filename, int bitrate_kbps)
 {
     if (running.load()) return false;
 
-    configure(width, height, fps, bitrate_kbps, maxQueueSize);
+    configure(bitrate_kbps);
     return start(filename);
 }
 
 bool GstRecorder::start(const std::string& filename)
 {
-    if (running.load()) return false;
+    // Later segments of a fixed name become name_1.mp4, name_2.mp4, ...
+    return start([filename](unsigned segment)
+    {
+        if (segment == 0)
+        {
+            return filename;
+        }
+        std::filesystem::path path(filename);
+        return (path.parent_path() / (path.stem().string() + "_" + std::to_string(segment) + path.extension().string())).string();
+    }, bitrate_kbps);
+}
 
-    this->filename = filename;
+bool GstRecorder::start(const LocationFunc& location, int bitrate_kbps)
+{
+    if (running.load()) return false;
+    if (!pipeline || !tee)
+    {
+        std::cerr << "[GstRecorder] Not attached to a capture pipeline\n";
+        return false;
+    }
 
-    frameIndex = 0;
-    stopRequested.store(false);
+    configure(bitrate_kbps);
+    locationFunc = location;
+    {
+        std::lock_guard<std::mutex> lk(segmentMutex);
+        currentSegment.clear();
+        closedSegments.clear();
+        eosReceived = false;
+    }
 
-    std::string pipelineStr = buildPipelineString();
+    // x264enc cannot change its preset while playing, so pick it now from the CPU headroom
+    std::string preset = encoderControl.pickPreset();
+    std::string branchStr = buildBranchString(preset);
     GError* error = nullptr;
-    pipeline = gst_parse_launch(pipelineStr.c_str(), &error);
-    if (!pipeline)
+    branch = gst_parse_bin_from_description(branchStr.c_str(), TRUE, &error);
+    if (!branch)
     {
-        std::cerr << "gst_parse_launch failed: " << (error ? error->message : "unknown error") << std::endl;
+        std::cerr << "gst_parse_bin_from_description failed: " << (error ? error->message : "unknown error") << std::endl;
         if (error) g_error_free(error);
         return false;
     }
+    gst_bin_add(GST_BIN(pipeline), branch);
 
-    // Get appsrc element by name ("src")
-    appsrc = GST_APP_SRC(gst_bin_get_by_name(GST_BIN(pipeline), "src"));
-    if (!appsrc)
+    if (eventClips)
     {
-        std::cerr << "Failed to get appsrc from pipeline\n";
-        gst_object_unref(pipeline);
-        pipeline = nullptr;
-        return false;
-    }
-
-    // Configure caps: BGR
-    GstCaps* caps = gst_caps_new_simple(
-        "video/x-raw",
-        "format", G_TYPE_STRING, "BGR",
-        "width", G_TYPE_INT, width,
-        "height", G_TYPE_INT, height,
-        "framerate", GST_TYPE_FRACTION, static_cast<gint>(std::round(fps)), 1,
-        NULL);
-    gst_app_src_set_caps(GST_APP_SRC(appsrc), caps);
-    gst_caps_unref(caps);
-
-    // Ensure appsrc blocks when queue is full and use time format for buffers
-    g_object_set(G_OBJECT(appsrc), "stream-type", GST_APP_STREAM_TYPE_STREAM, NULL);
-    g_object_set(G_OBJECT(appsrc), "format", GST_FORMAT_TIME, NULL);
-
-    // Precompute frame duration (use floating math for fractional fps)
-    if (fps > 0.0)
-    {
-        frameDuration = static_cast<GstClockTime>((double)GST_SECOND / fps + 0.5);
+        GstElement* clipsink = gst_bin_get_by_name(GST_BIN(branch), "clipsink");
+        GstAppSinkCallbacks callbacks{};
+        callbacks.eos = &GstRecorder::clipEos;
+        callbacks.new_sample = &GstRecorder::clipSample;
+        gst_app_sink_set_callbacks(GST_APP_SINK(clipsink), &callbacks, this, nullptr);
+        gst_object_unref(clipsink);
+
+        clips.setClipCallback([this](const std::string& path)
+        {
+            std::lock_guard<std::mutex> lk(callbackMutex);
+            if (segmentCallback)
+            {
+                segmentCallback(path, false);
+            }
+        });
+        clips.start();
     }
     else
     {
-        frameDuration = GST_SECOND / 30; // fallback
+        // splitmuxsink takes the muxer as an object; set it up before the branch starts
+        splitmux = gst_bin_get_by_name(GST_BIN(branch), "splitmux");
+        GstElement* muxer = gst_element_factory_make("mp4mux", nullptr);
+        if (fragmentDurationMs > 0)
+        {
+            // streamable=true: never seek back to patch the header, so bytes already
+            // uploaded stay valid
+            g_object_set(muxer, "fragment-duration", static_cast<guint>(fragmentDurationMs), "streamable", TRUE, nullptr);
+        }
+        else
+        {
+            // faststart places the moov atom up front for easier playback
+            g_object_set(muxer, "faststart", TRUE, nullptr);
+        }
+        g_object_set(splitmux, "muxer", muxer, nullptr);
+        g_signal_connect(splitmux, "format-location", G_CALLBACK(&GstRecorder::formatLocation), this);
+
+        // EOS reaching splitmuxsink means stop() is draining the branch; segment
+        // rotations never send EOS through this pad
+        GstPad* videoPad = gst_element_get_static_pad(splitmux, "video");
+        if (videoPad)
+        {
+            gst_pad_add_probe(videoPad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, &GstRecorder::eosProbe, this, nullptr);
+            gst_object_unref(videoPad);
+        }
     }
 
-    // establish base time for timestamping (steady clock)
-    baseTime = std::chrono::steady_clock::now();
+    GstElement* queue = gst_bin_get_by_name(GST_BIN(branch), "recqueue");
+    GstElement* encoder = gst_bin_get_by_name(GST_BIN(branch), "encoder");
+    encoderControl.attach(queue, encoder, bitrate_kbps, preset);
+    if (queue) gst_object_unref(queue);
+    if (encoder) gst_object_unref(encoder);
+
+    branchSinkPad = gst_element_get_static_pad(branch, "sink");
+    teePad = gst_element_get_request_pad(tee, "src_%u");
+
+    // Start the recording's timeline at zero rather than at the pipeline's running
+    // time. Encoded frames keep the camera's capture timestamps, so running time
+    // t in the branch was captured at branchStartWallMs + t.
+    branchStartWallMs = 0;
+    GstClock* clock = gst_element_get_clock(pipeline);
+    if (clock)
+    {
+        GstClockTime runningTime = gst_clock_get_time(clock) - gst_element_get_base_time(pipeline);
+        branchStartWallMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        gst_pad_set_offset(branchSinkPad, -static_cast<gint64>(runningTime));
+        gst_object_unref(clock);
+    }
 
-    // Set pipeline state to PLAYING
-    GstStateChangeReturn ret = gst_element_set_state(pipeline, GST_STATE_PLAYING);
-    if (ret == GST_STATE_CHANGE_FAILURE)
+    if (!gst_element_sync_state_with_parent(branch) || gst_pad_link(teePad, branchSinkPad) != GST_PAD_LINK_OK)
     {
-        std::cerr << "Failed to set pipeline to PLAYING state\n";
-        gst_object_unref(appsrc);
-        gst_object_unref(pipeline);
-        appsrc = nullptr;
-        pipeline = nullptr;
+        std::cerr << "[GstRecorder] Failed to attach recording branch" << std::endl;
+        encoderControl.detach();
+        removeBranch();
         return false;
     }
 
     running.store(true);
-    recorderThread = std::thread(&GstRecorder::recorderThreadFunc, this);
 
-    // diagnostic print
-    std::cerr << "[GstRecorder] started filename='" << filename << "' fps=" << fps << " frameDuration=" << frameDuration << " ns\n";
+    std::cerr << "[GstRecorder] started bitrate<=" << bitrate_kbps << " kbps, preset " << preset;
+    if (eventClips)
+        std::cerr << ", event clips";
+    else if (segmentDuration.count() > 0)
+        std::cerr << ", segments of " << segmentDuration.count() << " s";
+    std::cerr << "\n";
     return true;
 }
 
-bool GstRecorder::pushFrame(const cv::Mat& frame)
+bool GstRecorder::rotate()
 {
-    if (!running.load()) return false;
+    if (!running.load() || !splitmux) return false; // event clips are cut by activity
 
-    auto now = std::chrono::steady_clock::now();
-    std::lock_guard<std::mutex> lk(queueMutex);
-    if (frameQueue.size() >= maxQueueSize)
-    {
-        // Drop frame if queue is full
-        return false;
-    }
-    frameQueue.emplace_back(frame.clone(), now);
-    queueCondVar.notify_one();
+    // Splits before the GOP being collected, so the new file starts on a
+    // keyframe and no frame is dropped or duplicated
+    g_signal_emit_by_name(splitmux, "split-now");
     return true;
 }
 
-void GstRecorder::stop(bool upload)
+void GstRecorder::stop()
 {
     if (!running.load()) return;
 
-    // signal the thread to stop
-    stopRequested.store(true);
-    queueCondVar.notify_one();
-    if (recorderThread.joinable())
-        recorderThread.join();
-
-    // Push EOS to appsrc so the pipeline can finish and mp4mux can write the file tail
-    if (appsrc)
-        gst_app_src_end_of_stream(GST_APP_SRC(appsrc));
-
-    // Also send an EOS event to the pipeline and wait for the EOS or ERROR message on the bus.
-    if (pipeline)
+    // Unlink from the tee between two buffers, then push EOS into the branch so
+    // the muxer writes the last segment's tail. Capture and inference keep
+    // running meanwhile. The segment is complete once the bus thread has seen
+    // splitmuxsink close it.
+    gst_pad_add_probe(teePad, GST_PAD_PROBE_TYPE_IDLE, &GstRecorder::unlinkProbe, this, nullptr);
     {
-        gst_element_send_event(pipeline, gst_event_new_eos());
-
-        GstBus* bus = gst_element_get_bus(pipeline);
-        if (bus)
+        std::unique_lock<std::mutex> lk(segmentMutex);
+        bool drained = segmentCondVar.wait_for(lk, std::chrono::seconds(5), [this]
         {
-            // wait up to 5s for EOS/ERROR (adjust timeout if needed)
-            GstMessage* msg = gst_bus_timed_pop_filtered(bus, 5 * GST_SECOND,
-                static_cast<GstMessageType>(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
-            if (msg)
-            {
-                if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR)
-                {
-                    GError* err = nullptr;
-                    gst_message_parse_error(msg, &err, nullptr);
-                    std::cerr << "GStreamer pipeline error during EOS: " << (err ? err->message : "(unknown)") << std::endl;
-                    if (err) g_error_free(err);
-                }
-                gst_message_unref(msg);
-            }
-            gst_object_unref(bus);
+            return eosReceived && (currentSegment.empty() || closedSegments.count(currentSegment) > 0);
+        });
+        if (!drained)
+        {
+            std::cerr << "[GstRecorder] Timed out waiting for the recording branch to finish " << currentSegment << std::endl;
         }
+    }
+    encoderControl.detach();
+    removeBranch();
+    if (eventClips)
+    {
+        // Closes the clip that was still open and waits for its muxer
+        clips.stop();
+    }
 
-        // Now stop the pipeline cleanly
-        gst_element_set_state(pipeline, GST_STATE_NULL);
+    // Anything the bus thread did not get to (timeout) still has its fragments
+    // queued up to the last finished box
+    std::unordered_map<std::string, std::unique_ptr<FragmentUploader>> leftovers;
+    {
+        std::lock_guard<std::mutex> lk(segmentMutex);
+        leftovers.swap(uploaders);
     }
+    for (auto& [path, uploader] : leftovers)
+    {
+        uploader->finish();
+    }
+    running.store(false);
+}
 
-    if (appsrc)
+void GstRecorder::handleBusMessage(GstMessage* message)
+{
+    if (GST_MESSAGE_TYPE(message) != GST_MESSAGE_ELEMENT)
+    {
+        return;
+    }
+    const GstStructure* structure = gst_message_get_structure(message);
+    if (!structure || !gst_structure_has_name(structure, "splitmuxsink-fragment-closed"))
     {
-        gst_object_unref(appsrc);
-        appsrc = nullptr;
+        return;
     }
-    if (pipeline)
+    const gchar* location = gst_structure_get_string(structure, "location");
+    if (location)
     {
-        gst_object_unref(pipeline);
-        pipeline = nullptr;
+        segmentClosed(location);
     }
+}
 
-    if (upload)
+void GstRecorder::segmentOpened(const std::string& path)
+{
+    std::unique_ptr<FragmentUploader> uploader;
+    if (uploadWhileRecording)
     {
-        // Upload video to MongoDB
-        MongoLink::GetInstance().UploadVideo(filename, std::filesystem::path(filename).filename().string());
+        uploader = std::make_unique<FragmentUploader>();
+        if (!uploader->start(path, std::filesystem::path(path).filename().string()))
+        {
+            uploader.reset();
+        }
     }
-    running.store(false);
 
-    std::lock_guard<std::mutex> lk(queueMutex);
-    frameQueue.clear();
+    std::lock_guard<std::mutex> lk(segmentMutex);
+    currentSegment = path;
+    if (uploader)
+    {
+        uploaders[path] = std::move(uploader);
+    }
 }
 
-void GstRecorder::recorderThreadFunc()
+void GstRecorder::segmentClosed(const std::string& path)
 {
-    while (!stopRequested.load()) {
-        cv::Mat frame;
-        TimePoint frameStamp;
+    std::unique_ptr<FragmentUploader> uploader;
+    {
+        std::lock_guard<std::mutex> lk(segmentMutex);
+        auto it = uploaders.find(path);
+        if (it != uploaders.end())
         {
-            std::unique_lock<std::mutex> lk(queueMutex);
-            if (frameQueue.empty()) {
-                queueCondVar.wait_for(lk, std::chrono::milliseconds(100));
-                if (frameQueue.empty()) continue;
-            }
-            auto p = std::move(frameQueue.front());
-            frame = std::move(p.first);
-            frameStamp = p.second;
-            frameQueue.pop_front();
+            uploader = std::move(it->second);
+            uploaders.erase(it);
         }
-        if (frame.empty()) continue;
+    }
+    if (uploader)
+    {
+        // Most of the file is already queued; this sends the last fragments
+        uploader->finish();
+    }
 
-        // compute PTS from the capture timestamp stored with the frame
-        GstClockTime pts = 0;
-        GstClockTime duration_ns = 0;
+    std::cerr << "[GstRecorder] segment closed '" << path << "'\n";
+    {
+        std::lock_guard<std::mutex> lk(callbackMutex);
+        if (segmentCallback)
         {
-            auto tp = frameStamp;
-            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(tp - baseTime).count();
-            if (ns < 0) ns = 0;
-            pts = static_cast<GstClockTime>(ns);
-            duration_ns = frameDuration; // keep nominal duration
-        }
-        GstBuffer *buf = matToGstBuffer(frame, pts);
-        if (!buf) {
-            std::cerr << "Failed to create GstBuffer\n";
-            continue;
-        }
-        GstFlowReturn fret = gst_app_src_push_buffer(GST_APP_SRC(appsrc), buf);
-        if (fret != GST_FLOW_OK) {
-            std::cerr << "gst_app_src_push_buffer returned " << fret << std::endl;
-            // if push fails, free buffer and consider retrying or dropping
-            // gst_app_src_push_buffer consumes the buffer on GST_FLOW_OK, otherwise we must unref
-            if (fret != GST_FLOW_OK) {
-                // not accepted; unref (we already allocated)
-                // gst_app_src_push_buffer consumes the buffer on success; on error it's not consumed
-                gst_buffer_unref(buf);
-            }
-            // small sleep to avoid busy-looping on errors
-            std::this_thread::sleep_for(std::chrono::milliseconds(5));
-        } else {
-            // pushed successfully
-            if (debugPrintCount < 5)
-            {
-                std::cerr << "[GstRecorder] pushed frameIndex=" << frameIndex << " pts=" << pts << " duration=" << frameDuration << "\n";
-                ++debugPrintCount;
-            }
-            ++frameIndex;
+            segmentCallback(path, uploader != nullptr);
         }
     }
 
-    // end: nothing left to do; worker will exit and stop() will send EOS
+    {
+        std::lock_guard<std::mutex> lk(segmentMutex);
+        closedSegments.insert(path);
+    }
+    segmentCondVar.notify_all();
 }
 
-std::string GstRecorder::buildPipelineString()
+void GstRecorder::removeBranch()
 {
-    std::ostringstream ss;
-    // Request h264parse to periodically emit SPS/PPS (config-interval=1)
-    // and enable faststart on mp4mux so the moov atom is placed for easier playback.
-     // Do not set do-timestamp or is-live here — we will stamp buffers explicitly
-     ss << "appsrc name=src format=time block=true "
-         << "! videoconvert ! queue ! x264enc bitrate=" << bitrate_kbps
-       << " speed-preset=ultrafast tune=zerolatency ! "
-       << "h264parse config-interval=1 ! mp4mux faststart=true ! filesink location=" << filename;
-    return ss.str();
+    if (branch)
+    {
+        gst_element_set_state(branch, GST_STATE_NULL);
+    }
+    if (teePad)
+    {
+        gst_element_release_request_pad(tee, teePad);
+        gst_object_unref(teePad);
+        teePad = nullptr;
+    }
+    if (branchSinkPad)
+    {
+        gst_object_unref(branchSinkPad);
+        branchSinkPad = nullptr;
+    }
+    if (splitmux)
+    {
+        g_signal_handlers_disconnect_by_data(splitmux, this);
+        gst_object_unref(splitmux);
+        splitmux = nullptr;
+    }
+    if (branch)
+    {
+        // The pipeline held the only reference
+        gst_bin_remove(GST_BIN(pipeline), branch);
+        branch = nullptr;
+    }
+}
+
+gchar* GstRecorder::formatLocation(GstElement*, guint fragmentId, gpointer user_data)
+{
+    // Runs on the streaming thread as each segment is opened
+    auto* self = static_cast<GstRecorder*>(user_data);
+    std::string path = self->locationFunc(fragmentId);
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    self->segmentOpened(path);
+    return g_strdup(path.c_str());
+}
+
+GstPadProbeReturn GstRecorder::unlinkProbe(GstPad* pad, GstPadProbeInfo*, gpointer user_data)
+{
+    auto* self = static_cast<GstRecorder*>(user_data);
+    gst_pad_unlink(pad, self->branchSinkPad);
+    gst_pad_send_event(self->branchSinkPad, gst_event_new_eos());
+    return GST_PAD_PROBE_REMOVE;
 }
 
-GstBuffer* GstRecorder::matToGstBuffer(const cv::Mat& frame, GstClockTime pts)
+GstPadProbeReturn GstRecorder::eosProbe(GstPad*, GstPadProbeInfo* info, gpointer user_data)
 {
-    int bytes = frame.total() * frame.elemSize();
-    GstBuffer* buffer = gst_buffer_new_allocate(nullptr, bytes, nullptr);
-    GstMapInfo map;
-    if (gst_buffer_map(buffer, &map, GST_MAP_WRITE))
+    if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_EOS)
     {
-        // Copy row by row to handle possible padding
-        if (frame.isContinuous())
+        auto* self = static_cast<GstRecorder*>(user_data);
         {
-            memcpy(map.data, frame.data, bytes);
+            std::lock_guard<std::mutex> lk(self->segmentMutex);
+            self->eosReceived = true;
         }
-        else
+        self->segmentCondVar.notify_all();
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+GstFlowReturn GstRecorder::clipSample(GstAppSink* sink, gpointer user_data)
+{
+    auto* self = static_cast<GstRecorder*>(user_data);
+    GstSample* sample = gst_app_sink_pull_sample(sink);
+    if (sample)
+    {
+        // Place the access unit on the wall clock by when it was captured, not
+        // when it left the encoder
+        int64_t captureWallMs = 0;
+        GstBuffer* buffer = gst_sample_get_buffer(sample);
+        const GstSegment* segment = gst_sample_get_segment(sample);
+        if (self->branchStartWallMs > 0 && buffer && segment && GST_BUFFER_PTS_IS_VALID(buffer))
         {
-            uint8_t* destPtr = map.data;
-            for (int i = 0; i < frame.rows; ++i)
+            GstClockTime runningTime = gst_segment_to_running_time(segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+            if (GST_CLOCK_TIME_IS_VALID(runningTime))
             {
-                memcpy(destPtr, frame.ptr(i), frame.cols * frame.elemSize());
-                destPtr += frame.cols * frame.elemSize();
+                captureWallMs = self->branchStartWallMs + static_cast<int64_t>(runningTime / GST_MSECOND);
             }
         }
-        gst_buffer_unmap(buffer, &map);
+        self->clips.push(sample, captureWallMs);
+        gst_sample_unref(sample);
     }
-    else
+    return GST_FLOW_OK;
+}
+
+void GstRecorder::clipEos(GstAppSink*, gpointer user_data)
+{
+    auto* self = static_cast<GstRecorder*>(user_data);
     {
-        gst_buffer_unref(buffer);
-        return nullptr;
+        std::lock_guard<std::mutex> lk(self->segmentMutex);
+        self->eosReceived = true;
     }
+    self->segmentCondVar.notify_all();
+}
 
-    GST_BUFFER_PTS(buffer) = pts;
-    GST_BUFFER_DTS(buffer) = pts;
-    GST_BUFFER_DURATION(buffer) = frameDuration;
-    return buffer;
-}
\ No newline at end of file
+std::string GstRecorder::buildBranchString(const std::string& preset)
+{
+    std::ostringstream ss;
+    // A leaky queue: if the encoder falls behind it drops frames rather than
+    // stalling the tee and with it inference. videoconvert is a passthrough when
+    // the camera already delivers NV12/I420; the caps keep x264enc from
+    // negotiating a 4:2:2/4:4:4 profile that players reject for YUY2 cameras.
+    // key-int-max is the quiet-scene GOP; EncoderController forces shorter ones
+    // while people are in view. splitmuxsink holds back one GOP to find the
+    // split point, which stays small at the quiet bitrate.
+    ss << "queue name=recqueue leaky=downstream max-size-buffers=0 max-size-bytes=0 max-size-time=2000000000 "
+       << "! videoconvert ! video/x-raw,format=(string){NV12,I420} ! x264enc name=encoder bitrate="
+       << encoderControl.initialBitrateKbps(bitrate_kbps) << " speed-preset=" << preset
+       << " tune=zerolatency key-int-max=" << encoderControl.keyIntMax() << " ! ";
+    if (eventClips)
+    {
+        // Byte-stream with SPS/PPS in front of every keyframe (config-interval=-1)
+        // so a clip can start at any GOP in ClipRecorder's ring
+        ss << "h264parse config-interval=-1 ! video/x-h264,stream-format=byte-stream,alignment=au "
+           << "! appsink name=clipsink sync=false emit-signals=false max-buffers=0 drop=false";
+        return ss.str();
+    }
+    // Request h264parse to periodically emit SPS/PPS (config-interval=1)
+    ss << "h264parse config-interval=1 ! splitmuxsink name=splitmux async-finalize=false"
+       << " max-size-time=" << static_cast<guint64>(segmentDuration.count()) * GST_SECOND
+       << " max-size-bytes=" << segmentBytes;
+    if (segmentDuration.count() > 0)
+    {
+        // Ask the encoder for a keyframe right at the limit instead of waiting for the next GOP
+        ss << " send-keyframes=true";
+    }
+    return ss.str();
+}
@@ -1,75 +1,169 @@
 #pragma once
 
-#include <opencv2/opencv.hpp>
+#include "ClipRecorder.h"
+#include "EncoderController.h"
+#include "FragmentUploader.h"
+
 #include <gst/gst.h>
-#include <gst/app/gstappsrc.h>
+#include <gst/app/gstappsink.h>
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
-#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
-#include <thread>
-#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
 
+// Records the camera stream by hanging an encoder branch off the capture
+// pipeline's tee: queue ! videoconvert ! x264enc ! h264parse ! splitmuxsink.
+// Frames reach the encoder in the camera's native format without leaving
+// GStreamer.
+//
+// The branch lives from start() to stop(). In between, splitmuxsink cuts the
+// stream into segments on keyframes, either on its own once a segment reaches
+// the configured duration or size, or when rotate() is called. The encoder
+// and the tee never stop, so rotating loses no frames and never blocks the
+// caller. Every finished segment is announced through the segment callback.
+//
+// Bitrate, frame rate and keyframe spacing follow the scene and the CPU load
+// (see EncoderController.h); the configured bitrate is the ceiling.
+//
+// In event-clip mode the branch ends in an appsink instead, and ClipRecorder
+// keeps only the footage around activity (see ClipRecorder.h); finished clips
+// go through the same segment callback.
 class GstRecorder
 {
+public:
+    // Picks the file name for segment n (0 for the first one of a recording)
+    using LocationFunc = std::function<std::string(unsigned segment)>;
+    // A segment file is complete. uploadedWhileRecording: FragmentUploader has
+    // already queued every byte of it.
+    using SegmentFunc = std::function<void(const std::string& path, bool uploadedWhileRecording)>;
+
 public:
     GstRecorder();
     ~GstRecorder();
 
-    bool configure(int width, int height, double fps, int bitrate_kbps = 2000, size_t maxQueueSize = 30) 
+    // The branch is added to pipeline and fed from a request pad of tee.
+    void attach(GstElement* pipeline, GstElement* tee);
+
+    bool configure(int bitrate_kbps = 2000)
     {
         if (running.load()) return false;
-        
-        this->width = width;
-        this->height = height;
-        this->fps = fps;
+
         this->bitrate_kbps = bitrate_kbps;
-        this->maxQueueSize = maxQueueSize;
         return true;
     }
-    
-    bool start(const std::string& filename, int width, int height, double fps, int bitrate_kbps = 2000, size_t maxQueueSize = 30);
+
+    // Fragmented MP4: the file is playable up to the last finished fragment even
+    // if we crash, and with uploadWhileRecording each batch of fragments is
+    // queued for upload as soon as it is on disk. 0 restores a plain MP4.
+    bool configureFragments(int fragmentDurationMs, bool uploadWhileRecording = true)
+    {
+        if (running.load()) return false;
+
+        this->fragmentDurationMs = fragmentDurationMs;
+        this->uploadWhileRecording = uploadWhileRecording && fragmentDurationMs > 0;
+        return true;
+    }
+
+    // Start a new segment automatically once the current one is this long or
+    // this large. 0 disables the limit; rotate() always works.
+    bool configureSegments(std::chrono::seconds maxDuration, uint64_t maxBytes = 0)
+    {
+        if (running.load()) return false;
+
+        segmentDuration = maxDuration;
+        segmentBytes = maxBytes;
+        return true;
+    }
+
+    // Record only around activity instead of continuously. Takes effect on the
+    // next start().
+    bool configureEventClips(bool enabled, const ClipRecorder::Options& options = ClipRecorder::Options{})
+    {
+        if (running.load()) return false;
+
+        eventClips = enabled;
+        clips.configure(options);
+        return true;
+    }
+    bool eventClipsEnabled() const { return eventClips; }
+    // Event-clip mode: someone is in view / a person was counted
+    void markActivity() { clips.markActivity(); }
+    void addEvent(const MetricEvent& event) { clips.addEvent(event); }
+
+    void configureEncoderControl(const EncoderController::Options& options) { encoderControl.configure(options); }
+    // Detection thread: people currently tracked
+    void setSceneActivity(int liveTracks) { encoderControl.setActivity(liveTracks); }
+    EncoderController::Stats encoderStats() const { return encoderControl.getStats(); }
+    std::string encoderStatsJson() const { return encoderControl.statsJson(); }
+
+    // Called on the capture pipeline's bus thread, or the clip finisher thread
+    // in event-clip mode
+    void setSegmentCallback(SegmentFunc fn);
+
+    bool start(const LocationFunc& location, int bitrate_kbps);
+    bool start(const std::string& filename, int bitrate_kbps);
     bool start(const std::string& filename);
-    bool pushFrame(const cv::Mat& frame);
     bool isRunning() const {
         return running.load();
     }
-    void stop(bool upload = false);
+    // Close the current segment at the next GOP boundary and continue in a new
+    // file. Returns immediately. Not used in event-clip mode.
+    bool rotate();
+    void stop();
 
-private:
-    void recorderThreadFunc();
+    // Bus messages from the capture pipeline; picks out splitmuxsink's
+    // fragment-closed notifications.
+    void handleBusMessage(GstMessage* message);
 
-    std::string buildPipelineString();
+private:
+    std::string buildBranchString(const std::string& preset);
+    void removeBranch();
+    void segmentOpened(const std::string& path);
+    void segmentClosed(const std::string& path);
 
-    GstBuffer* matToGstBuffer(const cv::Mat& frame, GstClockTime pts);
+    static gchar* formatLocation(GstElement* splitmux, guint fragmentId, gpointer user_data);
+    static GstPadProbeReturn unlinkProbe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstPadProbeReturn eosProbe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+    static GstFlowReturn clipSample(GstAppSink* sink, gpointer user_data);
+    static void clipEos(GstAppSink* sink, gpointer user_data);
 
 private:
-    // GStreamer objects
     GstElement* pipeline{ nullptr };
-    GstAppSrc* appsrc{ nullptr };
+    GstElement* tee{ nullptr };
+    GstElement* branch{ nullptr };
+    GstElement* splitmux{ nullptr };
+    GstPad* teePad{ nullptr };
+    GstPad* branchSinkPad{ nullptr };
+    int64_t branchStartWallMs = 0; // wall clock at running time 0 of the branch
 
-    // store frame with its capture timestamp (steady clock)
-    using TimePoint = std::chrono::steady_clock::time_point;
-    std::deque<std::pair<cv::Mat, TimePoint>> frameQueue;
-    size_t maxQueueSize = 30;
-    std::mutex queueMutex;
-    std::condition_variable queueCondVar;
+    LocationFunc locationFunc;
+    std::mutex callbackMutex;
+    SegmentFunc segmentCallback;
+
+    // Segment bookkeeping, shared by the streaming thread (opened), the bus
+    // thread (closed) and stop()
+    std::mutex segmentMutex;
+    std::condition_variable segmentCondVar;
+    std::string currentSegment;
+    std::unordered_set<std::string> closedSegments;
+    bool eosReceived = false; // EOS has reached splitmuxsink (or the clip appsink); no more segments will open
+    std::unordered_map<std::string, std::unique_ptr<FragmentUploader>> uploaders;
 
-    std::thread recorderThread;
     std::atomic<bool> running{ false };
-    std::atomic<bool> stopRequested{ false };
 
-    std::string filename;
-    int width = 0;
-    int height = 0;
-    double fps = 0.0;
+    bool eventClips = false;
+    ClipRecorder clips;
+    EncoderController encoderControl;
+
     int bitrate_kbps = 2000;
-    uint64_t frameIndex = 0;
-    GstClockTime frameDuration = 0;
-    // small runtime debug counter to print first few PTS values
-    int debugPrintCount = 0;
-    // base time recorded at start() used to compute PTS from capture timestamps
-    TimePoint baseTime;
-};
\ No newline at end of file
+    int fragmentDurationMs = 0;
+    bool uploadWhileRecording = false;
+    std::chrono::seconds segmentDuration{ 0 };
+    uint64_t segmentBytes = 0;
+};
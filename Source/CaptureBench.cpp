@@ -0,0 +1,136 @@
+#include "Camera/CameraFrame.h"
+#include "ImageRec/YoloModel.h"
+
+#include <gst/app/gstappsink.h>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <opencv2/imgproc.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// CPU per frame of the capture graph with videotestsrc standing in for the
+// camera. "bgr" is the old graph: the source converted to BGR at full
+// resolution, converted back to I420 for x264 and to RGB before the YOLO
+// resize. "yuv" keeps NV12 throughout and lets YOLOModel convert while it
+// letterboxes. Both encode with x264 and build the 640x640 input blob for
+// every frame; no model is loaded.
+// Usage: CaptureBench [frames] [width] [height]
+namespace
+{
+double ProcessCpuSeconds()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+std::string Pipeline(bool bgr, int frames, int w, int h)
+{
+    std::ostringstream ss;
+    ss << "videotestsrc num-buffers=" << frames << " pattern=ball ! video/x-raw,format=NV12,width=" << w
+       << ",height=" << h << ",framerate=30/1 ";
+    if (bgr)
+    {
+        ss << "! videoconvert ! video/x-raw,format=BGR ";
+    }
+    ss << "! tee name=t "
+       << "t. ! queue ! videoconvert ! video/x-raw,format=(string){NV12,I420} "
+       << "! x264enc speed-preset=ultrafast tune=zerolatency ! fakesink sync=false "
+       << "t. ! queue ! appsink name=appsink sync=false max-buffers=2 drop=false";
+    return ss.str();
+}
+
+bool Run(const std::string& name, bool bgr, int frames, int w, int h)
+{
+    GError* error = nullptr;
+    GstElement* pipeline = gst_parse_launch(Pipeline(bgr, frames, w, h).c_str(), &error);
+    if (!pipeline)
+    {
+        std::cerr << "gst_parse_launch failed: " << (error ? error->message : "unknown error") << std::endl;
+        if (error) g_error_free(error);
+        return false;
+    }
+    GstAppSink* appsink = GST_APP_SINK(gst_bin_get_by_name(GST_BIN(pipeline), "appsink"));
+
+    YOLOModel model;
+    YOLOModel::Letterbox letterbox;
+    int pulled = 0;
+    double preprocessMs = 0.0;
+
+    double cpu0 = ProcessCpuSeconds();
+    auto wall0 = std::chrono::steady_clock::now();
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    while (GstSample* sample = gst_app_sink_pull_sample(appsink))
+    {
+        GstVideoInfo info;
+        GstBuffer* buffer = gst_sample_get_buffer(sample);
+        GstMapInfo map;
+        if (gst_video_info_from_caps(&info, gst_sample_get_caps(sample)) && gst_buffer_map(buffer, &map, GST_MAP_READ))
+        {
+            // videotestsrc planes are packed, so the single-Mat layout holds
+            CameraFrame frame;
+            frame.width = w;
+            frame.height = h;
+            const int stride = GST_VIDEO_INFO_PLANE_STRIDE(&info, 0);
+
+            auto t0 = std::chrono::steady_clock::now();
+            cv::Mat blob;
+            if (bgr)
+            {
+                // What the detection thread did before: full-frame BGR->RGB, then
+                // resize, then blobFromImage(swapRB) inside detect()
+                cv::Mat rgb;
+                cv::cvtColor(cv::Mat(h, w, CV_8UC3, map.data, stride), rgb, cv::COLOR_BGR2RGB);
+                frame.image = rgb;
+                frame.format = PixelFormat::BGR;
+                blob = model.preprocess(frame, letterbox);
+            }
+            else
+            {
+                frame.image = cv::Mat(h * 3 / 2, w, CV_8UC1, map.data, stride);
+                frame.format = PixelFormat::NV12;
+                blob = model.preprocess(frame, letterbox);
+            }
+            preprocessMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            gst_buffer_unmap(buffer, &map);
+            ++pulled;
+        }
+        gst_sample_unref(sample);
+    }
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+    double cpuSeconds = ProcessCpuSeconds() - cpu0;
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(appsink);
+    gst_object_unref(pipeline);
+
+    if (pulled == 0)
+    {
+        std::cerr << name << ": no frames" << std::endl;
+        return false;
+    }
+    std::cout << std::fixed << std::setprecision(2) << name << ": " << pulled << " frames, "
+              << cpuSeconds * 1000.0 / pulled << " ms CPU/frame (" << preprocessMs / pulled
+              << " ms of it YOLO preprocessing), " << pulled / wallSeconds << " fps" << std::endl;
+    return true;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int frames = argc > 1 ? std::atoi(argv[1]) : 300;
+    int w = argc > 2 ? std::atoi(argv[2]) : 1920;
+    int h = argc > 3 ? std::atoi(argv[3]) : 1080;
+
+    gst_init(&argc, &argv);
+    std::cout << w << "x" << h << ", x264 ultrafast, 640x640 YOLO input\n";
+    bool ok = Run("bgr", true, frames, w, h);
+    ok = Run("yuv", false, frames, w, h) && ok;
+    return ok ? 0 : 1;
+}
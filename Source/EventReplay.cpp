@@ -0,0 +1,28 @@
+#include "Metrics/MetricTracker.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+// Rebuild hourly metrics from an event log, e.g. after a tracker fix.
+// Usage: EventReplay [eventDir] [outputJson]
+int main(int argc, char** argv)
+{
+    std::string eventDir = argc > 1 ? argv[1] : "build/Data/Events";
+    std::string outputPath = argc > 2 ? argv[2] : "build/Data/Replay.json";
+
+    MetricTracker metricTracker;
+    auto t0 = std::chrono::steady_clock::now();
+    size_t replayed = metricTracker.ReplayEventLog(eventDir);
+    auto t1 = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(t1 - t0).count();
+
+    std::cout << "Replayed " << replayed << " events in " << secs << " s";
+    if (secs > 0.0)
+    {
+        std::cout << " (" << static_cast<long long>(replayed / secs) << " events/s)";
+    }
+    std::cout << std::endl;
+
+    return metricTracker.WriteToFile(outputPath) ? 0 : 1;
+}
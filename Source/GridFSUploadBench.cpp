@@ -0,0 +1,105 @@
+#include "Metrics/MongoLink.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <mongocxx/client.hpp>
+#include <mongocxx/instance.hpp>
+#include <mongocxx/uri.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+// Compares the old 4 KiB ifstream upload loop with MongoLink::WriteGridFSFile
+// against a local mongod. Writes a scratch file, uploads it with each method
+// into a throwaway database and prints MB/s and CPU seconds per GB.
+// Usage: GridFSUploadBench [sizeMB] [mongodb://localhost:27017]
+namespace
+{
+double ThreadCpuSeconds()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+MongoLink::UploadStats LegacyUpload(mongocxx::gridfs::bucket& bucket, const std::string& path, const std::string& name)
+{
+    MongoLink::UploadStats stats;
+    auto wallStart = std::chrono::steady_clock::now();
+    double cpuStart = ThreadCpuSeconds();
+
+    std::ifstream ifs(path, std::ios::binary);
+    auto uploader = bucket.open_upload_stream(name);
+    const size_t bufferSize = 4096;
+    std::vector<char> buffer(bufferSize);
+    while (ifs)
+    {
+        ifs.read(buffer.data(), bufferSize);
+        std::streamsize bytesRead = ifs.gcount();
+        if (bytesRead > 0)
+        {
+            uploader.write(reinterpret_cast<const uint8_t*>(buffer.data()), static_cast<size_t>(bytesRead));
+            stats.bytes += static_cast<uint64_t>(bytesRead);
+        }
+    }
+    uploader.close();
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    stats.cpuSeconds = ThreadCpuSeconds() - cpuStart;
+    return stats;
+}
+
+void Report(const std::string& label, const MongoLink::UploadStats& stats)
+{
+    double megabytes = static_cast<double>(stats.bytes) / (1024.0 * 1024.0);
+    std::cout << "  " << label << megabytes / stats.seconds << " MB/s, "
+              << stats.cpuSeconds * 1024.0 / megabytes << " CPU s/GB\n";
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int sizeMb = argc > 1 ? std::atoi(argv[1]) : 256;
+    std::string uri = argc > 2 ? argv[2] : "mongodb://localhost:27017";
+    const std::string path = "/tmp/gridfs_bench.bin";
+
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        std::mt19937_64 rng(42);
+        std::vector<uint64_t> block(1024 * 1024 / sizeof(uint64_t));
+        for (int i = 0; i < sizeMb; ++i)
+        {
+            for (auto& word : block)
+            {
+                word = rng();
+            }
+            out.write(reinterpret_cast<const char*>(block.data()), static_cast<std::streamsize>(block.size() * sizeof(uint64_t)));
+        }
+    }
+
+    mongocxx::instance instance;
+    mongocxx::client client{ mongocxx::uri{ uri } };
+    auto db = client["MarbleGridFSBench"];
+    auto bucket = db.gridfs_bucket();
+
+    std::cout << sizeMb << " MB file, " << uri << "\n";
+    Report("ifstream 4 KiB, 255 KiB chunks:  ", LegacyUpload(bucket, path, "legacy"));
+
+    for (int32_t chunk : { 255 * 1024, MongoLink::kDefaultVideoChunkBytes, 4 * 1024 * 1024 })
+    {
+        MongoLink::UploadStats stats;
+        if (!MongoLink::WriteGridFSFile(bucket, path, "mmap" + std::to_string(chunk), chunk, &stats))
+        {
+            return 1;
+        }
+        Report("mmap, " + std::to_string(chunk / 1024) + " KiB chunks:" + std::string(13 - std::to_string(chunk / 1024).size(), ' '), stats);
+    }
+
+    db.drop();
+    std::remove(path.c_str());
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "YoloModel.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <fstream>
 #include <iomanip>
@@ -163,46 +164,184 @@ bool YOLOModel::loadLabels(const std::string &labelsPath)
     return !labels.empty();
 }
 
+namespace
+{
+// BT.601 limited range: the same coefficients cv::COLOR_YUV2RGB_NV12 uses
+inline void YuvToRgb(float y, float u, float v, float &r, float &g, float &b)
+{
+    const float c = 1.164f * (y - 16.0f);
+    const float d = u - 128.0f;
+    const float e = v - 128.0f;
+    r = c + 1.596f * e;
+    g = c - 0.813f * e - 0.391f * d;
+    b = c + 2.018f * d;
+}
+
+inline float ToUnit(float v)
+{
+    return std::min(std::max(v, 0.0f), 255.0f) * (1.0f / 255.0f);
+}
+} // namespace
+
 std::vector<YoloDetection> YOLOModel::detect(const cv::Mat &img, float confThresh, float iouThresh)
 {
-    // Use stricter default thresholds if not provided
-    if (confThresh < 1e-4f)
-        confThresh = 0.5f;
-    if (iouThresh < 1e-4f)
-        iouThresh = 0.5f;
-    std::vector<YoloDetection> results;
+    CameraFrame frame;
+    frame.image = img;
+    frame.format = PixelFormat::BGR;
+    frame.width = img.cols;
+    frame.height = img.rows;
+    return detect(frame, confThresh, iouThresh);
+}
+
+std::vector<YoloDetection> YOLOModel::detect(const CameraFrame &frame, float confThresh, float iouThresh)
+{
+    // The tracker maps are only touched on this thread; a reset from elsewhere lands here
+    if (resetTracksRequested.load(std::memory_order_relaxed) &&
+        resetTracksRequested.exchange(false, std::memory_order_acquire))
+    {
+        resetTracks();
+    }
     if (!net)
     {
         std::cerr << "[YOLOModel::detect] network not loaded" << std::endl;
-        return results;
+        return {};
     }
-    if (img.empty())
-        return results;
+    if (frame.image.empty())
+        return {};
+
+    Letterbox letterbox;
+    cv::Mat blob = preprocess(frame, letterbox);
+    return detectBlob(blob, letterbox, confThresh, iouThresh, frame.captureWallMs);
+}
 
+YOLOModel::Letterbox YOLOModel::computeLetterbox(int width, int height) const
+{
     // Letterbox-resize the image to preserve aspect ratio and map back to original coords
-    int origW = img.cols;
-    int origH = img.rows;
-    int inpW = inputSize.width;
-    int inpH = inputSize.height;
-    float r = std::min((float)inpW / origW, (float)inpH / origH);
-    int newW = std::max(1, (int)std::round(origW * r));
-    int newH = std::max(1, (int)std::round(origH * r));
-    int padW = inpW - newW;
-    int padH = inpH - newH;
-    int padLeft = padW / 2;
-    int padTop = padH / 2;
-
-    cv::Mat resized = cv::Mat::zeros(inpH, inpW, img.type());
+    Letterbox lb;
+    lb.origW = width;
+    lb.origH = height;
+    lb.scale = std::min((float)inputSize.width / width, (float)inputSize.height / height);
+    lb.newW = std::max(1, (int)std::round(width * lb.scale));
+    lb.newH = std::max(1, (int)std::round(height * lb.scale));
+    lb.padLeft = (inputSize.width - lb.newW) / 2;
+    lb.padTop = (inputSize.height - lb.newH) / 2;
+    return lb;
+}
+
+cv::Mat YOLOModel::preprocess(const CameraFrame &frame, Letterbox &letterbox) const
+{
+    letterbox = computeLetterbox(frame.width, frame.height);
+    if (frame.format != PixelFormat::BGR)
+    {
+        return yuvToBlob(frame, letterbox);
+    }
+
+    const cv::Mat &img = frame.image;
+    cv::Mat resized = cv::Mat::zeros(inputSize.height, inputSize.width, img.type());
     cv::Mat tmp;
-    cv::resize(img, tmp, cv::Size(newW, newH));
-    tmp.copyTo(resized(cv::Rect(padLeft, padTop, newW, newH)));
+    cv::resize(img, tmp, cv::Size(letterbox.newW, letterbox.newH));
+    tmp.copyTo(resized(cv::Rect(letterbox.padLeft, letterbox.padTop, letterbox.newW, letterbox.newH)));
+
+    // swapRB: the network wants RGB
+    return cv::dnn::blobFromImage(resized, 1.0 / 255.0, inputSize, cv::Scalar(), true, false);
+}
+
+// Letterbox, bilinear downscale, YUV->RGB and the NCHW float layout in one pass
+// over the output. Only inputSize pixels are ever converted, and no full-size
+// RGB or resized intermediate is allocated. Luma is interpolated; chroma is
+// taken from the nearest 2x2 block, which is all the detail 4:2:0 carries.
+cv::Mat YOLOModel::yuvToBlob(const CameraFrame &frame, const Letterbox &lb) const
+{
+    const int inpW = inputSize.width;
+    const int inpH = inputSize.height;
+    const int sizes[] = {1, 3, inpH, inpW};
+    cv::Mat blob(4, sizes, CV_32F, cv::Scalar(0));
+    float *planeR = blob.ptr<float>();
+    float *planeG = planeR + (size_t)inpW * inpH;
+    float *planeB = planeG + (size_t)inpW * inpH;
+
+    const int w = frame.width;
+    const int h = frame.height;
+    const bool nv12 = frame.format == PixelFormat::NV12;
+    const size_t yStride = frame.image.step;
+    const size_t cStride = nv12 ? yStride : yStride / 2;
+    const uint8_t *yPlane = frame.image.data;
+    const uint8_t *uPlane = yPlane + yStride * h;
+    const uint8_t *vPlane = nv12 ? uPlane + 1 : uPlane + cStride * (h / 2);
+    const int cStep = nv12 ? 2 : 1;
+
+    // Horizontal taps are the same on every row
+    const float inv = 1.0f / lb.scale;
+    std::vector<int> x0(lb.newW), x1(lb.newW), cx(lb.newW);
+    std::vector<float> fx(lb.newW);
+    for (int x = 0; x < lb.newW; ++x)
+    {
+        float sx = std::min(std::max((x + 0.5f) * inv - 0.5f, 0.0f), w - 1.0f);
+        x0[x] = (int)sx;
+        x1[x] = std::min(x0[x] + 1, w - 1);
+        fx[x] = sx - x0[x];
+        cx[x] = std::min((int)((x + 0.5f) * inv), w - 1) / 2 * cStep;
+    }
+
+    cv::parallel_for_(cv::Range(0, lb.newH), [&](const cv::Range &rows)
+    {
+        for (int y = rows.start; y < rows.end; ++y)
+        {
+            float sy = std::min(std::max((y + 0.5f) * inv - 0.5f, 0.0f), h - 1.0f);
+            int y0 = (int)sy;
+            float fy = sy - y0;
+            const uint8_t *row0 = yPlane + y0 * yStride;
+            const uint8_t *row1 = yPlane + std::min(y0 + 1, h - 1) * yStride;
+            size_t chromaRow = (std::min((int)((y + 0.5f) * inv), h - 1) / 2) * cStride;
+            const uint8_t *uRow = uPlane + chromaRow;
+            const uint8_t *vRow = vPlane + chromaRow;
+
+            size_t out = (size_t)(y + lb.padTop) * inpW + lb.padLeft;
+            for (int x = 0; x < lb.newW; ++x, ++out)
+            {
+                float top = row0[x0[x]] + (row0[x1[x]] - row0[x0[x]]) * fx[x];
+                float bottom = row1[x0[x]] + (row1[x1[x]] - row1[x0[x]]) * fx[x];
+                float r, g, b;
+                YuvToRgb(top + (bottom - top) * fy, uRow[cx[x]], vRow[cx[x]], r, g, b);
+                planeR[out] = ToUnit(r);
+                planeG[out] = ToUnit(g);
+                planeB[out] = ToUnit(b);
+            }
+        }
+    });
+    return blob;
+}
+
+std::vector<YoloDetection> YOLOModel::detectBlob(const cv::Mat &blob, const Letterbox &lb,
+                                                 float confThresh, float iouThresh, int64_t frameTimeMs)
+{
+    // Use stricter default thresholds if not provided
+    if (confThresh < 1e-4f)
+        confThresh = 0.5f;
+    if (iouThresh < 1e-4f)
+        iouThresh = 0.5f;
+    std::vector<YoloDetection> results;
+
+    // Box decoding below maps network coords back through the letterbox
+    const int origW = lb.origW;
+    const int origH = lb.origH;
+    const int inpW = inputSize.width;
+    const int inpH = inputSize.height;
+    const float r = lb.scale;
+    const int padLeft = lb.padLeft;
+    const int padTop = lb.padTop;
 
-    cv::Mat blob =
-        cv::dnn::blobFromImage(resized, 1.0 / 255.0, inputSize, cv::Scalar(), true, false);
     try
     {
         // advance frame counter for tracking/persistence
         ++frameIndex;
+        startedTracks.clear();
+        expiredTracks.clear();
+        // Track lifetimes are measured in capture time; frames without one (plain
+        // cv::Mat input) use the time of detection
+        const int64_t nowMs = frameTimeMs > 0 ? frameTimeMs
+                                              : std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                    std::chrono::system_clock::now().time_since_epoch()).count();
         net->setInput(blob);
         cv::Mat out = net->forward();
         if (out.empty())
@@ -631,11 +770,14 @@ std::vector<YoloDetection> YOLOModel::detect(const cv::Mat &img, float confThres
             else
             {
                 d.trackId = nextTrackId++;
+                trackLifetimes[d.trackId] = TrackLifetime{ d.trackId, nowMs, nowMs };
+                startedTracks.push_back(trackLifetimes[d.trackId]);
             }
             // update persistent maps
             trackLastBox[d.trackId] = d.box;
             trackLastScore[d.trackId] = d.score;
             trackLastSeen[d.trackId] = frameIndex;
+            trackLifetimes[d.trackId].lastSeenMs = nowMs;
             matchedTracks.insert(d.trackId);
         }
 
@@ -661,6 +803,26 @@ std::vector<YoloDetection> YOLOModel::detect(const cv::Mat &img, float confThres
             }
         }
 
+        // Forget tracks that have been lost for too long and report their lifetime
+        for (auto it = trackLastSeen.begin(); it != trackLastSeen.end();)
+        {
+            int tid = it->first;
+            if (frameIndex - it->second <= expireAfterFrames)
+            {
+                ++it;
+                continue;
+            }
+            auto lifetime = trackLifetimes.find(tid);
+            if (lifetime != trackLifetimes.end())
+            {
+                expiredTracks.push_back(lifetime->second);
+                trackLifetimes.erase(lifetime);
+            }
+            trackLastBox.erase(tid);
+            trackLastScore.erase(tid);
+            it = trackLastSeen.erase(it);
+        }
+
         // Save for next-frame matching and return
         prevDetections = finalDets;
         results = finalDets;
@@ -673,6 +835,19 @@ std::vector<YoloDetection> YOLOModel::detect(const cv::Mat &img, float confThres
     return results;
 }
 
+void YOLOModel::resetTracks()
+{
+    prevDetections.clear();
+    nextTrackId = 1;
+    // Track IDs restart at 1, so drop every per-track map as well
+    trackLastSeen.clear();
+    trackLastBox.clear();
+    trackLastScore.clear();
+    trackLifetimes.clear();
+    startedTracks.clear();
+    expiredTracks.clear();
+}
+
 float YOLOModel::iou(const cv::Rect &a, const cv::Rect &b)
 {
     int x1 = std::max(a.x, b.x);
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "Camera/CameraFrame.h"
+
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <vector>
@@ -14,6 +18,12 @@ struct YoloDetection {
     int trackId;      // persistent ID assigned by a simple tracker
 };
 
+struct TrackLifetime {
+    int trackId;
+    int64_t firstSeenMs; // wall clock ms the first matching frame was captured
+    int64_t lastSeenMs;  // wall clock ms the last matching frame was captured
+};
+
 class YOLOModel
 {
 public:
@@ -24,21 +34,51 @@ public:
     // load labels (supports simple newline list or JSON array of strings)
     bool loadLabels(const std::string& labelsPath);
     
-    // Run detection on an image. Returns detections (with track IDs assigned).
+    // Run detection on a BGR image. Returns detections (with track IDs assigned).
     std::vector<YoloDetection> detect(const cv::Mat& img, float confThresh = 0.25f, float iouThresh = 0.45f);
+    // Run detection on a camera frame. NV12/I420 frames are converted to RGB only
+    // at input size, fused with the letterbox resize. Track times come from the
+    // frame's capture time.
+    std::vector<YoloDetection> detect(const CameraFrame& frame, float confThresh = 0.25f, float iouThresh = 0.45f);
+
+    // Where the image landed inside the network input
+    struct Letterbox
+    {
+        int origW = 0, origH = 0;
+        float scale = 1.0f;
+        int newW = 0, newH = 0;
+        int padLeft = 0, padTop = 0;
+    };
+    // Build the NCHW RGB input blob for a frame (public so benchmarks can time it)
+    cv::Mat preprocess(const CameraFrame& frame, Letterbox& letterbox) const;
 
     // Set the input size explicitly (width,height). If not set, default is 640x640.
     void setInputSize(const cv::Size &s) { inputSize = s; }
+    const cv::Size& getInputSize() const { return inputSize; }
 
-    // Reset simple tracker (clears previous tracks)
-    void resetTracks() { prevDetections.clear(); nextTrackId = 1; }
+    // Any thread: forget every track. Only raises a flag; the tracker state is
+    // cleared by the detection thread at the start of its next detect().
+    void requestTrackReset() { resetTracksRequested.store(true, std::memory_order_release); }
+
+    // Tracks that appeared / expired during the last detect() call
+    const std::vector<TrackLifetime>& getStartedTracks() const { return startedTracks; }
+    const std::vector<TrackLifetime>& getExpiredTracks() const { return expiredTracks; }
 
     // Tweak detection/post-processing behavior
     void setKeepAliveFrames(int k) { keepAliveFrames = k; }
+    void setExpireAfterFrames(int k) { expireAfterFrames = k; }
     void setMinBoxAreaRatio(float r) { minBoxAreaRatio = r; }
     void setMinBoxHeightRatio(float r) { minBoxHeightRatio = r; }
 
 private:
+    Letterbox computeLetterbox(int width, int height) const;
+    cv::Mat yuvToBlob(const CameraFrame& frame, const Letterbox& lb) const;
+    std::vector<YoloDetection> detectBlob(const cv::Mat& blob, const Letterbox& lb, float confThresh, float iouThresh,
+                                          int64_t frameTimeMs);
+
+    // Detection thread: clear the simple tracker (drops every track)
+    void resetTracks();
+
     // Utility: compute IoU between two boxes
     float iou(const cv::Rect &a, const cv::Rect &b);
 
@@ -52,9 +92,14 @@ private:
     std::vector<YoloDetection> prevDetections;
     int frameIndex = 0;
     int keepAliveFrames = 5; // how many frames to keep a lost track visible
+    int expireAfterFrames = 30; // how many frames before a lost track is forgotten
     float minBoxAreaRatio = 0.002f; // relative to image area
     float minBoxHeightRatio = 0.12f; // relative to image height
     std::unordered_map<int,int> trackLastSeen; // trackId -> last seen frameIndex
     std::unordered_map<int,cv::Rect> trackLastBox; // trackId -> last box
     std::unordered_map<int,float> trackLastScore; // trackId -> last score
+    std::unordered_map<int,TrackLifetime> trackLifetimes; // trackId -> first/last seen time
+    std::vector<TrackLifetime> startedTracks;
+    std::vector<TrackLifetime> expiredTracks;
+    std::atomic<bool> resetTracksRequested{ false };
 };
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "Metrics/MetricWriter.h"
+#include "Metrics/MongoLink.h"
+
+#include <bsoncxx/json.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <json.hpp>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+// Times metric export for a day of one-minute intervals: the old nlohmann tree
+// + pretty print + from_json round trip against the streaming writer and the
+// direct BSON builder. Nothing is uploaded.
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+std::vector<std::unique_ptr<MetricData>> MakeDay(int intervalSeconds)
+{
+    std::vector<std::unique_ptr<MetricData>> metrics;
+    std::time_t start = std::time(0);
+    start -= start % 86400;
+    for (std::time_t t = start; t < start + 86400; t += intervalSeconds)
+    {
+        std::tm startTm{};
+        std::tm endTm{};
+        std::time_t end = t + intervalSeconds;
+        localtime_r(&t, &startTm);
+        localtime_r(&end, &endTm);
+        int enter = static_cast<int>(t % 7);
+        int pass = static_cast<int>(t % 5);
+        metrics.push_back(std::make_unique<MetricData>(startTm, endTm, enter + pass, pass, enter));
+    }
+    return metrics;
+}
+
+template <typename Fn>
+double TimeMs(int iterations, Fn&& fn)
+{
+    auto t0 = Clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        fn();
+    }
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count() / iterations;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+    auto metrics = MakeDay(60);
+    const std::string treePath = "/tmp/metric_bench_tree.json";
+    const std::string streamPath = "/tmp/metric_bench_stream.json";
+
+    double treeMs = TimeMs(iterations, [&]
+    {
+        nlohmann::json metricsJson;
+        for (const auto& metric : metrics)
+        {
+            metricsJson[metric->name] = {
+                {"startTime", formatTime(metric->startTime)},
+                {"endTime", formatTime(metric->endTime)},
+                {"totalPeople", metric->totalPeople},
+                {"passCount", metric->passCount},
+                {"enterCount", metric->enterCount}
+            };
+        }
+        std::ofstream ofs(treePath);
+        ofs << std::setw(4) << metricsJson << std::endl;
+    });
+
+    double roundTripMs = TimeMs(iterations, [&]
+    {
+        std::ifstream ifs(treePath);
+        std::stringstream buffer;
+        buffer << ifs.rdbuf();
+        auto doc = bsoncxx::from_json(buffer.str());
+        (void)doc;
+    });
+
+    double streamMs = TimeMs(iterations, [&] { MetricWriter::WriteJsonFile(streamPath, metrics); });
+    double bsonMs = TimeMs(iterations, [&] { auto doc = MongoLink::BuildMetricDocument(metrics); (void)doc; });
+
+    std::cout << metrics.size() << " one-minute intervals, " << iterations << " iterations\n"
+              << "  nlohmann tree + setw(4) write:   " << treeMs << " ms\n"
+              << "  re-read + bsoncxx::from_json:    " << roundTripMs << " ms\n"
+              << "  MetricWriter streaming write:    " << streamMs << " ms\n"
+              << "  MongoLink::BuildMetricDocument:  " << bsonMs << " ms\n";
+    return 0;
+}
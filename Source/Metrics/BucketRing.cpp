@@ -0,0 +1,318 @@
+#include "BucketRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+constexpr uint32_t kRingMagic = 0x4D424B52; // "MBKR"
+constexpr uint32_t kRingVersion = 1;
+} // namespace
+
+static_assert(std::atomic<int64_t>::is_always_lock_free, "bucket epoch must be lock-free to live in shared memory");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "bucket counters must be lock-free to live in shared memory");
+static_assert(sizeof(BucketRing::Bucket) == 32, "bucket layout is part of the file format");
+
+BucketRing::~BucketRing()
+{
+    Close();
+}
+
+size_t BucketRing::MappedSize(uint32_t bucketCount)
+{
+    return sizeof(Header) + static_cast<size_t>(bucketCount) * sizeof(Bucket);
+}
+
+bool BucketRing::Open(const std::string& path, int bucketSeconds, uint32_t bucketCount, bool readOnly)
+{
+    Close();
+    if (bucketSeconds <= 0 || bucketCount == 0)
+    {
+        std::cerr << "[BucketRing] Open: invalid layout " << bucketSeconds << "s x " << bucketCount << std::endl;
+        return false;
+    }
+
+    if (!readOnly)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    }
+
+    fd = ::open(path.c_str(), readOnly ? O_RDONLY : (O_RDWR | O_CREAT), 0644);
+    if (fd < 0)
+    {
+        std::cerr << "[BucketRing] Open: failed to open " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat st{};
+    fstat(fd, &st);
+
+    // Reuse the existing layout when reading; when writing, the requested layout wins.
+    if (readOnly)
+    {
+        Header existing{};
+        if (st.st_size < static_cast<off_t>(sizeof(Header)) ||
+            ::pread(fd, &existing, sizeof(existing), 0) != static_cast<ssize_t>(sizeof(existing)) ||
+            existing.magic != kRingMagic || existing.version != kRingVersion ||
+            st.st_size < static_cast<off_t>(MappedSize(existing.bucketCount)))
+        {
+            std::cerr << "[BucketRing] Open: " << path << " is not a bucket ring" << std::endl;
+            Close();
+            return false;
+        }
+        bucketCount = existing.bucketCount;
+    }
+
+    size_t size = MappedSize(bucketCount);
+    bool fresh = static_cast<size_t>(st.st_size) != size;
+    if (!readOnly && fresh && ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        std::cerr << "[BucketRing] Open: failed to size " << path << ": " << std::strerror(errno) << std::endl;
+        Close();
+        return false;
+    }
+
+    void* mem = mmap(nullptr, size, readOnly ? PROT_READ : (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED)
+    {
+        std::cerr << "[BucketRing] Open: mmap failed: " << std::strerror(errno) << std::endl;
+        Close();
+        return false;
+    }
+    mappedSize = size;
+    header = static_cast<Header*>(mem);
+    buckets = reinterpret_cast<Bucket*>(static_cast<uint8_t*>(mem) + sizeof(Header));
+
+    if (!readOnly && (fresh || header->magic != kRingMagic || header->version != kRingVersion ||
+                      header->bucketSeconds != static_cast<uint32_t>(bucketSeconds) ||
+                      header->bucketCount != bucketCount))
+    {
+        if (!fresh)
+        {
+            std::cerr << "[BucketRing] Layout changed, reinitializing " << path << std::endl;
+        }
+        std::memset(mem, 0, size);
+        header->bucketSeconds = static_cast<uint32_t>(bucketSeconds);
+        header->bucketCount = bucketCount;
+        header->version = kRingVersion;
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic = kRingMagic;
+        msync(mem, size, MS_SYNC);
+    }
+    else if (!readOnly)
+    {
+        // A writer killed while recycling a slot leaves its claim (a negative
+        // start) on disk; nobody else is writing yet, so clear those slots.
+        for (uint32_t i = 0; i < bucketCount; ++i)
+        {
+            Bucket& bucket = buckets[i];
+            if (bucket.startEpoch.load(std::memory_order_relaxed) < 0)
+            {
+                bucket.enterCount.store(0, std::memory_order_relaxed);
+                bucket.passCount.store(0, std::memory_order_relaxed);
+                bucket.exitCount.store(0, std::memory_order_relaxed);
+                bucket.peakOccupancy.store(0, std::memory_order_relaxed);
+                bucket.startEpoch.store(0, std::memory_order_release);
+            }
+        }
+    }
+
+    return true;
+}
+
+void BucketRing::Close()
+{
+    if (header)
+    {
+        munmap(header, mappedSize);
+    }
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+    header = nullptr;
+    buckets = nullptr;
+    mappedSize = 0;
+    fd = -1;
+}
+
+int BucketRing::GetBucketSeconds() const
+{
+    return header ? static_cast<int>(header->bucketSeconds) : 0;
+}
+
+BucketRing::Bucket* BucketRing::Locate(std::time_t when)
+{
+    if (!header || when <= 0)
+    {
+        return nullptr;
+    }
+
+    const int64_t span = header->bucketSeconds;
+    const int64_t start = static_cast<int64_t>(when) - static_cast<int64_t>(when) % span;
+    Bucket& bucket = buckets[(start / span) % header->bucketCount];
+
+    // A claim is held for four stores; one that outlives this many yields was
+    // left by a writer that died mid-recycle (the file may be mapped by more
+    // than one process), so it is taken over.
+    const int kMaxClaimSpins = 10000;
+    int claimSpins = 0;
+    for (;;)
+    {
+        int64_t current = bucket.startEpoch.load(std::memory_order_acquire);
+        if (current == start)
+        {
+            return &bucket;
+        }
+        if (current > start)
+        {
+            // Slot already belongs to a newer period; this sample is too old to keep.
+            return nullptr;
+        }
+        if (current < 0 && ++claimSpins < kMaxClaimSpins)
+        {
+            // Another writer is recycling the slot right now.
+            std::this_thread::yield();
+            continue;
+        }
+        if (current < 0 && -current > start)
+        {
+            // Abandoned claim for a newer period; this sample is too old either way
+            return nullptr;
+        }
+
+        // Claim the stale (or abandoned) slot, clear it, then publish the new start time.
+        if (bucket.startEpoch.compare_exchange_weak(current, -start, std::memory_order_acq_rel))
+        {
+            bucket.enterCount.store(0, std::memory_order_relaxed);
+            bucket.passCount.store(0, std::memory_order_relaxed);
+            bucket.exitCount.store(0, std::memory_order_relaxed);
+            bucket.peakOccupancy.store(0, std::memory_order_relaxed);
+            bucket.startEpoch.store(start, std::memory_order_release);
+            return &bucket;
+        }
+    }
+}
+
+const BucketRing::Bucket* BucketRing::Find(std::time_t bucketStart) const
+{
+    const int64_t span = header->bucketSeconds;
+    const Bucket& bucket = buckets[(static_cast<int64_t>(bucketStart) / span) % header->bucketCount];
+    return bucket.startEpoch.load(std::memory_order_acquire) == bucketStart ? &bucket : nullptr;
+}
+
+void BucketRing::AddEnter(std::time_t when)
+{
+    if (Bucket* bucket = Locate(when))
+    {
+        bucket->enterCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void BucketRing::AddPass(std::time_t when)
+{
+    if (Bucket* bucket = Locate(when))
+    {
+        bucket->passCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void BucketRing::AddExit(std::time_t when)
+{
+    if (Bucket* bucket = Locate(when))
+    {
+        bucket->exitCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void BucketRing::UpdateOccupancy(std::time_t when, uint32_t occupancy)
+{
+    if (Bucket* bucket = Locate(when))
+    {
+        uint32_t peak = bucket->peakOccupancy.load(std::memory_order_relaxed);
+        while (occupancy > peak &&
+               !bucket->peakOccupancy.compare_exchange_weak(peak, occupancy, std::memory_order_relaxed))
+        {
+        }
+    }
+}
+
+void BucketRing::Flush()
+{
+    if (header)
+    {
+        msync(header, mappedSize, MS_ASYNC);
+    }
+}
+
+void BucketRing::ForEachBucket(std::time_t from, std::time_t to,
+                               const std::function<void(const BucketView&)>& fn) const
+{
+    if (!header || to <= from)
+    {
+        return;
+    }
+
+    const std::time_t span = header->bucketSeconds;
+    // Never scan more than one lap of the ring
+    std::time_t first = from - from % span;
+    if (to - first > span * static_cast<std::time_t>(header->bucketCount))
+    {
+        first = to - span * static_cast<std::time_t>(header->bucketCount);
+        first -= first % span;
+    }
+
+    for (std::time_t start = first; start < to; start += span)
+    {
+        if (start < from)
+        {
+            continue;
+        }
+        const Bucket* bucket = Find(start);
+        if (!bucket)
+        {
+            continue;
+        }
+
+        BucketView view{};
+        view.start = start;
+        view.enterCount = bucket->enterCount.load(std::memory_order_relaxed);
+        view.passCount = bucket->passCount.load(std::memory_order_relaxed);
+        view.exitCount = bucket->exitCount.load(std::memory_order_relaxed);
+        view.peakOccupancy = bucket->peakOccupancy.load(std::memory_order_relaxed);
+        // Skip a bucket that was recycled while we were copying it
+        if (bucket->startEpoch.load(std::memory_order_acquire) != start)
+        {
+            continue;
+        }
+        fn(view);
+    }
+}
+
+MetricData BucketRing::Rollup(std::time_t from, std::time_t to) const
+{
+    std::tm startTm{};
+    std::tm endTm{};
+    localtime_r(&from, &startTm);
+    localtime_r(&to, &endTm);
+
+    MetricData data(startTm);
+    data.endTime = endTm;
+    ForEachBucket(from, to, [&](const BucketView& view)
+    {
+        data.enterCount += static_cast<int>(view.enterCount);
+        data.exitCount += static_cast<int>(view.exitCount);
+        data.passCount += static_cast<int>(view.passCount);
+        data.peakOccupancy = std::max(data.peakOccupancy, static_cast<int>(view.peakOccupancy));
+    });
+    data.totalPeople = data.enterCount + data.passCount;
+    return data;
+}
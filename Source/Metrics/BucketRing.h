@@ -0,0 +1,88 @@
+#pragma once
+#include "MetricStruct.h"
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+
+// Fixed-size ring of time buckets stored in a memory-mapped file.
+// Every bucket covers bucketSeconds of wall time; counts are plain atomic
+// increments on shared memory, so they survive a crash of this process, are
+// flushed by the kernel without any help from us, and can be read by other
+// processes mapping the same file without taking a lock.
+class BucketRing
+{
+public:
+    struct Bucket
+    {
+        // Epoch second the bucket starts at. 0 means never used; a negative
+        // value means a writer is currently recycling the slot.
+        std::atomic<int64_t> startEpoch;
+        std::atomic<uint32_t> enterCount;
+        std::atomic<uint32_t> passCount;
+        std::atomic<uint32_t> exitCount;
+        std::atomic<uint32_t> peakOccupancy;
+        uint32_t reserved[2];
+    };
+
+    struct BucketView
+    {
+        std::time_t start;
+        uint32_t enterCount;
+        uint32_t passCount;
+        uint32_t exitCount;
+        uint32_t peakOccupancy;
+    };
+
+public:
+    BucketRing() = default;
+    ~BucketRing();
+
+    BucketRing(const BucketRing&) = delete;
+    BucketRing& operator=(const BucketRing&) = delete;
+
+    // Create or reopen the ring file. An existing file with a different layout
+    // is reinitialized. readOnly maps an existing file for inspection only.
+    bool Open(const std::string& path, int bucketSeconds = 60, uint32_t bucketCount = 2 * 24 * 60,
+              bool readOnly = false);
+    void Close();
+    bool IsOpen() const { return header != nullptr; }
+
+    void AddEnter(std::time_t when);
+    void AddPass(std::time_t when);
+    void AddExit(std::time_t when);
+    void UpdateOccupancy(std::time_t when, uint32_t occupancy);
+
+    // Ask the kernel to start writing dirty pages back now.
+    void Flush();
+
+    // Visit every bucket whose start lies in [from, to), oldest first.
+    void ForEachBucket(std::time_t from, std::time_t to,
+                       const std::function<void(const BucketView&)>& fn) const;
+    // Aggregate [from, to) into a single interval, e.g. an hour or a day.
+    MetricData Rollup(std::time_t from, std::time_t to) const;
+
+    int GetBucketSeconds() const;
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t bucketSeconds;
+        uint32_t bucketCount;
+        uint8_t padding[48];
+    };
+
+    Bucket* Locate(std::time_t when);
+    const Bucket* Find(std::time_t bucketStart) const;
+    static size_t MappedSize(uint32_t bucketCount);
+
+private:
+    Header* header{ nullptr };
+    Bucket* buckets{ nullptr };
+    size_t mappedSize = 0;
+    int fd = -1;
+};
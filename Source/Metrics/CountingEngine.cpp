@@ -0,0 +1,314 @@
+#include "CountingEngine.h"
+#include "MetricTracker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <yaml-cpp/yaml.h>
+
+namespace
+{
+// Zone ids in events are 1-based; 0 means "no zone"
+uint8_t LowestZoneId(uint32_t mask)
+{
+    for (int i = 0; i < CountingEngine::kMaxZones; ++i)
+    {
+        if (mask & (1u << i))
+        {
+            return static_cast<uint8_t>(i + 1);
+        }
+    }
+    return 0;
+}
+} // namespace
+
+bool CountingEngine::LoadConfig(const std::string& path)
+{
+    lines.clear();
+    zones.clear();
+    tracks.clear();
+
+    if (!std::filesystem::exists(path))
+    {
+        std::cout << "[CountingEngine] No counting config at " << path << std::endl;
+        return false;
+    }
+
+    try
+    {
+        YAML::Node root = YAML::LoadFile(path);
+        hysteresis = root["hysteresis"] ? std::max(0.0f, root["hysteresis"].as<float>()) : kDefaultHysteresis;
+        zoneFrames = root["zoneFrames"] ? std::max(1, root["zoneFrames"].as<int>()) : kDefaultZoneFrames;
+
+        if (root["zones"] && root["zones"].IsSequence())
+        {
+            for (const auto& node : root["zones"])
+            {
+                if (zones.size() >= static_cast<size_t>(kMaxZones))
+                {
+                    std::cerr << "WARNING [CountingEngine] Only " << kMaxZones << " zones supported; ignoring the rest" << std::endl;
+                    break;
+                }
+                Zone zone;
+                zone.name = node["name"] ? node["name"].as<std::string>() : "zone" + std::to_string(zones.size() + 1);
+                for (const auto& point : node["points"])
+                {
+                    zone.points.emplace_back(point[0].as<float>(), point[1].as<float>());
+                }
+                if (zone.points.size() < 3)
+                {
+                    std::cerr << "[CountingEngine] Zone '" << zone.name << "' needs at least 3 points" << std::endl;
+                    continue;
+                }
+                zones.push_back(std::move(zone));
+            }
+        }
+
+        if (root["lines"] && root["lines"].IsSequence())
+        {
+            for (const auto& node : root["lines"])
+            {
+                if (lines.size() >= static_cast<size_t>(kMaxLines))
+                {
+                    std::cerr << "WARNING [CountingEngine] Only " << kMaxLines << " lines supported; ignoring the rest" << std::endl;
+                    break;
+                }
+                Line line;
+                line.name = node["name"] ? node["name"].as<std::string>() : "line" + std::to_string(lines.size() + 1);
+                std::string type = node["type"] ? node["type"].as<std::string>() : "entry";
+                line.type = type == "pass" ? LineType::Pass : LineType::Entry;
+                line.zone = node["zone"] ? node["zone"].as<uint8_t>() : 0;
+
+                float x1 = node["from"][0].as<float>();
+                float y1 = node["from"][1].as<float>();
+                float x2 = node["to"][0].as<float>();
+                float y2 = node["to"][1].as<float>();
+                line.a = y2 - y1;
+                line.b = x1 - x2;
+                line.c = -(line.a * x1 + line.b * y1);
+                line.x1 = x1;
+                line.y1 = y1;
+                line.dx = x2 - x1;
+                line.dy = y2 - y1;
+                line.lengthSq = line.dx * line.dx + line.dy * line.dy;
+                if (line.lengthSq <= 0.0f)
+                {
+                    std::cerr << "[CountingEngine] Line '" << line.name << "' has zero length" << std::endl;
+                    continue;
+                }
+                // |a*x + b*y + c| is the distance to the line times its length
+                line.margin = hysteresis * std::sqrt(line.lengthSq);
+                lines.push_back(line);
+            }
+        }
+    }
+    catch (const YAML::Exception& e)
+    {
+        std::cerr << "[CountingEngine] Failed to load " << path << ": " << e.what() << std::endl;
+        lines.clear();
+        zones.clear();
+        return false;
+    }
+
+    BuildZoneGrid();
+    std::cout << "[CountingEngine] Loaded " << lines.size() << " line(s) and " << zones.size() << " zone(s) from " << path << std::endl;
+    return IsConfigured();
+}
+
+bool CountingEngine::PointInPolygon(const std::vector<std::pair<float, float>>& polygon, float x, float y)
+{
+    bool inside = false;
+    for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+    {
+        const auto& pi = polygon[i];
+        const auto& pj = polygon[j];
+        if ((pi.second > y) != (pj.second > y) &&
+            x < (pj.first - pi.first) * (y - pi.second) / (pj.second - pi.second) + pi.first)
+        {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+void CountingEngine::BuildZoneGrid()
+{
+    zoneGrid.assign(kGridWidth * kGridHeight, 0);
+    for (int gy = 0; gy < kGridHeight; ++gy)
+    {
+        float y = (gy + 0.5f) / kGridHeight;
+        for (int gx = 0; gx < kGridWidth; ++gx)
+        {
+            float x = (gx + 0.5f) / kGridWidth;
+            uint32_t mask = 0;
+            for (size_t z = 0; z < zones.size(); ++z)
+            {
+                if (PointInPolygon(zones[z].points, x, y))
+                {
+                    mask |= 1u << z;
+                }
+            }
+            zoneGrid[gy * kGridWidth + gx] = mask;
+        }
+    }
+}
+
+uint32_t CountingEngine::ZonesAt(float x, float y) const
+{
+    if (zones.empty())
+    {
+        return 0;
+    }
+    int gx = std::min(kGridWidth - 1, std::max(0, static_cast<int>(x * kGridWidth)));
+    int gy = std::min(kGridHeight - 1, std::max(0, static_cast<int>(y * kGridHeight)));
+    return zoneGrid[gy * kGridWidth + gx];
+}
+
+void CountingEngine::Update(const std::vector<TrackPoint>& points, MetricTracker& tracker)
+{
+    if (resetRequested.load(std::memory_order_relaxed) &&
+        resetRequested.exchange(false, std::memory_order_acquire))
+    {
+        tracks.clear();
+    }
+
+    for (const TrackPoint& point : points)
+    {
+        if (point.trackId < 0)
+        {
+            continue;
+        }
+
+        auto it = tracks.find(point.trackId);
+        const bool known = it != tracks.end();
+
+        // Inside the dead band around a line the side from the last frame stands
+        uint32_t sides = 0;
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            const Line& line = lines[i];
+            float value = line.a * point.x + line.b * point.y + line.c;
+            bool positive = value > 0.0f;
+            if (known && std::fabs(value) < line.margin)
+            {
+                positive = it->second.sides & (1u << i);
+            }
+            if (positive)
+            {
+                sides |= 1u << i;
+            }
+        }
+        uint32_t zoneMask = ZonesAt(point.x, point.y);
+
+        if (!known)
+        {
+            // First sighting only establishes the line sides; nothing has been
+            // crossed yet. Zones it starts in are entered once confirmed.
+            TrackState state{ point.x, point.y, sides, 0 };
+            state.pendingZoneMask = zoneMask;
+            state.pendingZoneFrames = 1;
+            it = tracks.emplace(point.trackId, state).first;
+            if (zoneMask != 0 && zoneFrames <= 1)
+            {
+                it->second.zoneMask = zoneMask;
+                EmitZoneChanges(point.trackId, zoneMask, 0, tracker);
+            }
+            continue;
+        }
+
+        TrackState& state = it->second;
+        uint32_t flipped = (sides ^ state.sides) & ((lines.size() >= 32) ? ~0u : ((1u << lines.size()) - 1));
+        while (flipped)
+        {
+            int i = __builtin_ctz(flipped);
+            flipped &= flipped - 1;
+            const Line& line = lines[i];
+
+            // The side changed; only count it if the step actually went through the
+            // segment and not past one of its ends.
+            float mx = point.x - state.x;
+            float my = point.y - state.y;
+            float denom = line.a * mx + line.b * my;
+            if (denom == 0.0f)
+            {
+                continue;
+            }
+            float s = -(line.a * state.x + line.b * state.y + line.c) / denom;
+            float cx = state.x + s * mx;
+            float cy = state.y + s * my;
+            float t = ((cx - line.x1) * line.dx + (cy - line.y1) * line.dy) / line.lengthSq;
+            if (t < 0.0f || t > 1.0f)
+            {
+                continue;
+            }
+
+            uint8_t zone = line.zone ? line.zone : LowestZoneId(zoneMask | state.zoneMask);
+            bool wasPositive = state.sides & (1u << i);
+            if (line.type == LineType::Pass)
+            {
+                tracker.RecordEvent(point.trackId, MetricEventType::Pass, zone);
+            }
+            else
+            {
+                tracker.RecordEvent(point.trackId, wasPositive ? MetricEventType::Enter : MetricEventType::Exit, zone);
+            }
+        }
+
+        // A zone change only counts once the new set of zones has held for zoneFrames frames
+        if (zoneMask == state.zoneMask)
+        {
+            state.pendingZoneFrames = 0;
+        }
+        else
+        {
+            if (zoneMask == state.pendingZoneMask)
+            {
+                ++state.pendingZoneFrames;
+            }
+            else
+            {
+                state.pendingZoneMask = zoneMask;
+                state.pendingZoneFrames = 1;
+            }
+            if (state.pendingZoneFrames >= zoneFrames)
+            {
+                EmitZoneChanges(point.trackId, zoneMask & ~state.zoneMask, state.zoneMask & ~zoneMask, tracker);
+                state.zoneMask = zoneMask;
+                state.pendingZoneFrames = 0;
+            }
+        }
+
+        state.x = point.x;
+        state.y = point.y;
+        state.sides = sides;
+    }
+}
+
+void CountingEngine::EmitZoneChanges(int trackId, uint32_t entered, uint32_t left, MetricTracker& tracker)
+{
+    while (left)
+    {
+        int z = __builtin_ctz(left);
+        left &= left - 1;
+        tracker.RecordEvent(trackId, MetricEventType::ZoneExit, static_cast<uint8_t>(z + 1));
+    }
+    while (entered)
+    {
+        int z = __builtin_ctz(entered);
+        entered &= entered - 1;
+        tracker.RecordEvent(trackId, MetricEventType::ZoneEnter, static_cast<uint8_t>(z + 1));
+    }
+}
+
+void CountingEngine::RemoveTrack(int trackId, MetricTracker& tracker)
+{
+    auto it = tracks.find(trackId);
+    if (it == tracks.end())
+    {
+        return;
+    }
+    // Every ZoneEnter gets its ZoneExit, even when the track is lost inside
+    EmitZoneChanges(trackId, 0, it->second.zoneMask, tracker);
+    tracks.erase(it);
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "MetricStruct.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class MetricTracker;
+
+// Position of one tracked person for a frame, normalized to [0, 1] frame
+// coordinates. Use the bottom-centre of the box (the feet) so lines drawn on
+// the floor behave as expected.
+struct TrackPoint
+{
+    int trackId;
+    float x;
+    float y;
+};
+
+// Direction-aware counting from tracker output, configured with lines and
+// zones in build/Assets/Config/counting.yaml (see counting.example.yaml).
+//  - "entry" lines count Enter when crossed in their inward direction (from the
+//    left of from->to to the right) and Exit the other way.
+//  - "pass" lines count Pass when crossed either way.
+//  - zones emit ZoneEnter/ZoneExit tagged with their zone id when a track moves
+//    in or out (and ZoneExit when a track expires inside), separate from the
+//    people counts.
+// Jitter is filtered: a line side only flips once the feet are "hysteresis"
+// (normalized distance) past the line, and a zone change needs "zoneFrames"
+// consecutive frames.
+// Each track keeps a few words of state; a frame costs O(tracks x lines) with
+// precomputed line equations and a grid lookup for the zones.
+class CountingEngine
+{
+public:
+    static constexpr int kMaxLines = 32;
+    static constexpr int kMaxZones = 32;
+    static constexpr int kGridWidth = 64;
+    static constexpr int kGridHeight = 48;
+    static constexpr float kDefaultHysteresis = 0.02f;
+    static constexpr int kDefaultZoneFrames = 3;
+
+public:
+    CountingEngine() = default;
+
+    bool LoadConfig(const std::string& path);
+    bool IsConfigured() const { return !lines.empty() || !zones.empty(); }
+
+    // Detection thread: advance every track seen this frame and emit events
+    void Update(const std::vector<TrackPoint>& points, MetricTracker& tracker);
+    // Detection thread: forget a track the tracker has expired, leaving any
+    // zone it was still in
+    void RemoveTrack(int trackId, MetricTracker& tracker);
+    // Any thread: drop all track state before the next Update (e.g. after the
+    // tracker ids were reset)
+    void Reset() { resetRequested.store(true, std::memory_order_release); }
+
+private:
+    enum class LineType
+    {
+        Entry,
+        Pass
+    };
+
+    struct Line
+    {
+        std::string name;
+        LineType type = LineType::Entry;
+        uint8_t zone = 0;
+        // a*x + b*y + c, positive on the left of from->to
+        float a = 0, b = 0, c = 0;
+        float x1 = 0, y1 = 0, dx = 0, dy = 0, lengthSq = 0;
+        float margin = 0;       // hysteresis in units of a*x + b*y + c
+    };
+
+    struct Zone
+    {
+        std::string name;
+        std::vector<std::pair<float, float>> points;
+    };
+
+    struct TrackState
+    {
+        float x = 0, y = 0;     // last position
+        uint32_t sides = 0;     // bit i: last side of line i was positive
+        uint32_t zoneMask = 0;  // zones currently occupied (confirmed)
+        uint32_t pendingZoneMask = 0;
+        int pendingZoneFrames = 0;
+    };
+
+    uint32_t ZonesAt(float x, float y) const;
+    void EmitZoneChanges(int trackId, uint32_t entered, uint32_t left, MetricTracker& tracker);
+    static bool PointInPolygon(const std::vector<std::pair<float, float>>& polygon, float x, float y);
+    void BuildZoneGrid();
+
+private:
+    std::vector<Line> lines;
+    std::vector<Zone> zones;
+    std::vector<uint32_t> zoneGrid; // kGridWidth * kGridHeight zone masks
+    float hysteresis = kDefaultHysteresis;
+    int zoneFrames = kDefaultZoneFrames;
+    std::unordered_map<int, TrackState> tracks;
+    std::atomic<bool> resetRequested{ false };
+};
@@ -0,0 +1,504 @@
+#include "EventLog.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <json.hpp>
+#include <map>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr char kSegmentExt[] = ".evlog";
+constexpr char kAggregateSuffix[] = ".agg.json";
+constexpr uint32_t kSegmentMagic = 0x4C56454D; // "MEVL"
+constexpr uint32_t kSegmentVersion = 1;
+
+struct SegmentHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+
+// On-disk record, 16 bytes
+struct EventRecord
+{
+    int64_t timestampMs;
+    int32_t trackId;
+    uint8_t type;
+    uint8_t zone;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(SegmentHeader) == 16, "segment header layout is part of the file format");
+static_assert(sizeof(EventRecord) == 16, "event record layout is part of the file format");
+
+// Start of the local hour holding timestampMs, the hour SegmentPath() names
+// the segment after. Zones with a non-whole-hour offset (e.g. +05:30) make
+// this differ from the UTC hour.
+std::time_t LocalHourOf(int64_t timestampMs)
+{
+    std::time_t seconds = static_cast<std::time_t>(timestampMs / 1000);
+    std::tm tm{};
+    localtime_r(&seconds, &tm);
+    return seconds - tm.tm_min * 60 - tm.tm_sec;
+}
+
+// Parse the hour start back out of "YYYY-MM-DD_HH.evlog" (or .agg.json)
+bool ParseSegmentHour(const std::string& filename, std::time_t& hourStart)
+{
+    std::tm tm{};
+    if (std::sscanf(filename.c_str(), "%4d-%2d-%2d_%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour) != 4)
+    {
+        return false;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+    hourStart = std::mktime(&tm);
+    return hourStart != static_cast<std::time_t>(-1);
+}
+} // namespace
+
+EventLog::~EventLog()
+{
+    Close();
+}
+
+bool EventLog::Open(const std::string& directory)
+{
+    return Open(directory, Options());
+}
+
+bool EventLog::Open(const std::string& directory, const Options& options)
+{
+    if (running.load())
+    {
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec)
+    {
+        std::cerr << "[EventLog] Failed to create directory " << directory << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    this->directory = directory;
+    this->options = options;
+    pending = std::make_unique<MpmcRing<MetricEvent>>(std::max<size_t>(2, options.maxPendingEvents * 2));
+    stopRequested.store(false);
+    running.store(true);
+    writerThread = std::thread(&EventLog::WriterThreadFunc, this);
+    return true;
+}
+
+void EventLog::Close()
+{
+    if (!running.load())
+    {
+        return;
+    }
+
+    stopRequested.store(true);
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeCondVar.notify_one();
+    }
+    if (writerThread.joinable())
+    {
+        writerThread.join();
+    }
+    running.store(false);
+}
+
+void EventLog::Append(const MetricEvent& event)
+{
+    if (!running.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    MetricEvent copy = event;
+    if (!pending->tryPush(std::move(copy)))
+    {
+        // The writer is stalled (slow card); wait for room rather than lose a count
+        wakeCondVar.notify_one();
+        if (!pending->pushWait(std::move(copy), options.flushInterval))
+        {
+            std::cerr << "[EventLog] Event ring full, dropping event of track " << event.trackId << std::endl;
+        }
+        return;
+    }
+    if (pending->size() >= options.maxPendingEvents)
+    {
+        // Unlocked notify: a missed wake-up only delays the flush to the next interval
+        wakeCondVar.notify_one();
+    }
+}
+
+void EventLog::WriterThreadFunc()
+{
+    using Clock = std::chrono::steady_clock;
+    auto lastSync = Clock::now();
+    auto lastCompaction = Clock::time_point{};
+    std::vector<MetricEvent> batch;
+
+    while (true)
+    {
+        bool stopping = false;
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wakeCondVar.wait_for(lock, options.flushInterval, [&]
+            {
+                return stopRequested.load() || pending->size() >= options.maxPendingEvents;
+            });
+            stopping = stopRequested.load();
+        }
+        // Producers may still be pushing; they land in the next batch
+        pending->popBatch(batch, pending->capacity());
+
+        if (!batch.empty())
+        {
+            WriteBatch(batch);
+            batch.clear();
+        }
+
+        auto now = Clock::now();
+        if (segmentDirty && (stopping || now - lastSync >= options.syncInterval))
+        {
+            fdatasync(segmentFd);
+            segmentDirty = false;
+            lastSync = now;
+        }
+
+        if (stopping)
+        {
+            break;
+        }
+
+        if (now - lastCompaction >= options.compactionInterval)
+        {
+            Compact();
+            lastCompaction = now;
+        }
+    }
+
+    CloseSegment();
+}
+
+bool EventLog::WriteBatch(const std::vector<MetricEvent>& batch)
+{
+    // Group consecutive events by local hour so each segment gets a single write()
+    size_t begin = 0;
+    std::vector<EventRecord> records;
+    records.reserve(batch.size());
+
+    while (begin < batch.size())
+    {
+        std::time_t hour = LocalHourOf(batch[begin].timestampMs);
+        size_t end = begin;
+        records.clear();
+        while (end < batch.size() && LocalHourOf(batch[end].timestampMs) == hour)
+        {
+            const MetricEvent& event = batch[end];
+            records.push_back({ event.timestampMs, event.trackId, static_cast<uint8_t>(event.type), event.zone, 0 });
+            ++end;
+        }
+
+        if (!OpenSegmentFor(batch[begin].timestampMs))
+        {
+            return false;
+        }
+
+        const char* data = reinterpret_cast<const char*>(records.data());
+        size_t remaining = records.size() * sizeof(EventRecord);
+        while (remaining > 0)
+        {
+            ssize_t written = ::write(segmentFd, data, remaining);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                std::cerr << "[EventLog] write failed on " << segmentPath << ": " << std::strerror(errno) << std::endl;
+                return false;
+            }
+            data += written;
+            remaining -= static_cast<size_t>(written);
+        }
+        segmentDirty = true;
+        begin = end;
+    }
+    return true;
+}
+
+std::string EventLog::SegmentPath(int64_t timestampMs) const
+{
+    std::time_t seconds = static_cast<std::time_t>(timestampMs / 1000);
+    std::tm tm{};
+    localtime_r(&seconds, &tm);
+    std::ostringstream oss;
+    oss << std::put_time(&tm, "%Y-%m-%d_%H") << kSegmentExt;
+    return (std::filesystem::path(directory) / oss.str()).string();
+}
+
+bool EventLog::OpenSegmentFor(int64_t timestampMs)
+{
+    std::string path = SegmentPath(timestampMs);
+    if (segmentFd >= 0 && path == segmentPath)
+    {
+        return true;
+    }
+    CloseSegment();
+
+    segmentFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (segmentFd < 0)
+    {
+        std::cerr << "[EventLog] Failed to open segment " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    segmentPath = path;
+
+    struct stat st{};
+    fstat(segmentFd, &st);
+    if (st.st_size < static_cast<off_t>(sizeof(SegmentHeader)))
+    {
+        SegmentHeader header{ kSegmentMagic, kSegmentVersion, sizeof(EventRecord), 0 };
+        if (ftruncate(segmentFd, 0) != 0 || ::write(segmentFd, &header, sizeof(header)) != static_cast<ssize_t>(sizeof(header)))
+        {
+            std::cerr << "[EventLog] Failed to write segment header: " << path << std::endl;
+        }
+    }
+    else if ((st.st_size - sizeof(SegmentHeader)) % sizeof(EventRecord) != 0)
+    {
+        // Drop a torn record left by a power cut so new records stay aligned
+        off_t valid = sizeof(SegmentHeader) +
+                      (st.st_size - sizeof(SegmentHeader)) / sizeof(EventRecord) * sizeof(EventRecord);
+        if (ftruncate(segmentFd, valid) != 0)
+        {
+            std::cerr << "[EventLog] Failed to trim torn tail of " << path << std::endl;
+        }
+    }
+    return true;
+}
+
+void EventLog::CloseSegment()
+{
+    if (segmentFd >= 0)
+    {
+        if (segmentDirty)
+        {
+            fdatasync(segmentFd);
+        }
+        ::close(segmentFd);
+    }
+    segmentFd = -1;
+    segmentPath.clear();
+    segmentDirty = false;
+}
+
+std::vector<std::string> EventLog::ListSegments(const std::string& directory)
+{
+    std::vector<std::string> segments;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == kSegmentExt)
+        {
+            segments.push_back(entry.path().string());
+        }
+    }
+    // Names sort chronologically
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+std::vector<std::string> EventLog::ListAggregates(const std::string& directory)
+{
+    std::vector<std::string> aggregates;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec))
+    {
+        const std::string name = entry.path().filename().string();
+        if (entry.is_regular_file() && name.size() > sizeof(kAggregateSuffix) - 1 &&
+            name.compare(name.size() - (sizeof(kAggregateSuffix) - 1), std::string::npos, kAggregateSuffix) == 0)
+        {
+            aggregates.push_back(entry.path().string());
+        }
+    }
+    std::sort(aggregates.begin(), aggregates.end());
+    return aggregates;
+}
+
+bool EventLog::HourOfFile(const std::string& path, std::time_t& hourStart)
+{
+    return ParseSegmentHour(std::filesystem::path(path).filename().string(), hourStart);
+}
+
+bool EventLog::ReadAggregate(const std::string& path, HourAggregate& aggregate)
+{
+    if (!HourOfFile(path, aggregate.hourStart))
+    {
+        return false;
+    }
+    std::ifstream ifs(path);
+    nlohmann::json j = nlohmann::json::parse(ifs, nullptr, false);
+    if (j.is_discarded() || !j.is_object())
+    {
+        std::cerr << "[EventLog] Not an hourly aggregate: " << path << std::endl;
+        return false;
+    }
+    aggregate.enterCount = j.value("enterCount", 0);
+    aggregate.passCount = j.value("passCount", 0);
+    aggregate.exitCount = j.value("exitCount", 0);
+    return true;
+}
+
+bool EventLog::ReadSegment(const std::string& path, const std::function<void(const MetricEvent&)>& fn)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "[EventLog] Failed to open segment for reading: " << path << std::endl;
+        return false;
+    }
+
+    struct stat st{};
+    fstat(fd, &st);
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size < sizeof(SegmentHeader))
+    {
+        ::close(fd);
+        return size == 0;
+    }
+
+    void* mem = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED)
+    {
+        std::cerr << "[EventLog] mmap failed for " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    madvise(mem, size, MADV_SEQUENTIAL);
+
+    const auto* header = static_cast<const SegmentHeader*>(mem);
+    bool ok = header->magic == kSegmentMagic && header->version == kSegmentVersion &&
+              header->recordSize == sizeof(EventRecord);
+    if (ok)
+    {
+        const auto* records = reinterpret_cast<const EventRecord*>(static_cast<const uint8_t*>(mem) + sizeof(SegmentHeader));
+        size_t count = (size - sizeof(SegmentHeader)) / sizeof(EventRecord);
+        MetricEvent event;
+        for (size_t i = 0; i < count; ++i)
+        {
+            event.timestampMs = records[i].timestampMs;
+            event.trackId = records[i].trackId;
+            event.type = static_cast<MetricEventType>(records[i].type);
+            event.zone = records[i].zone;
+            fn(event);
+        }
+    }
+    else
+    {
+        std::cerr << "[EventLog] Not an event log segment: " << path << std::endl;
+    }
+
+    munmap(mem, size);
+    return ok;
+}
+
+size_t EventLog::Compact()
+{
+    std::time_t cutoff = std::time(0) - std::chrono::duration_cast<std::chrono::seconds>(options.retention).count();
+    size_t compacted = 0;
+
+    for (const std::string& path : ListSegments(directory))
+    {
+        std::time_t hourStart = 0;
+        std::filesystem::path segment(path);
+        if (!ParseSegmentHour(segment.filename().string(), hourStart) || hourStart + 3600 > cutoff)
+        {
+            continue;
+        }
+
+        int totals[3] = { 0, 0, 0 };
+        // Per zone: Enter, Pass, Exit, ZoneEnter, ZoneExit
+        std::map<int, std::array<int, 5>> zones;
+        bool ok = ReadSegment(path, [&](const MetricEvent& event)
+        {
+            size_t type = static_cast<size_t>(event.type);
+            if (type < 3)
+            {
+                ++totals[type];
+            }
+            if (type < 5)
+            {
+                ++zones[event.zone][type];
+            }
+        });
+        if (!ok)
+        {
+            continue;
+        }
+
+        std::tm startTm{};
+        localtime_r(&hourStart, &startTm);
+        nlohmann::json aggregate = {
+            {"startTime", formatTime(startTm)},
+            {"enterCount", totals[0]},
+            {"passCount", totals[1]},
+            {"exitCount", totals[2]},
+            {"zones", nlohmann::json::object()}
+        };
+        for (const auto& zone : zones)
+        {
+            aggregate["zones"][std::to_string(zone.first)] = {
+                {"enterCount", zone.second[0]},
+                {"passCount", zone.second[1]},
+                {"exitCount", zone.second[2]},
+                {"zoneEnterCount", zone.second[3]},
+                {"zoneExitCount", zone.second[4]}
+            };
+        }
+
+        std::filesystem::path aggregatePath = segment;
+        aggregatePath.replace_extension(kAggregateSuffix);
+        std::ofstream ofs(aggregatePath);
+        if (!ofs.is_open())
+        {
+            std::cerr << "[EventLog] Failed to write aggregate " << aggregatePath << std::endl;
+            continue;
+        }
+        ofs << aggregate << std::endl;
+        ofs.close();
+        if (!ofs)
+        {
+            continue;
+        }
+
+        std::error_code ec;
+        std::filesystem::remove(segment, ec);
+        ++compacted;
+    }
+
+    if (compacted > 0)
+    {
+        std::cout << "[EventLog] Compacted " << compacted << " segment(s) into hourly aggregates" << std::endl;
+    }
+    return compacted;
+}
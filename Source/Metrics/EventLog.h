@@ -0,0 +1,97 @@
+#pragma once
+#include "MetricStruct.h"
+#include "Utility/RingQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Append-only binary log of counting events, one segment file per hour.
+// Append() only moves the event into a lock-free ring; a background thread
+// writes batches with a single write() (group commit) and fdatasync()s at a
+// much lower rate, so the SD card sees few, large writes. The same thread
+// compacts segments older than the retention window into hourly aggregates.
+class EventLog
+{
+public:
+    struct Options
+    {
+        std::chrono::milliseconds flushInterval{ 1000 };
+        std::chrono::milliseconds syncInterval{ 10000 };
+        size_t maxPendingEvents = 4096;             // force an early flush past this; the ring holds twice as many
+        std::chrono::hours retention{ 24 * 7 };     // keep raw segments this long
+        std::chrono::minutes compactionInterval{ 30 };
+    };
+
+public:
+    EventLog() = default;
+    ~EventLog();
+
+    EventLog(const EventLog&) = delete;
+    EventLog& operator=(const EventLog&) = delete;
+
+    bool Open(const std::string& directory);
+    bool Open(const std::string& directory, const Options& options);
+    void Close();
+    bool IsOpen() const { return running.load(); }
+
+    void Append(const MetricEvent& event);
+
+    // Roll raw segments older than the retention window into <segment>.agg.json
+    // and delete them. Runs periodically on the writer thread as well.
+    size_t Compact();
+
+    // Read every complete record of one segment, in order. A torn record at the
+    // tail (power cut mid-write) is ignored.
+    static bool ReadSegment(const std::string& path, const std::function<void(const MetricEvent&)>& fn);
+    // Segment files in a log directory, oldest first.
+    static std::vector<std::string> ListSegments(const std::string& directory);
+
+    // Counts of one compacted hour
+    struct HourAggregate
+    {
+        std::time_t hourStart = 0;
+        int enterCount = 0;
+        int passCount = 0;
+        int exitCount = 0;
+    };
+    // Aggregate files in a log directory, oldest first.
+    static std::vector<std::string> ListAggregates(const std::string& directory);
+    static bool ReadAggregate(const std::string& path, HourAggregate& aggregate);
+    // Local hour a segment or aggregate file covers, from its name
+    static bool HourOfFile(const std::string& path, std::time_t& hourStart);
+
+private:
+    void WriterThreadFunc();
+    bool WriteBatch(const std::vector<MetricEvent>& batch);
+    bool OpenSegmentFor(int64_t timestampMs);
+    void CloseSegment();
+    std::string SegmentPath(int64_t timestampMs) const;
+
+private:
+    std::string directory;
+    Options options;
+
+    // Any number of counting threads push, the writer thread drains
+    std::unique_ptr<MpmcRing<MetricEvent>> pending;
+    // Only wakes the writer early; Append() never takes it
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondVar;
+
+    std::thread writerThread;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> stopRequested{ false };
+
+    // Writer thread only
+    int segmentFd = -1;
+    std::string segmentPath;
+    bool segmentDirty = false;
+};
@@ -0,0 +1,189 @@
+#include "Heatmap.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HEATMAP_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define HEATMAP_SSE2 1
+#endif
+
+namespace
+{
+constexpr uint8_t kFormatMagic = 0x48; // 'H'
+constexpr uint8_t kFormatVersion = 1;
+
+void PutVarint(std::vector<uint8_t>& out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool GetVarint(const std::vector<uint8_t>& in, size_t& pos, uint32_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35 && pos < in.size(); shift += 7)
+    {
+        uint8_t byte = in[pos++];
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+} // namespace
+
+Heatmap::Heatmap()
+{
+    std::memset(cells, 0, sizeof(cells));
+    lastSnapshot.assign(kCells, 0);
+}
+
+void Heatmap::AddSpan(uint32_t* row, int begin, int end)
+{
+    int i = begin;
+#if defined(HEATMAP_NEON)
+    const uint32x4_t one = vdupq_n_u32(1);
+    for (; i + 4 <= end; i += 4)
+    {
+        vst1q_u32(row + i, vaddq_u32(vld1q_u32(row + i), one));
+    }
+#elif defined(HEATMAP_SSE2)
+    const __m128i one = _mm_set1_epi32(1);
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128i* p = reinterpret_cast<__m128i*>(row + i);
+        _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), one));
+    }
+#endif
+    for (; i < end; ++i)
+    {
+        ++row[i];
+    }
+}
+
+void Heatmap::Accumulate(const std::vector<HeatmapRect>& boxes, int frameWidth, int frameHeight)
+{
+    if (boxes.empty() || frameWidth <= 0 || frameHeight <= 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(cellsMutex);
+    for (const HeatmapRect& box : boxes)
+    {
+        // Map to grid cells; any cell the box touches is counted
+        int x0 = std::max(0, box.x * kWidth / frameWidth);
+        int y0 = std::max(0, box.y * kHeight / frameHeight);
+        int x1 = std::min(kWidth, ((box.x + box.width) * kWidth + frameWidth - 1) / frameWidth);
+        int y1 = std::min(kHeight, ((box.y + box.height) * kHeight + frameHeight - 1) / frameHeight);
+        if (x0 >= x1 || y0 >= y1)
+        {
+            continue;
+        }
+
+        for (int y = y0; y < y1; ++y)
+        {
+            AddSpan(cells + y * kWidth, x0, x1);
+        }
+        dirty = true;
+    }
+}
+
+std::vector<uint8_t> Heatmap::TakeSnapshot()
+{
+    std::vector<uint32_t> delta(kCells);
+    {
+        std::lock_guard<std::mutex> lock(cellsMutex);
+        if (!dirty)
+        {
+            return {};
+        }
+        for (int i = 0; i < kCells; ++i)
+        {
+            delta[i] = cells[i] - lastSnapshot[i];
+            lastSnapshot[i] = cells[i];
+        }
+        dirty = false;
+    }
+    return Encode(delta);
+}
+
+void Heatmap::Reset()
+{
+    std::lock_guard<std::mutex> lock(cellsMutex);
+    std::memset(cells, 0, sizeof(cells));
+    std::fill(lastSnapshot.begin(), lastSnapshot.end(), 0u);
+    dirty = false;
+}
+
+// Layout: magic, version, width, height, then alternating
+// (zero run length, non-zero value) varints until all cells are covered.
+std::vector<uint8_t> Heatmap::Encode(const std::vector<uint32_t>& cells)
+{
+    std::vector<uint8_t> out;
+    out.reserve(64);
+    out.push_back(kFormatMagic);
+    out.push_back(kFormatVersion);
+    out.push_back(static_cast<uint8_t>(kWidth));
+    out.push_back(static_cast<uint8_t>(kHeight));
+
+    size_t i = 0;
+    while (i < cells.size())
+    {
+        uint32_t zeros = 0;
+        while (i < cells.size() && cells[i] == 0)
+        {
+            ++zeros;
+            ++i;
+        }
+        PutVarint(out, zeros);
+        if (i < cells.size())
+        {
+            PutVarint(out, cells[i++]);
+        }
+    }
+    return out;
+}
+
+std::vector<uint32_t> Heatmap::Decode(const std::vector<uint8_t>& encoded)
+{
+    if (encoded.size() < 4 || encoded[0] != kFormatMagic || encoded[1] != kFormatVersion ||
+        encoded[2] != kWidth || encoded[3] != kHeight)
+    {
+        return {};
+    }
+
+    std::vector<uint32_t> cells;
+    cells.reserve(kCells);
+    size_t pos = 4;
+    while (cells.size() < static_cast<size_t>(kCells))
+    {
+        uint32_t zeros = 0;
+        if (!GetVarint(encoded, pos, zeros) || cells.size() + zeros > static_cast<size_t>(kCells))
+        {
+            return {};
+        }
+        cells.insert(cells.end(), zeros, 0u);
+        if (cells.size() == static_cast<size_t>(kCells))
+        {
+            break;
+        }
+        uint32_t value = 0;
+        if (!GetVarint(encoded, pos, value))
+        {
+            return {};
+        }
+        cells.push_back(value);
+    }
+    return cells;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct HeatmapRect
+{
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// Low-resolution occupancy grid fed straight from tracker output. Every
+// detection box is rasterized onto a 64x48 grid of 32-bit counters with
+// vectorized row adds, so a frame costs a few microseconds on the detection
+// thread. Snapshots hold only what accumulated since the previous snapshot
+// and are RLE/varint encoded, which keeps a mostly-empty hour to a few
+// hundred bytes.
+class Heatmap
+{
+public:
+    static constexpr int kWidth = 64;
+    static constexpr int kHeight = 48;
+    static constexpr int kCells = kWidth * kHeight;
+
+public:
+    Heatmap();
+
+    // Detection thread: add one frame's boxes, given in frame pixel coordinates
+    void Accumulate(const std::vector<HeatmapRect>& boxes, int frameWidth, int frameHeight);
+
+    // Encoded counts accumulated since the previous snapshot. Empty when
+    // nothing was accumulated.
+    std::vector<uint8_t> TakeSnapshot();
+    void Reset();
+
+    static std::vector<uint8_t> Encode(const std::vector<uint32_t>& cells);
+    // Returns kCells counters, or an empty vector if the data is malformed
+    static std::vector<uint32_t> Decode(const std::vector<uint8_t>& encoded);
+
+private:
+    static void AddSpan(uint32_t* row, int begin, int end);
+
+private:
+    std::mutex cellsMutex;
+    alignas(16) uint32_t cells[kCells];
+    std::vector<uint32_t> lastSnapshot;
+    bool dirty = false;
+};
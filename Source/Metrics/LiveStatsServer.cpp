@@ -0,0 +1,524 @@
+#include "LiveStatsServer.h"
+#include "MetricTracker.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr size_t kMaxClients = 64;
+constexpr size_t kMaxRequestBytes = 8 * 1024;
+constexpr size_t kMaxStreamBacklog = 64 * 1024; // drop SSE clients that stop reading
+constexpr auto kStatsMaxAge = std::chrono::milliseconds(100);
+constexpr auto kEventInterval = std::chrono::seconds(1);
+
+bool SetNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+const char* StatusText(int status)
+{
+    switch (status)
+    {
+    case 200:
+        return "OK";
+    case 400:
+        return "Bad Request";
+    case 404:
+        return "Not Found";
+    case 405:
+        return "Method Not Allowed";
+    case 503:
+        return "Service Unavailable";
+    default:
+        return "Error";
+    }
+}
+
+int64_t NowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+} // namespace
+
+LiveStatsServer::LiveStatsServer(const MetricTracker& tracker) : tracker(tracker)
+{
+}
+
+LiveStatsServer::~LiveStatsServer()
+{
+    Stop();
+}
+
+bool LiveStatsServer::Start(uint16_t port, const std::string& address)
+{
+    if (running.load())
+    {
+        return true;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+    {
+        std::cerr << "[LiveStatsServer] Start: invalid address " << address << std::endl;
+        return false;
+    }
+
+    listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0)
+    {
+        std::cerr << "[LiveStatsServer] Start: socket failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listenFd, 16) != 0 || !SetNonBlocking(listenFd))
+    {
+        std::cerr << "[LiveStatsServer] Start: cannot listen on " << address << ":" << port << ": "
+                  << std::strerror(errno) << std::endl;
+        ::close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    if (::pipe2(wakePipe, O_CLOEXEC | O_NONBLOCK) != 0)
+    {
+        std::cerr << "[LiveStatsServer] Start: pipe failed: " << std::strerror(errno) << std::endl;
+        ::close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    stopRequested.store(false);
+    running.store(true);
+    serverThread = std::thread(&LiveStatsServer::ServerThreadFunc, this);
+
+    std::cout << "[LiveStatsServer] Listening on http://" << address << ":" << port << std::endl;
+    return true;
+}
+
+void LiveStatsServer::Stop()
+{
+    if (!running.load())
+    {
+        return;
+    }
+
+    stopRequested.store(true);
+    char wake = 1;
+    (void)::write(wakePipe[1], &wake, 1);
+    if (serverThread.joinable())
+    {
+        serverThread.join();
+    }
+
+    for (Client& client : clients)
+    {
+        CloseClient(client);
+    }
+    clients.clear();
+
+    ::close(listenFd);
+    ::close(wakePipe[0]);
+    ::close(wakePipe[1]);
+    listenFd = -1;
+    wakePipe[0] = wakePipe[1] = -1;
+    running.store(false);
+}
+
+void LiveStatsServer::PublishTracks(std::vector<LiveTrack> tracks, int frameWidth, int frameHeight,
+                                    int64_t captureMs, uint64_t sequence)
+{
+    auto frame = std::make_shared<TrackFrame>();
+    frame->timeMs = captureMs > 0 ? captureMs : NowMs();
+    frame->sequence = sequence;
+    frame->frameWidth = frameWidth;
+    frame->frameHeight = frameHeight;
+    frame->tracks = std::move(tracks);
+    std::atomic_store_explicit(&latestTracks, std::shared_ptr<const TrackFrame>(std::move(frame)),
+                               std::memory_order_release);
+}
+
+void LiveStatsServer::ServerThreadFunc()
+{
+    auto nextEvent = std::chrono::steady_clock::now() + kEventInterval;
+    std::vector<pollfd> fds;
+
+    while (!stopRequested.load())
+    {
+        fds.clear();
+        fds.push_back({ wakePipe[0], POLLIN, 0 });
+        fds.push_back({ listenFd, POLLIN, 0 });
+        for (const Client& client : clients)
+        {
+            short events = POLLIN;
+            if (!client.output.empty())
+            {
+                events |= POLLOUT;
+            }
+            fds.push_back({ client.fd, events, 0 });
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        int timeoutMs = static_cast<int>(std::max<int64_t>(
+            0, std::chrono::duration_cast<std::chrono::milliseconds>(nextEvent - now).count()));
+        if (::poll(fds.data(), fds.size(), timeoutMs) < 0 && errno != EINTR)
+        {
+            std::cerr << "[LiveStatsServer] poll failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            char drain[16];
+            while (::read(wakePipe[0], drain, sizeof(drain)) > 0)
+            {
+            }
+        }
+
+        // fds[i + 2] belongs to clients[i]; new clients are only appended after this loop
+        for (size_t i = 0; i < clients.size(); ++i)
+        {
+            Client& client = clients[i];
+            short revents = fds[i + 2].revents;
+            if (revents & (POLLERR | POLLHUP | POLLNVAL))
+            {
+                CloseClient(client);
+                continue;
+            }
+            if ((revents & POLLIN) && !ReadRequest(client))
+            {
+                CloseClient(client);
+                continue;
+            }
+            if ((revents & POLLOUT) && !WriteOutput(client))
+            {
+                CloseClient(client);
+            }
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            AcceptClients();
+        }
+
+        now = std::chrono::steady_clock::now();
+        if (now >= nextEvent)
+        {
+            nextEvent = now + kEventInterval;
+            bool anyStreaming = std::any_of(clients.begin(), clients.end(),
+                                            [](const Client& c) { return c.fd >= 0 && c.streaming; });
+            if (anyStreaming)
+            {
+                std::string event = "event: stats\ndata: " + GetStatsJson() + "\n\n";
+                for (Client& client : clients)
+                {
+                    if (client.fd < 0 || !client.streaming)
+                    {
+                        continue;
+                    }
+                    if (client.output.size() > kMaxStreamBacklog)
+                    {
+                        CloseClient(client);
+                        continue;
+                    }
+                    client.output += event;
+                    if (!WriteOutput(client))
+                    {
+                        CloseClient(client);
+                    }
+                }
+            }
+        }
+
+        clients.erase(std::remove_if(clients.begin(), clients.end(), [](const Client& c) { return c.fd < 0; }),
+                      clients.end());
+    }
+}
+
+void LiveStatsServer::AcceptClients()
+{
+    for (;;)
+    {
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        if (clients.size() >= kMaxClients)
+        {
+            Client busy;
+            busy.fd = fd;
+            QueueResponse(busy, 503, "{\"error\":\"too many clients\"}");
+            WriteOutput(busy);
+            ::close(fd);
+            continue;
+        }
+        Client client;
+        client.fd = fd;
+        clients.push_back(std::move(client));
+    }
+}
+
+bool LiveStatsServer::ReadRequest(Client& client)
+{
+    char buffer[2048];
+    for (;;)
+    {
+        ssize_t n = ::recv(client.fd, buffer, sizeof(buffer), 0);
+        if (n > 0)
+        {
+            if (client.streaming || client.closeAfterWrite)
+            {
+                // Only one request per connection; ignore anything else the client sends
+                continue;
+            }
+            client.request.append(buffer, static_cast<size_t>(n));
+            if (client.request.size() > kMaxRequestBytes)
+            {
+                QueueResponse(client, 400, "{\"error\":\"request too large\"}");
+                return WriteOutput(client);
+            }
+            continue;
+        }
+        if (n == 0)
+        {
+            return false; // peer closed
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            break;
+        }
+        return errno == EINTR;
+    }
+
+    if (!client.streaming && !client.closeAfterWrite &&
+        client.request.find("\r\n\r\n") != std::string::npos)
+    {
+        HandleRequest(client);
+        return WriteOutput(client);
+    }
+    return true;
+}
+
+void LiveStatsServer::HandleRequest(Client& client)
+{
+    std::istringstream line(client.request.substr(0, client.request.find("\r\n")));
+    std::string method, target;
+    line >> method >> target;
+    client.request.clear();
+
+    if (method != "GET")
+    {
+        QueueResponse(client, 405, "{\"error\":\"only GET is supported\"}");
+        return;
+    }
+
+    std::string path = target.substr(0, target.find('?'));
+    std::string query = target.find('?') != std::string::npos ? target.substr(target.find('?') + 1) : "";
+
+    if (path == "/stats")
+    {
+        QueueResponse(client, 200, GetStatsJson());
+    }
+    else if (path == "/tracks")
+    {
+        QueueResponse(client, 200, BuildTracksJson());
+    }
+    else if (path == "/buckets")
+    {
+        int minutes = 60;
+        size_t pos = query.find("minutes=");
+        if (pos != std::string::npos)
+        {
+            minutes = std::atoi(query.c_str() + pos + 8);
+        }
+        QueueResponse(client, 200, BuildBucketsJson(std::clamp(minutes, 1, 2 * 24 * 60)));
+    }
+    else if (path == "/encoder" && encoderStatsFunc)
+    {
+        QueueResponse(client, 200, encoderStatsFunc());
+    }
+    else if (path == "/capture" && captureStatsFunc)
+    {
+        QueueResponse(client, 200, captureStatsFunc());
+    }
+    else if (path == "/events")
+    {
+        client.streaming = true;
+        client.output += "HTTP/1.1 200 OK\r\n"
+                         "Content-Type: text/event-stream\r\n"
+                         "Cache-Control: no-cache\r\n"
+                         "Connection: keep-alive\r\n"
+                         "\r\n";
+        client.output += "event: stats\ndata: " + GetStatsJson() + "\n\n";
+    }
+    else
+    {
+        QueueResponse(client, 404, "{\"error\":\"not found\"}");
+    }
+}
+
+void LiveStatsServer::QueueResponse(Client& client, int status, const std::string& body, const char* contentType)
+{
+    client.output += "HTTP/1.1 " + std::to_string(status) + " " + StatusText(status) + "\r\n" +
+                     "Content-Type: " + contentType + "\r\n" +
+                     "Content-Length: " + std::to_string(body.size()) + "\r\n" +
+                     "Cache-Control: no-cache\r\n" +
+                     "Connection: close\r\n\r\n" + body;
+    client.closeAfterWrite = true;
+}
+
+bool LiveStatsServer::WriteOutput(Client& client)
+{
+    size_t written = 0;
+    while (written < client.output.size())
+    {
+        ssize_t n = ::send(client.fd, client.output.data() + written, client.output.size() - written, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            written += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        return false;
+    }
+    client.output.erase(0, written);
+    return !(client.output.empty() && client.closeAfterWrite);
+}
+
+void LiveStatsServer::CloseClient(Client& client)
+{
+    if (client.fd >= 0)
+    {
+        ::close(client.fd);
+        client.fd = -1;
+    }
+}
+
+const std::string& LiveStatsServer::GetStatsJson()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (statsCache.empty() || now - statsBuiltAt >= kStatsMaxAge)
+    {
+        statsCache = BuildStatsJson();
+        statsBuiltAt = now;
+    }
+    return statsCache;
+}
+
+std::string LiveStatsServer::BuildStatsJson() const
+{
+    // Published by the detection thread; before its first frame everything is zero
+    auto stats = tracker.GetLiveStats();
+    if (!stats)
+    {
+        std::time_t now = std::time(nullptr);
+        std::tm local{};
+        localtime_r(&now, &local);
+        stats = std::make_shared<const MetricTracker::LiveStats>(MetricTracker::LiveStats{ MetricData(local), LatencyStats() });
+    }
+    const MetricData& snapshot = stats->interval;
+    const LatencyStats& latency = stats->latency;
+    auto frame = std::atomic_load_explicit(&latestTracks, std::memory_order_acquire);
+
+    std::ostringstream os;
+    os << "{\"avgOccupancy\":" << snapshot.avgOccupancy;
+    if (!latency.countMs.IsEmpty())
+    {
+        // Camera capture to the event being counted, milliseconds
+        os << ",\"countLatencyP50\":" << latency.countMs.Quantile(0.5)
+           << ",\"countLatencyP90\":" << latency.countMs.Quantile(0.9)
+           << ",\"countLatencyP99\":" << latency.countMs.Quantile(0.99);
+    }
+    if (!latency.detectMs.IsEmpty())
+    {
+        os << ",\"detectLatencyP50\":" << latency.detectMs.Quantile(0.5)
+           << ",\"detectLatencyP99\":" << latency.detectMs.Quantile(0.99);
+    }
+    os << ",\"dwellCount\":" << snapshot.dwellTimes.GetCount();
+    if (!snapshot.dwellTimes.IsEmpty())
+    {
+        os << ",\"dwellP50\":" << snapshot.dwellTimes.Quantile(0.5)
+           << ",\"dwellP90\":" << snapshot.dwellTimes.Quantile(0.9);
+    }
+    os << ",\"enterCount\":" << snapshot.enterCount
+       << ",\"exitCount\":" << snapshot.exitCount
+       << ",\"framesProcessed\":" << latency.framesProcessed
+       << ",\"framesSkipped\":" << latency.framesSkipped
+       << ",\"occupancy\":" << (frame ? frame->tracks.size() : 0)
+       << ",\"passCount\":" << snapshot.passCount
+       << ",\"peakOccupancy\":" << snapshot.peakOccupancy
+       << ",\"startTime\":\"" << formatTime(snapshot.startTime) << "\""
+       << ",\"time\":" << NowMs()
+       << ",\"totalPeople\":" << snapshot.totalPeople << "}";
+    return os.str();
+}
+
+std::string LiveStatsServer::BuildTracksJson() const
+{
+    auto frame = std::atomic_load_explicit(&latestTracks, std::memory_order_acquire);
+
+    std::ostringstream os;
+    os << "{\"frameHeight\":" << (frame ? frame->frameHeight : 0)
+       << ",\"frameWidth\":" << (frame ? frame->frameWidth : 0)
+       << ",\"sequence\":" << (frame ? frame->sequence : 0)
+       << ",\"time\":" << (frame ? frame->timeMs : 0)
+       << ",\"tracks\":[";
+    if (frame)
+    {
+        for (size_t i = 0; i < frame->tracks.size(); ++i)
+        {
+            const LiveTrack& track = frame->tracks[i];
+            os << (i ? "," : "") << "{\"height\":" << track.height << ",\"score\":" << track.score
+               << ",\"trackId\":" << track.trackId << ",\"width\":" << track.width
+               << ",\"x\":" << track.x << ",\"y\":" << track.y << "}";
+        }
+    }
+    os << "]}";
+    return os.str();
+}
+
+std::string LiveStatsServer::BuildBucketsJson(int minutes) const
+{
+    const BucketRing& ring = tracker.GetBucketRing();
+    std::time_t now = std::time(0);
+
+    std::ostringstream os;
+    os << "{\"bucketSeconds\":" << ring.GetBucketSeconds() << ",\"buckets\":[";
+    bool first = true;
+    ring.ForEachBucket(now - static_cast<std::time_t>(minutes) * 60, now + 1, [&](const BucketRing::BucketView& view)
+    {
+        os << (first ? "" : ",") << "{\"enterCount\":" << view.enterCount << ",\"exitCount\":" << view.exitCount
+           << ",\"passCount\":" << view.passCount << ",\"peakOccupancy\":" << view.peakOccupancy
+           << ",\"start\":" << static_cast<int64_t>(view.start) << "}";
+        first = false;
+    });
+    os << "]}";
+    return os.str();
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class MetricTracker;
+
+// One tracked person as last seen by the detection thread, in frame pixels
+struct LiveTrack
+{
+    int trackId;
+    float score;
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// Minimal HTTP server on its own thread exposing live data to a local client:
+//   GET /stats            counts for the live interval
+//   GET /tracks           tracks in the latest processed frame
+//   GET /buckets?minutes= per-minute buckets from the ring (default 60)
+//   GET /events           server-sent "stats" event once per second
+//   GET /encoder          recording encoder settings and throughput, if set
+//   GET /capture          capture pipeline failures and recovery times, if set
+// Requests only read published snapshots: /stats formats the LiveStats the
+// detection thread swaps in every 100 ms, and the track list is swapped in
+// atomically too, so clients never take a lock the detection or capture
+// threads use. /stats is also rebuilt at most every 100 ms however often it
+// is polled.
+class LiveStatsServer
+{
+public:
+    explicit LiveStatsServer(const MetricTracker& tracker);
+    ~LiveStatsServer();
+
+    LiveStatsServer(const LiveStatsServer&) = delete;
+    LiveStatsServer& operator=(const LiveStatsServer&) = delete;
+
+    // Binds to loopback by default; pass "0.0.0.0" to serve the LAN.
+    bool Start(uint16_t port = 8080, const std::string& address = "127.0.0.1");
+    void Stop();
+    bool IsRunning() const { return running.load(); }
+
+    // Source of the /encoder document; set before Start(). Called on the server
+    // thread, so it must only read published state.
+    void SetEncoderStatsFunc(std::function<std::string()> fn) { encoderStatsFunc = std::move(fn); }
+    // Same for the /capture document
+    void SetCaptureStatsFunc(std::function<std::string()> fn) { captureStatsFunc = std::move(fn); }
+
+    // Detection thread: publish the tracks of the frame just processed.
+    // captureMs is when the frame was taken (0 = now), sequence its frame number.
+    void PublishTracks(std::vector<LiveTrack> tracks, int frameWidth, int frameHeight,
+                       int64_t captureMs = 0, uint64_t sequence = 0);
+
+private:
+    struct TrackFrame
+    {
+        int64_t timeMs = 0;
+        uint64_t sequence = 0;
+        int frameWidth = 0;
+        int frameHeight = 0;
+        std::vector<LiveTrack> tracks;
+    };
+
+    struct Client
+    {
+        int fd = -1;
+        std::string request;
+        std::string output;
+        bool streaming = false;        // /events subscriber
+        bool closeAfterWrite = false;
+    };
+
+    void ServerThreadFunc();
+    void AcceptClients();
+    bool ReadRequest(Client& client);
+    void HandleRequest(Client& client);
+    bool WriteOutput(Client& client);
+    void CloseClient(Client& client);
+
+    const std::string& GetStatsJson();
+    std::string BuildStatsJson() const;
+    std::string BuildTracksJson() const;
+    std::string BuildBucketsJson(int minutes) const;
+
+    static void QueueResponse(Client& client, int status, const std::string& body,
+                              const char* contentType = "application/json");
+
+private:
+    const MetricTracker& tracker;
+
+    // Written by the detection thread, read by the server thread
+    std::shared_ptr<const TrackFrame> latestTracks;
+    std::function<std::string()> encoderStatsFunc;
+    std::function<std::string()> captureStatsFunc;
+
+    std::thread serverThread;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> stopRequested{ false };
+    int listenFd = -1;
+    int wakePipe[2] = { -1, -1 };
+
+    // Server thread only
+    std::vector<Client> clients;
+    std::string statsCache;
+    std::chrono::steady_clock::time_point statsBuiltAt;
+};
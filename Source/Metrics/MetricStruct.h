@@ -1,13 +1,20 @@
+#pragma once
+#include "QuantileSketch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <ctime>
 #include <string>
 #include <iomanip>
 #include <sstream>
+#include <vector>
 
 inline std::string formatTime(const std::tm& time)
 {
-    std::ostringstream oss;
-    oss << std::put_time(&time, "%Y-%m-%d %H:%M:%S");
-    return oss.str();
+    char buffer[32];
+    size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &time);
+    return std::string(buffer, length);
 };
 
 struct MetricData
@@ -30,4 +37,68 @@ struct MetricData
     int totalPeople = 0;
     int passCount = 0;
     int enterCount = 0;
+    int exitCount = 0;
+
+    int peakOccupancy = 0;
+    double avgOccupancy = 0.0;  // time-weighted over the interval
+    QuantileSketch dwellTimes;  // seconds per finished track
+    std::vector<uint8_t> heatmap; // Heatmap::Encode()d counts for this interval, empty if none
+};
+
+struct MetricTotals
+{
+    int totalPeople = 0;
+    int totalPass = 0;
+    int totalEnter = 0;
+    int totalExit = 0;
+    int peakOccupancy = 0;
+    QuantileSketch dwellTimes;
+
+    void Add(const MetricData& metric)
+    {
+        totalPeople += metric.totalPeople;
+        totalPass += metric.passCount;
+        totalEnter += metric.enterCount;
+        totalExit += metric.exitCount;
+        peakOccupancy = std::max(peakOccupancy, metric.peakOccupancy);
+        dwellTimes.Merge(metric.dwellTimes);
+    }
+};
+
+enum class MetricEventType : uint8_t
+{
+    Enter = 0,
+    Pass = 1,
+    Exit = 2,
+    // Movement into/out of a configured zone. Logged and linked to clips, but
+    // not people counts: they stay out of the interval totals and the ring.
+    ZoneEnter = 3,
+    ZoneExit = 4
+};
+
+// A single counted person, as recorded in the event log
+struct MetricEvent
+{
+    int64_t timestampMs = 0; // wall clock, milliseconds since epoch
+    int32_t trackId = -1;
+    MetricEventType type = MetricEventType::Enter;
+    uint8_t zone = 0;
+};
+
+// Which camera frame the detection thread is working on and when it was
+// captured (from the buffer PTS, not when it was processed)
+struct FrameStamp
+{
+    uint64_t sequence = 0;
+    int64_t captureWallMs = 0; // wall clock, milliseconds since epoch; 0 = unknown
+    std::chrono::steady_clock::time_point captureTime{};
+};
+
+// Capture-to-result latency in milliseconds
+struct LatencyStats
+{
+    QuantileSketch detectMs;     // capture -> detections ready, every processed frame
+    QuantileSketch countMs;      // capture -> event counted
+    uint64_t framesProcessed = 0;
+    uint64_t framesSkipped = 0;  // captured but never inferred (sequence gaps)
 };
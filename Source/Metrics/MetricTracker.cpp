@@ -1,120 +1,493 @@
 #include "MetricTracker.h"
+#include "MetricWriter.h"
 #include "MongoLink.h"
+#include "SyncManifest.h"
+#include "UploadQueue.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <fstream>
-#include <iomanip>
 #include <ctime>
 #include <chrono>
-#include <json.hpp>
+#include <thread>
 #include <filesystem>
+#include <map>
+#include <set>
 #include <mongocxx/client.hpp>
 #include <mongocxx/instance.hpp>
 #include <mongocxx/uri.hpp>
+#include <unistd.h>
 
-void MetricTracker::NewMetric()
+namespace
 {
-    if (currentMetric)
+std::tm LocalNow()
+{
+    std::time_t t = std::time(0);
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    return tm;
+}
+
+// Hourly documents are keyed by device; the host name is unique per installation
+std::string DeviceId()
+{
+    char name[256] = {};
+    if (gethostname(name, sizeof(name) - 1) != 0 || name[0] == '\0')
     {
-        EndMetric();
+        return "unknown";
     }
-    
-    std::time_t t = std::time(0);
-    std::tm tm = *std::localtime(&t);
-    currentMetric = std::make_unique<MetricData>(tm);
+    return name;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point t)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
 }
+} // namespace
 
-void MetricTracker::EndMetric()
+MetricEvent MetricTracker::MakeEvent(int trackId, MetricEventType type, uint8_t zone) const
 {
-    if (currentMetric)
+    MetricEvent event;
+    // When the person was seen, so the event lines up with the video
+    event.timestampMs = frameStamp.captureWallMs > 0
+                            ? frameStamp.captureWallMs
+                            : std::chrono::duration_cast<std::chrono::milliseconds>(
+                                  std::chrono::system_clock::now().time_since_epoch()).count();
+    event.trackId = trackId;
+    event.type = type;
+    event.zone = zone;
+    return event;
+}
+
+void MetricTracker::LiveInterval::Apply(const MetricEvent& event)
+{
+    switch (event.type)
     {
-        std::time_t t = std::time(0);
-        std::tm tm = *std::localtime(&t);
-        currentMetric->endTime = tm;
-        metrics.push_back(std::move(currentMetric));
-        currentMetric = nullptr;
+    case MetricEventType::Enter:
+        enterCount.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case MetricEventType::Pass:
+        passCount.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case MetricEventType::Exit:
+        exitCount.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case MetricEventType::ZoneEnter:
+    case MetricEventType::ZoneExit:
+        // Zone movement is not a people count
+        break;
     }
 }
 
-void MetricTracker::PersonEntered(int trackId)
+void MetricTracker::LiveInterval::AddDwell(double seconds)
+{
+    std::lock_guard<std::mutex> lock(dwellMutex);
+    dwellTimes.Add(seconds);
+}
+
+MetricData MetricTracker::LiveInterval::Snapshot(std::time_t end, int64_t occupancyIntegralAtEnd) const
 {
-    if (currentMetric && CanAddPerson(trackId))
+    MetricData data(startTime);
+    localtime_r(&end, &data.endTime);
+    data.passCount = passCount.load(std::memory_order_relaxed);
+    data.enterCount = enterCount.load(std::memory_order_relaxed);
+    data.exitCount = exitCount.load(std::memory_order_relaxed);
+    data.totalPeople = data.passCount + data.enterCount;
+    data.peakOccupancy = peakOccupancy.load(std::memory_order_relaxed);
+    if (end > startEpoch)
+    {
+        data.avgOccupancy = static_cast<double>(std::max<int64_t>(0, occupancyIntegralAtEnd - occupancyIntegralAtStart)) /
+                            (static_cast<double>(end - startEpoch) * 1000.0);
+    }
     {
-        currentMetric->enterCount++;
-        currentMetric->totalPeople++;
+        std::lock_guard<std::mutex> lock(dwellMutex);
+        data.dwellTimes = dwellTimes;
+    }
+    return data;
+}
+
+std::shared_ptr<MetricTracker::LiveInterval> MetricTracker::LoadCurrent() const
+{
+    return std::atomic_load_explicit(&currentMetric, std::memory_order_acquire);
+}
 
-        savedTracks.push_back(trackId);
+bool MetricTracker::OpenBucketRing(const std::string& path, int bucketSeconds)
+{
+    // Keep two days of buckets regardless of granularity
+    uint32_t bucketCount = static_cast<uint32_t>(2 * 24 * 3600 / std::max(1, bucketSeconds));
+    bucketRingPath = path;
+    return bucketRing.Open(path, bucketSeconds, std::max<uint32_t>(1, bucketCount));
+}
+
+bool MetricTracker::QueueHourlyUploads(std::time_t from, std::time_t to) const
+{
+    if (!bucketRing.IsOpen())
+    {
+        return false;
+    }
+
+    std::tm tm{};
+    localtime_r(&from, &tm);
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    std::time_t hourStart = std::mktime(&tm);
+
+    const std::string deviceId = DeviceId();
+    bool ok = true;
+    for (; hourStart <= to; hourStart += 3600)
+    {
+        ok = UploadQueue::GetInstance().EnqueueHourlyBuckets(bucketRingPath, deviceId, hourStart) && ok;
+    }
+    return ok;
+}
+
+bool MetricTracker::RestoreFromBuckets()
+{
+    if (!bucketRing.IsOpen())
+    {
+        return false;
+    }
+
+    std::time_t now = std::time(0);
+    std::tm midnight = LocalNow();
+    midnight.tm_hour = 0;
+    midnight.tm_min = 0;
+    midnight.tm_sec = 0;
+    std::time_t dayStart = std::mktime(&midnight);
+
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    if (!metrics.empty())
+    {
+        return false;
+    }
+
+    for (std::time_t from = dayStart; from < now; from += 3600)
+    {
+        MetricData hour = bucketRing.Rollup(from, std::min<std::time_t>(from + 3600, now));
+        if (hour.totalPeople > 0)
+        {
+            metrics.push_back(std::make_unique<MetricData>(hour));
+        }
+    }
+
+    std::cout << "[MetricTracker] Restored " << metrics.size() << " interval(s) from bucket ring" << std::endl;
+    return true;
+}
+
+bool MetricTracker::OpenEventLog(const std::string& directory)
+{
+    return eventLog.Open(directory);
+}
+
+void MetricTracker::NewMetric(std::time_t start)
+{
+    bucketRing.Flush();
+
+    std::time_t now = start ? start : std::time(0);
+    std::tm tm{};
+    localtime_r(&now, &tm);
+
+    // Swap in the new interval first so the detection thread never sees a gap,
+    // then close the old one.
+    auto next = std::make_shared<LiveInterval>(now, tm);
+    next->occupancyIntegralAtStart = OccupancyIntegralAt(static_cast<int64_t>(now) * 1000);
+    {
+        // People already in view count towards the new interval's peak
+        std::lock_guard<std::mutex> lock(occupancyMutex);
+        next->peakOccupancy.store(occupancy, std::memory_order_relaxed);
+    }
+    RetireInterval(std::atomic_exchange_explicit(&currentMetric, next, std::memory_order_acq_rel), now);
+}
+
+void MetricTracker::EndMetric(std::time_t end)
+{
+    bucketRing.Flush();
+    RetireInterval(std::atomic_exchange_explicit(
+        &currentMetric, std::shared_ptr<LiveInterval>(), std::memory_order_acq_rel),
+        end ? end : std::time(0));
+}
+
+void MetricTracker::RetireInterval(std::shared_ptr<LiveInterval> previous, std::time_t end)
+{
+    if (!previous)
+    {
+        return;
+    }
+
+    // Wait out the grace period: once we hold the only reference, no producer
+    // can still be incrementing the retired interval.
+    while (previous.use_count() > 1)
+    {
+        std::this_thread::yield();
+    }
+
+    auto data = std::make_unique<MetricData>(
+        previous->Snapshot(end, OccupancyIntegralAt(static_cast<int64_t>(end) * 1000)));
+    data->heatmap = heatmap.TakeSnapshot();
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    metrics.push_back(std::move(data));
+}
+
+void MetricTracker::BeginFrame(const FrameStamp& stamp)
+{
+    const bool haveCapture = stamp.captureTime != std::chrono::steady_clock::time_point{};
+    {
+        std::lock_guard<std::mutex> lock(latencyMutex);
+        if (frameStamp.sequence != 0 && stamp.sequence > frameStamp.sequence + 1)
+        {
+            latency.framesSkipped += stamp.sequence - frameStamp.sequence - 1;
+        }
+        ++latency.framesProcessed;
+        if (haveCapture)
+        {
+            latency.detectMs.Add(MillisecondsSince(stamp.captureTime));
+        }
+        if (!frameCountMs.IsEmpty())
+        {
+            latency.countMs.Merge(frameCountMs);
+            frameCountMs.Reset();
+        }
+        // Only this thread reads it back, from MakeEvent() and CountEvent()
+        frameStamp = stamp;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - liveStatsPublished >= kLiveStatsPeriod)
+    {
+        liveStatsPublished = now;
+        PublishLiveStats();
+    }
+}
+
+void MetricTracker::PublishLiveStats()
+{
+    // Built here, under this thread's own locks, so readers only ever load a pointer
+    auto stats = std::make_shared<const LiveStats>(LiveStats{ GetSnapshot(), GetLatency() });
+    std::atomic_store_explicit(&liveStats, std::shared_ptr<const LiveStats>(std::move(stats)),
+                               std::memory_order_release);
+}
+
+void MetricTracker::PersonEntered(int trackId)
+{
+    auto current = LoadCurrent();
+    if (current && CanAddPerson(trackId))
+    {
+        CountEvent(*current, MakeEvent(trackId, MetricEventType::Enter));
     }
 }
 
 void MetricTracker::PersonPassed(int trackId)
 {
-    if (currentMetric && CanAddPerson(trackId))
+    auto current = LoadCurrent();
+    if (current && CanAddPerson(trackId))
+    {
+        CountEvent(*current, MakeEvent(trackId, MetricEventType::Pass));
+    }
+}
+
+void MetricTracker::RecordEvent(int trackId, MetricEventType type, uint8_t zone)
+{
+    if (auto current = LoadCurrent())
     {
-        currentMetric->passCount++;
-        currentMetric->totalPeople++;
+        CountEvent(*current, MakeEvent(trackId, type, zone));
+    }
+}
+
+void MetricTracker::TrackStarted(int /*trackId*/, int64_t timeMs)
+{
+    auto current = LoadCurrent();
+    UpdateOccupancy(current.get(), timeMs, +1);
+}
 
-        savedTracks.push_back(trackId);
+void MetricTracker::TrackEnded(int /*trackId*/, int64_t firstSeenMs, int64_t lastSeenMs)
+{
+    auto current = LoadCurrent();
+    UpdateOccupancy(current.get(), lastSeenMs, -1);
+    if (current && lastSeenMs >= firstSeenMs)
+    {
+        current->AddDwell(static_cast<double>(lastSeenMs - firstSeenMs) / 1000.0);
     }
 }
 
-int MetricTracker::GetCurrentCount()
+void MetricTracker::AddDetections(const std::vector<HeatmapRect>& boxes, int frameWidth, int frameHeight)
+{
+    heatmap.Accumulate(boxes, frameWidth, frameHeight);
+}
+
+int64_t MetricTracker::OccupancyIntegralAt(int64_t timeMs) const
 {
-    if (currentMetric)
+    std::lock_guard<std::mutex> lock(occupancyMutex);
+    // A time before the last change (events carry capture times, a little in
+    // the past) gets the integral as of that change
+    if (occupancyChangedMs > 0 && timeMs > occupancyChangedMs)
     {
-        return currentMetric->totalPeople;
+        return occupancyIntegral + static_cast<int64_t>(occupancy) * (timeMs - occupancyChangedMs);
+    }
+    return occupancyIntegral;
+}
+
+void MetricTracker::UpdateOccupancy(LiveInterval* interval, int64_t timeMs, int delta)
+{
+    ConsumeResetRequest();
+
+    {
+        // Accrue the time spent at the previous level. Intervals take the
+        // difference of this running integral between their start and end, so
+        // time at a steady level lands in the interval it was spent in.
+        std::lock_guard<std::mutex> lock(occupancyMutex);
+        if (occupancyChangedMs > 0 && timeMs > occupancyChangedMs)
+        {
+            occupancyIntegral += static_cast<int64_t>(occupancy) * (timeMs - occupancyChangedMs);
+        }
+        occupancy = std::max(0, occupancy + delta);
+        occupancyChangedMs = std::max(occupancyChangedMs, timeMs);
+    }
+
+    if (interval)
+    {
+        int peak = interval->peakOccupancy.load(std::memory_order_relaxed);
+        while (occupancy > peak &&
+               !interval->peakOccupancy.compare_exchange_weak(peak, occupancy, std::memory_order_relaxed))
+        {
+        }
+    }
+    bucketRing.UpdateOccupancy(static_cast<std::time_t>(timeMs / 1000), static_cast<uint32_t>(occupancy));
+}
+
+size_t MetricTracker::ReplayEventLog(const std::string& directory)
+{
+    // Hours past the log's retention only survive as compacted aggregates. A
+    // raw segment wins when both exist (compaction interrupted before delete).
+    std::map<std::time_t, std::string> segments;
+    std::map<std::time_t, std::string> aggregates;
+    std::set<std::time_t> hours;
+    for (const std::string& path : EventLog::ListSegments(directory))
+    {
+        std::time_t hourStart = 0;
+        if (EventLog::HourOfFile(path, hourStart))
+        {
+            segments[hourStart] = path;
+            hours.insert(hourStart);
+        }
+    }
+    for (const std::string& path : EventLog::ListAggregates(directory))
+    {
+        std::time_t hourStart = 0;
+        if (EventLog::HourOfFile(path, hourStart))
+        {
+            aggregates[hourStart] = path;
+            hours.insert(hourStart);
+        }
+    }
+
+    size_t replayed = 0;
+    for (std::time_t hourStart : hours)
+    {
+        // Each file holds one local hour (named for it); replay it as its own interval
+        NewMetric(hourStart);
+        std::shared_ptr<LiveInterval> current = LoadCurrent();
+        if (segments.count(hourStart) > 0)
+        {
+            EventLog::ReadSegment(segments[hourStart], [&](const MetricEvent& event)
+            {
+                current->Apply(event);
+                ++replayed;
+            });
+        }
+        else
+        {
+            EventLog::HourAggregate aggregate;
+            if (EventLog::ReadAggregate(aggregates[hourStart], aggregate))
+            {
+                current->enterCount.store(aggregate.enterCount, std::memory_order_relaxed);
+                current->passCount.store(aggregate.passCount, std::memory_order_relaxed);
+                current->exitCount.store(aggregate.exitCount, std::memory_order_relaxed);
+                replayed += aggregate.enterCount + aggregate.passCount + aggregate.exitCount;
+            }
+        }
+        current.reset();
+        EndMetric(hourStart + 3600);
+    }
+    return replayed;
+}
+
+void MetricTracker::CountEvent(LiveInterval& interval, const MetricEvent& event)
+{
+    interval.Apply(event);
+
+    std::time_t when = static_cast<std::time_t>(event.timestampMs / 1000);
+    switch (event.type)
+    {
+    case MetricEventType::Enter:
+        bucketRing.AddEnter(when);
+        break;
+    case MetricEventType::Pass:
+        bucketRing.AddPass(when);
+        break;
+    case MetricEventType::Exit:
+        bucketRing.AddExit(when);
+        break;
+    case MetricEventType::ZoneEnter:
+    case MetricEventType::ZoneExit:
+        break;
+    }
+    eventLog.Append(event);
+    if (frameStamp.captureTime != std::chrono::steady_clock::time_point{})
+    {
+        // Published with the frame by the next BeginFrame(), not locked per event
+        frameCountMs.Add(MillisecondsSince(frameStamp.captureTime));
+    }
+    if (eventCallback)
+    {
+        eventCallback(event);
+    }
+}
+
+int MetricTracker::GetCurrentCount() const
+{
+    auto current = LoadCurrent();
+    if (current)
+    {
+        return current->passCount.load(std::memory_order_relaxed) +
+               current->enterCount.load(std::memory_order_relaxed);
     }
     return 0;
 }
 
+MetricData MetricTracker::GetSnapshot() const
+{
+    auto current = LoadCurrent();
+    if (current)
+    {
+        std::time_t now = std::time(0);
+        return current->Snapshot(now, OccupancyIntegralAt(static_cast<int64_t>(now) * 1000));
+    }
+    return MetricData(LocalNow());
+}
+
 bool MetricTracker::WriteToFile(const std::string& filename, bool upload) const
 {
     std::cout << "[MetricTracker] Writing metrics to file: " << filename << std::endl;
-    
+
+    std::lock_guard<std::mutex> lock(metricsMutex);
     if (metrics.empty())
     {
         std::cerr << "[MetricTracker] WriteToFile: No metrics to write.\n";
         return false;
     }
     
-    std::ofstream ofs(filename);
-    if (!ofs.is_open())
+    if (!MetricWriter::WriteJsonFile(filename, metrics))
     {
-        std::cerr << "[MetricTracker] WriteToFile: Failed to open file for writing: " << filename << std::endl;
+        std::cerr << "[MetricTracker] WriteToFile: Failed to write file: " << filename << std::endl;
         return false;
     }
 
-    nlohmann::json metricsJson;
-    int totalPeople = 0;
-    int totalPass = 0;
-    int totalEnter = 0;
-    for (const auto& metric : metrics)
-    {
-        metricsJson[metric->name] = {
-            {"startTime", formatTime(metric->startTime)},
-            {"endTime", formatTime(metric->endTime)},
-            {"totalPeople", metric->totalPeople},
-            {"passCount", metric->passCount},
-            {"enterCount", metric->enterCount}
-        };
-        totalPeople += metric->totalPeople;
-        totalPass += metric->passCount;
-        totalEnter += metric->enterCount;
-    }
-
-    metricsJson["totals"] = {
-        {"totalPeople", totalPeople},
-        {"totalPass", totalPass},
-        {"totalEnter", totalEnter}
-    };
-
-    ofs << std::setw(4) << metricsJson << std::endl;
-    ofs.close();
     if (upload)
     {
-        MongoLink::GetInstance().UploadMetric(filename);
+        UploadQueue::GetInstance().EnqueueMetric(filename, MongoLink::BuildMetricDocument(metrics));
     }
-    
+
     return true;
 }
 
@@ -129,9 +502,24 @@ bool MetricTracker::WriteDateTime(bool upload) const
     return true;
 }
 
+void MetricTracker::ConsumeResetRequest()
+{
+    if (resetTracksRequested.load(std::memory_order_relaxed) &&
+        resetTracksRequested.exchange(false, std::memory_order_acquire))
+    {
+        activeTracks.clear();
+        savedTracks.clear();
+        std::lock_guard<std::mutex> lock(occupancyMutex);
+        occupancy = 0;
+        occupancyChangedMs = 0;
+    }
+}
+
 bool MetricTracker::CanAddPerson(int trackId)
 {
-    if (std::find(savedTracks.begin(), savedTracks.end(), trackId) != savedTracks.end())
+    ConsumeResetRequest();
+
+    if (savedTracks.count(trackId) > 0)
     {
         // Already tracked
         return false;
@@ -147,6 +535,7 @@ bool MetricTracker::CanAddPerson(int trackId)
     {
         // Can add person now
         activeTracks.erase(trackId);
+        savedTracks.insert(trackId);
         return true;
     }
 }
@@ -161,11 +550,45 @@ bool MetricTracker::UploadAllMetrics() const
         return false;
     }
 
+    // Only files that are new or changed since the last sync are sent. The
+    // manifest is the one the upload queue records into as well.
+    SyncManifest& manifest = SyncManifest::GetInstance();
+    MongoLink& link = MongoLink::GetInstance();
+    if (!link.WaitUntilConnected(std::chrono::seconds(60))) {
+        std::cerr << "[MetricTracker] MongoDB is not reachable, nothing uploaded" << std::endl;
+        return false;
+    }
+    bool ok = true;
+
+    std::vector<std::string> metricPaths;
+    std::vector<std::string> metricIds;
+    std::vector<SyncManifest::Entry> metricEntries;
     for (const auto& entry : fs::directory_iterator(metricsDir)) {
-        if (entry.is_regular_file()) {
-            std::string filename = entry.path().string();
-            MongoLink::GetInstance().UploadMetric(filename);
+        if (!entry.is_regular_file() || entry.path().extension() == ".tmp") {
+            continue;
+        }
+        std::string filename = entry.path().string();
+        SyncManifest::Entry current, previous;
+        if (manifest.IsUnchanged(filename, &current, &previous)) {
+            continue;
         }
+        metricPaths.push_back(filename);
+        metricIds.push_back(previous.remoteId); // replace the old document, if any
+        metricEntries.push_back(current);
+    }
+
+    if (!metricPaths.empty()) {
+        if (link.UploadMetricFiles(metricPaths, metricIds)) {
+            for (size_t i = 0; i < metricPaths.size(); ++i) {
+                if (!metricIds[i].empty()) {
+                    metricEntries[i].remoteId = metricIds[i];
+                    manifest.Record(metricPaths[i], metricEntries[i]);
+                }
+            }
+        } else {
+            ok = false;
+        }
+        manifest.Save();
     }
 
     fs::path videosDir = "build/Data/Videos";
@@ -174,21 +597,96 @@ bool MetricTracker::UploadAllMetrics() const
         return false;
     }
 
+    struct VideoJob
+    {
+        std::string path;
+        std::string name;
+        SyncManifest::Entry current;
+        std::string previousId;
+        bool previousFragmented = false;
+    };
+    std::vector<VideoJob> videos;
     for (const auto& entry : fs::directory_iterator(videosDir)) {
-        if (entry.is_regular_file()) {
-            std::string filepath = entry.path().string();
-            std::string filename = entry.path().filename().string();
-            MongoLink::GetInstance().UploadVideo(filepath, filename);
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+        VideoJob job;
+        job.path = entry.path().string();
+        job.name = entry.path().filename().string();
+        SyncManifest::Entry previous;
+        if (manifest.IsUnchanged(job.path, &job.current, &previous)) {
+            continue;
         }
+        job.previousId = previous.remoteId;
+        job.previousFragmented = previous.fragmented;
+        videos.push_back(std::move(job));
     }
-    
-    return true;
+
+    // Videos are independent; upload a few at once, each on its own pooled client
+    std::atomic<size_t> next{ 0 };
+    std::atomic<bool> videosOk{ true };
+    auto worker = [&]() {
+        for (size_t i = next.fetch_add(1); i < videos.size(); i = next.fetch_add(1)) {
+            VideoJob& job = videos[i];
+            std::string remoteId;
+            if (!link.UploadVideo(job.path, job.name, &remoteId)) {
+                videosOk.store(false);
+                continue;
+            }
+            if (!job.previousId.empty() && !job.previousFragmented && job.previousId != remoteId) {
+                link.DeleteVideo(job.previousId);
+            }
+            job.current.remoteId = remoteId;
+            manifest.Record(job.path, job.current);
+        }
+    };
+    std::vector<std::thread> workers;
+    size_t workerCount = std::min(kParallelVideoUploads, videos.size());
+    for (size_t i = 1; i < workerCount; ++i) {
+        workers.emplace_back(worker);
+    }
+    if (workerCount > 0) {
+        worker();
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    if (!videos.empty()) {
+        manifest.Save();
+    }
+
+    std::cout << "[MetricTracker] Synced " << metricPaths.size() << " metric file(s) and " << videos.size()
+              << " video(s); everything else was unchanged" << std::endl;
+    return ok && videosOk.load();
 }
 
 void MetricTracker::ResetMetrics()
 {
-    metrics.clear();
-    currentMetric = nullptr;
-    activeTracks.clear();
-    savedTracks.clear();
+    std::atomic_store_explicit(&currentMetric, std::shared_ptr<LiveInterval>(),
+                               std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(metricsMutex);
+        metrics.clear();
+    }
+    heatmap.Reset();
+    resetTracksRequested.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(latencyMutex);
+        const LatencyStats& day = latency;
+        if (!day.countMs.IsEmpty())
+        {
+            std::cout << "[MetricTracker] capture-to-count latency p50 " << day.countMs.Quantile(0.5) << " ms, p99 "
+                      << day.countMs.Quantile(0.99) << " ms over " << day.countMs.GetCount() << " events" << std::endl;
+        }
+        latency.detectMs.Reset();
+        latency.countMs.Reset();
+        latency.framesProcessed = 0;
+        latency.framesSkipped = 0;
+    }
+}
+
+LatencyStats MetricTracker::GetLatency() const
+{
+    std::lock_guard<std::mutex> lock(latencyMutex);
+    return latency;
 }
\ No newline at end of file
@@ -1,37 +1,179 @@
 #pragma once
+#include "BucketRing.h"
+#include "EventLog.h"
+#include "Heatmap.h"
 #include "MetricStruct.h"
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
-#include <map>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 class MetricTracker
 {
+public:
+    static constexpr size_t kParallelVideoUploads = 3;
+    // How often the detection thread republishes LiveStats
+    static constexpr std::chrono::milliseconds kLiveStatsPeriod{ 100 };
+
+    // The live interval and latency as of one processed frame. Published whole
+    // and never modified, so readers share it without taking any lock.
+    struct LiveStats
+    {
+        MetricData interval;
+        LatencyStats latency;
+    };
+
 public:
     MetricTracker() = default;
 
-    void NewMetric();
-    void EndMetric();
+    // Mirror every count into a memory-mapped per-minute ring so a power cut does
+    // not lose the day. Call before any producer thread starts.
+    bool OpenBucketRing(const std::string& path, int bucketSeconds = 60);
+    // Rebuild today's closed hours from the ring after a restart.
+    bool RestoreFromBuckets();
+    const BucketRing& GetBucketRing() const { return bucketRing; }
+    // Queue every wall-clock hour overlapping [from, to] for upload to the
+    // hourly bucketed collection. Hours are replaced on re-upload, so queueing
+    // an unfinished hour now and again once it is over is fine.
+    bool QueueHourlyUploads(std::time_t from, std::time_t to) const;
+    // Append every counted person to a binary event log in directory.
+    bool OpenEventLog(const std::string& directory);
+
+    // Main thread: interval rollover. The live interval is swapped atomically so
+    // producers never touch a freed interval. A zero time means now.
+    void NewMetric(std::time_t start = 0);
+    void EndMetric(std::time_t end = 0);
+
+    // Detection thread: the frame whose detections are about to be counted.
+    // Events are stamped with its capture time and the capture-to-count
+    // latency is measured against it; without it events get the current time.
+    // Also republishes LiveStats every kLiveStatsPeriod.
+    void BeginFrame(const FrameStamp& stamp);
+
+    // Detection thread: lock-free counting hot path.
     void PersonEntered(int trackId);
     void PersonPassed(int trackId);
+    // Detection thread: count an event decided by the caller (e.g. CountingEngine).
+    // No sighting threshold is applied; zone is 0 for "no zone".
+    void RecordEvent(int trackId, MetricEventType type, uint8_t zone = 0);
+
+    // Called on the detection thread for every counted event, after it is
+    // logged. Set before counting starts.
+    void SetEventCallback(std::function<void(const MetricEvent&)> fn) { eventCallback = std::move(fn); }
+
+    // Detection thread: track lifetimes from the tracker drive occupancy and
+    // dwell-time statistics. Times are wall clock milliseconds.
+    void TrackStarted(int trackId, int64_t timeMs);
+    void TrackEnded(int trackId, int64_t firstSeenMs, int64_t lastSeenMs);
+    // Detection thread: feed one frame's boxes into the occupancy heatmap.
+    // Each closed interval carries the heatmap accumulated during it.
+    void AddDetections(const std::vector<HeatmapRect>& boxes, int frameWidth, int frameHeight);
+
+    // Rebuild one interval per hour of an event log, from its raw segment or,
+    // past retention, its compacted aggregate. Returns the number of events
+    // replayed.
+    size_t ReplayEventLog(const std::string& directory);
 
-    int GetCurrentCount();
+    // Any thread: lock-free reads of the live interval.
+    int GetCurrentCount() const;
+    MetricData GetSnapshot() const;
+    // Any thread: capture latency since start or the last ResetMetrics(). The
+    // frame being counted shows up once the next one begins.
+    LatencyStats GetLatency() const;
+    // Any thread, lock-free: the stats last published by BeginFrame(); null
+    // until the first frame.
+    std::shared_ptr<const LiveStats> GetLiveStats() const
+    {
+        return std::atomic_load_explicit(&liveStats, std::memory_order_acquire);
+    }
 
     bool WriteToFile(const std::string& filename, bool upload = false) const;
     bool WriteDateTime(bool upload = false) const;
 
+    // Upload every metric file and video that is new or changed since the last
+    // sync, as recorded in the SyncManifest. Safe to re-run after a failure.
     bool UploadAllMetrics() const;
-    
+
     void ResetMetrics();
 
 private:
+    // Counters for the interval currently being recorded. Producers only ever
+    // increment the atomics; readers take a consistent copy via Snapshot().
+    struct LiveInterval
+    {
+        LiveInterval(std::time_t start, const std::tm& startTm) : startEpoch(start), startTime(startTm) {}
+
+        void Apply(const MetricEvent& event);
+        void AddDwell(double seconds);
+        // occupancyIntegralAtEnd: OccupancyIntegralAt(end), for avgOccupancy
+        MetricData Snapshot(std::time_t end, int64_t occupancyIntegralAtEnd) const;
+
+        std::time_t startEpoch;
+        std::tm startTime;
+        std::atomic<int> passCount{ 0 };
+        std::atomic<int> enterCount{ 0 };
+        std::atomic<int> exitCount{ 0 };
+        std::atomic<int> peakOccupancy{ 0 };
+        int64_t occupancyIntegralAtStart = 0; // set before the interval is published
+
+        // Track expiries are rare next to per-frame counting, so the sketch
+        // sits behind a plain mutex.
+        mutable std::mutex dwellMutex;
+        QuantileSketch dwellTimes;
+    };
+
     bool CanAddPerson(int trackId);
-    
+    void ConsumeResetRequest();
+    std::shared_ptr<LiveInterval> LoadCurrent() const;
+    void RetireInterval(std::shared_ptr<LiveInterval> previous, std::time_t end);
+    void CountEvent(LiveInterval& interval, const MetricEvent& event);
+    void UpdateOccupancy(LiveInterval* interval, int64_t timeMs, int delta);
+    // Person-milliseconds of occupancy accrued up to timeMs
+    int64_t OccupancyIntegralAt(int64_t timeMs) const;
+    void PublishLiveStats();
+    MetricEvent MakeEvent(int trackId, MetricEventType type, uint8_t zone = 0) const;
+
 private:
-    std::unique_ptr<MetricData> currentMetric{ nullptr };
+    // Published with std::atomic_load/atomic_exchange (RCU style): a producer that
+    // loaded the old interval keeps it alive until its increment is done.
+    std::shared_ptr<LiveInterval> currentMetric{ nullptr };
+
+    // Closed intervals; only touched at rollover and export, never on the hot path.
+    mutable std::mutex metricsMutex;
     std::vector<std::unique_ptr<MetricData>> metrics;
 
-    std::map<int, int> activeTracks; // <trackId, captureCount>
-    std::vector<int> savedTracks;   // trackIds already counted
-};
\ No newline at end of file
+    // Owned by the detection thread. ResetMetrics() only raises the flag and the
+    // producer clears its own state on its next call.
+    std::unordered_map<int, int> activeTracks; // <trackId, captureCount>
+    std::unordered_set<int> savedTracks;       // trackIds already counted
+    std::atomic<bool> resetTracksRequested{ false };
+    // Written by the detection thread, read at rollover and by snapshots.
+    // Occupancy only changes when a track starts or ends, so a plain mutex will do.
+    mutable std::mutex occupancyMutex;
+    int occupancy = 0;
+    int64_t occupancyChangedMs = 0;
+    int64_t occupancyIntegral = 0; // person-ms up to occupancyChangedMs
+    FrameStamp frameStamp;
+
+    // Written once per processed frame, so a plain mutex will do
+    mutable std::mutex latencyMutex;
+    LatencyStats latency;
+    // Owned by the detection thread: the current frame's capture-to-count
+    // latencies, folded into latency.countMs by the next BeginFrame()
+    QuantileSketch frameCountMs;
+    // Swapped in with std::atomic_store by the detection thread
+    std::shared_ptr<const LiveStats> liveStats;
+    std::chrono::steady_clock::time_point liveStatsPublished;
+
+    BucketRing bucketRing;
+    std::string bucketRingPath;
+    EventLog eventLog;
+    Heatmap heatmap;
+    std::function<void(const MetricEvent&)> eventCallback;
+};
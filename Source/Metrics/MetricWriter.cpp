@@ -0,0 +1,195 @@
+#include "MetricWriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <json.hpp>
+#include <vector>
+
+void MetricWriter::WriteString(std::ostream& os, const std::string& value)
+{
+    os << '"';
+    for (char c : value)
+    {
+        switch (c)
+        {
+        case '"': os << "\\\""; break;
+        case '\\': os << "\\\\"; break;
+        case '\n': os << "\\n"; break;
+        case '\r': os << "\\r"; break;
+        case '\t': os << "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                static const char* hex = "0123456789abcdef";
+                os << "\\u00" << hex[(c >> 4) & 0xF] << hex[c & 0xF];
+            }
+            else
+            {
+                os << c;
+            }
+        }
+    }
+    os << '"';
+}
+
+void MetricWriter::WriteBase64(std::ostream& os, const std::vector<uint8_t>& data)
+{
+    static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t i = 0;
+    for (; i + 3 <= data.size(); i += 3)
+    {
+        uint32_t v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        os << alphabet[(v >> 18) & 0x3F] << alphabet[(v >> 12) & 0x3F] << alphabet[(v >> 6) & 0x3F] << alphabet[v & 0x3F];
+    }
+    if (i + 1 == data.size())
+    {
+        uint32_t v = data[i] << 16;
+        os << alphabet[(v >> 18) & 0x3F] << alphabet[(v >> 12) & 0x3F] << "==";
+    }
+    else if (i + 2 == data.size())
+    {
+        uint32_t v = (data[i] << 16) | (data[i + 1] << 8);
+        os << alphabet[(v >> 18) & 0x3F] << alphabet[(v >> 12) & 0x3F] << alphabet[(v >> 6) & 0x3F] << '=';
+    }
+}
+
+void MetricWriter::WriteDouble(std::ostream& os, double value)
+{
+    // Same shortest round-trip digits nlohmann::json prints
+    if (!std::isfinite(value))
+    {
+        os << "null";
+        return;
+    }
+    char buffer[64];
+    char* end = nlohmann::detail::to_chars(buffer, buffer + sizeof(buffer), value);
+    os.write(buffer, end - buffer);
+}
+
+void MetricWriter::WriteDwell(std::ostream& os, const QuantileSketch& dwellTimes, const char* indent)
+{
+    os << indent << "\"dwellCount\": " << static_cast<long long>(dwellTimes.GetCount()) << ",\n";
+    os << indent << "\"dwellP50\": ";
+    WriteDouble(os, dwellTimes.Quantile(0.50));
+    os << ",\n" << indent << "\"dwellP90\": ";
+    WriteDouble(os, dwellTimes.Quantile(0.90));
+    os << ",\n" << indent << "\"dwellP99\": ";
+    WriteDouble(os, dwellTimes.Quantile(0.99));
+    os << ",\n";
+}
+
+void MetricWriter::WriteInterval(std::ostream& os, const MetricData& metric)
+{
+    os << "    ";
+    WriteString(os, metric.name);
+    os << ": {\n"
+       << "        \"avgOccupancy\": ";
+    WriteDouble(os, metric.avgOccupancy);
+    os << ",\n";
+    WriteDwell(os, metric.dwellTimes, "        ");
+    os << "        \"endTime\": \"" << formatTime(metric.endTime) << "\",\n"
+       << "        \"enterCount\": " << metric.enterCount << ",\n"
+       << "        \"exitCount\": " << metric.exitCount << ",\n";
+    if (!metric.heatmap.empty())
+    {
+        os << "        \"heatmap\": \"";
+        WriteBase64(os, metric.heatmap);
+        os << "\",\n";
+    }
+    os << "        \"passCount\": " << metric.passCount << ",\n"
+       << "        \"peakOccupancy\": " << metric.peakOccupancy << ",\n"
+       << "        \"startTime\": \"" << formatTime(metric.startTime) << "\",\n"
+       << "        \"totalPeople\": " << metric.totalPeople << "\n"
+       << "    }";
+}
+
+bool MetricWriter::WriteJson(std::ostream& os, const std::vector<std::unique_ptr<MetricData>>& metrics)
+{
+    // Totals cover every interval, as they always have
+    MetricTotals totals;
+    for (const auto& metric : metrics)
+    {
+        totals.Add(*metric);
+    }
+
+    // Objects are keyed by interval name, so emit them the way nlohmann::json
+    // did: sorted by key, a repeated name keeping its last interval, and
+    // "totals" in its sorted place (replacing an interval of that name).
+    std::vector<const MetricData*> sorted;
+    sorted.reserve(metrics.size());
+    for (const auto& metric : metrics)
+    {
+        sorted.push_back(metric.get());
+    }
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const MetricData* a, const MetricData* b) { return a->name < b->name; });
+
+    const std::string totalsKey = "totals";
+    bool first = true;
+    auto separate = [&]
+    {
+        os << (first ? "{\n" : ",\n");
+        first = false;
+    };
+    auto writeTotals = [&]
+    {
+        separate();
+        os << "    \"totals\": {\n";
+        WriteDwell(os, totals.dwellTimes, "        ");
+        os << "        \"peakOccupancy\": " << totals.peakOccupancy << ",\n"
+           << "        \"totalEnter\": " << totals.totalEnter << ",\n"
+           << "        \"totalExit\": " << totals.totalExit << ",\n"
+           << "        \"totalPass\": " << totals.totalPass << ",\n"
+           << "        \"totalPeople\": " << totals.totalPeople << "\n"
+           << "    }";
+    };
+
+    bool totalsWritten = false;
+    for (size_t i = 0; i < sorted.size(); ++i)
+    {
+        const MetricData& metric = *sorted[i];
+        if (i + 1 < sorted.size() && sorted[i + 1]->name == metric.name)
+        {
+            continue; // overwritten by a later interval of the same name
+        }
+        if (!totalsWritten && metric.name >= totalsKey)
+        {
+            writeTotals();
+            totalsWritten = true;
+            if (metric.name == totalsKey)
+            {
+                continue;
+            }
+        }
+        separate();
+        WriteInterval(os, metric);
+    }
+    if (!totalsWritten)
+    {
+        writeTotals();
+    }
+    os << "\n}\n";
+
+    return static_cast<bool>(os);
+}
+
+bool MetricWriter::WriteJsonFile(const std::string& filename, const std::vector<std::unique_ptr<MetricData>>& metrics)
+{
+    // Large buffer so a day of one-minute buckets goes out in a handful of writes.
+    // It has to be installed before the file is opened to take effect.
+    std::vector<char> buffer(1 << 16);
+    std::ofstream ofs;
+    ofs.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    ofs.open(filename);
+    if (!ofs.is_open())
+    {
+        std::cerr << "[MetricWriter] Failed to open file for writing: " << filename << std::endl;
+        return false;
+    }
+
+    bool ok = WriteJson(ofs, metrics);
+    ofs.close();
+    return ok && !ofs.fail();
+}
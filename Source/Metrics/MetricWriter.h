@@ -0,0 +1,26 @@
+#pragma once
+#include "MetricStruct.h"
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Serializes a day of intervals straight to a stream, one interval at a time,
+// instead of building an nlohmann::json tree first. The layout matches what
+// the dashboard already reads: one object per interval keyed by its name,
+// plus "totals", byte for byte what nlohmann::json's setw(4) dump gives.
+class MetricWriter
+{
+public:
+    static bool WriteJson(std::ostream& os, const std::vector<std::unique_ptr<MetricData>>& metrics);
+    static bool WriteJsonFile(const std::string& filename, const std::vector<std::unique_ptr<MetricData>>& metrics);
+
+private:
+    static void WriteString(std::ostream& os, const std::string& value);
+    static void WriteBase64(std::ostream& os, const std::vector<uint8_t>& data);
+    static void WriteDouble(std::ostream& os, double value);
+    static void WriteDwell(std::ostream& os, const QuantileSketch& dwellTimes, const char* indent);
+    static void WriteInterval(std::ostream& os, const MetricData& metric);
+};
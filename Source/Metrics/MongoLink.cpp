@@ -1,26 +1,306 @@
 #include "MongoLink.h"
+#include <bsoncxx/builder/basic/array.hpp>
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/builder/basic/kvp.hpp>
+#include <bsoncxx/builder/concatenate.hpp>
 #include <bsoncxx/json.hpp>
+#include <bsoncxx/oid.hpp>
+#include <bsoncxx/types.hpp>
+#include <bsoncxx/types/bson_value/view.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <mongocxx/bulk_write.hpp>
 #include <mongocxx/gridfs/bucket.hpp>
+#include <mongocxx/model/replace_one.hpp>
+#include <mongocxx/options/bulk_write.hpp>
+#include <mongocxx/options/find_one_and_update.hpp>
+#include <mongocxx/options/gridfs/upload.hpp>
+#include <mongocxx/options/index.hpp>
+#include <mongocxx/options/replace.hpp>
+#include <mongocxx/options/update.hpp>
 #include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-bool MongoLink::UploadMetric(const std::string &jsonPath) const
+namespace
+{
+double ThreadCpuSeconds()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+std::optional<bsoncxx::document::value> ReadJsonDocument(const std::string& jsonPath)
+{
+    std::ifstream ifs(jsonPath);
+    if (!ifs.is_open())
+    {
+        std::cerr << "Error opening JSON file for upload: " << jsonPath << std::endl;
+        return std::nullopt;
+    }
+    std::stringstream buffer;
+    buffer << ifs.rdbuf();
+    return bsoncxx::from_json(buffer.str());
+}
+
+void AppendDwell(bsoncxx::builder::basic::sub_document& sub, const QuantileSketch& dwellTimes)
+{
+    using bsoncxx::builder::basic::kvp;
+    sub.append(kvp("dwellCount", static_cast<int64_t>(dwellTimes.GetCount())),
+               kvp("dwellP50", dwellTimes.Quantile(0.50)),
+               kvp("dwellP90", dwellTimes.Quantile(0.90)),
+               kvp("dwellP99", dwellTimes.Quantile(0.99)));
+}
+} // namespace
+
+bsoncxx::document::value MongoLink::BuildMetricDocument(const std::vector<std::unique_ptr<MetricData>>& metrics)
+{
+    using bsoncxx::builder::basic::kvp;
+    using bsoncxx::builder::basic::sub_document;
+
+    MetricTotals totals;
+    bsoncxx::builder::basic::document doc;
+    for (const auto& metric : metrics)
+    {
+        doc.append(kvp(metric->name, [&](sub_document sub)
+        {
+            sub.append(kvp("startTime", formatTime(metric->startTime)),
+                       kvp("endTime", formatTime(metric->endTime)),
+                       kvp("totalPeople", metric->totalPeople),
+                       kvp("passCount", metric->passCount),
+                       kvp("enterCount", metric->enterCount),
+                       kvp("exitCount", metric->exitCount),
+                       kvp("peakOccupancy", metric->peakOccupancy),
+                       kvp("avgOccupancy", metric->avgOccupancy));
+            AppendDwell(sub, metric->dwellTimes);
+            if (!metric->heatmap.empty())
+            {
+                sub.append(kvp("heatmap", bsoncxx::types::b_binary{
+                    bsoncxx::binary_sub_type::k_binary,
+                    static_cast<uint32_t>(metric->heatmap.size()),
+                    metric->heatmap.data() }));
+            }
+        }));
+        totals.Add(*metric);
+    }
+
+    doc.append(kvp("totals", [&](sub_document sub)
+    {
+        sub.append(kvp("totalPeople", totals.totalPeople),
+                   kvp("totalPass", totals.totalPass),
+                   kvp("totalEnter", totals.totalEnter),
+                   kvp("totalExit", totals.totalExit),
+                   kvp("peakOccupancy", totals.peakOccupancy));
+        AppendDwell(sub, totals.dwellTimes);
+    }));
+    return doc.extract();
+}
+
+bool MongoLink::UploadMetric(const std::string &jsonPath, std::string* remoteId) const
 {
     std::cout << "[MongoLink] Uploading metric: " << jsonPath << std::endl;
     try
     {
-        auto collection = db["MetricsData"];
-        std::ifstream ifs(jsonPath);
-        if (!ifs.is_open())
+        auto doc = ReadJsonDocument(jsonPath);
+        return doc && UploadMetricDocument(doc->view(), remoteId);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error uploading metric to MongoDB: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool MongoLink::UploadMetricFiles(const std::vector<std::string>& jsonPaths, std::vector<std::string>& remoteIds) const
+{
+    using bsoncxx::builder::basic::kvp;
+    using bsoncxx::builder::basic::make_document;
+
+    if (remoteIds.size() != jsonPaths.size())
+    {
+        remoteIds.resize(jsonPaths.size());
+    }
+    std::cout << "[MongoLink] Uploading " << jsonPaths.size() << " metric file(s) in batches of "
+              << kMetricBatchSize << std::endl;
+    try
+    {
+        auto entry = AcquireClient();
+        if (!entry)
+        {
+            std::cerr << "Error uploading metrics: MongoDB is not connected" << std::endl;
+            return false;
+        }
+        auto collection = (*entry)["MarbleMetrics"]["MetricsData"];
+
+        std::vector<std::string> batchIds;
+        for (size_t start = 0; start < jsonPaths.size(); start += kMetricBatchSize)
+        {
+            size_t end = std::min(start + kMetricBatchSize, jsonPaths.size());
+
+            // Replace-by-_id with upsert makes a retried batch land on the same
+            // documents instead of inserting duplicates.
+            mongocxx::options::bulk_write options;
+            options.ordered(false);
+            auto bulk = collection.create_bulk_write(options);
+            batchIds.assign(remoteIds.begin() + start, remoteIds.begin() + end);
+            size_t queued = 0;
+            for (size_t i = start; i < end; ++i)
+            {
+                auto parsed = ReadJsonDocument(jsonPaths[i]);
+                if (!parsed)
+                {
+                    batchIds[i - start].clear();
+                    continue;
+                }
+                bsoncxx::oid id = remoteIds[i].empty() ? bsoncxx::oid{} : bsoncxx::oid{ remoteIds[i] };
+                bsoncxx::builder::basic::document doc;
+                doc.append(kvp("_id", id), bsoncxx::builder::concatenate(parsed->view()));
+
+                mongocxx::model::replace_one replace{ make_document(kvp("_id", id)), doc.extract() };
+                replace.upsert(true);
+                bulk.append(replace);
+                batchIds[i - start] = id.to_string();
+                ++queued;
+            }
+            if (queued == 0)
+            {
+                continue;
+            }
+            bulk.execute();
+            std::copy(batchIds.begin(), batchIds.end(), remoteIds.begin() + start);
+        }
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error bulk uploading metrics to MongoDB: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bsoncxx::document::value MongoLink::BuildHourlyDocument(const std::string& deviceId, std::time_t hourStart,
+                                                        int bucketSeconds,
+                                                        const std::vector<BucketRing::BucketView>& buckets)
+{
+    using bsoncxx::builder::basic::kvp;
+    using bsoncxx::builder::basic::sub_array;
+    using bsoncxx::builder::basic::sub_document;
+
+    // Fixed-length arrays: slot i is the bucket starting i * bucketSeconds into
+    // the hour, zero when nothing was recorded.
+    const size_t slots = static_cast<size_t>(3600 / std::max(1, bucketSeconds));
+    std::vector<BucketRing::BucketView> bySlot(slots, BucketRing::BucketView{});
+    int totalEnter = 0, totalPass = 0, totalExit = 0, peakOccupancy = 0;
+    for (const auto& bucket : buckets)
+    {
+        if (bucket.start < hourStart)
+        {
+            continue;
+        }
+        size_t slot = static_cast<size_t>((bucket.start - hourStart) / std::max(1, bucketSeconds));
+        if (slot >= slots)
+        {
+            continue;
+        }
+        bySlot[slot] = bucket;
+        totalEnter += static_cast<int>(bucket.enterCount);
+        totalPass += static_cast<int>(bucket.passCount);
+        totalExit += static_cast<int>(bucket.exitCount);
+        peakOccupancy = std::max(peakOccupancy, static_cast<int>(bucket.peakOccupancy));
+    }
+
+    bsoncxx::builder::basic::document doc;
+    doc.append(kvp("_id", deviceId + ":" + std::to_string(static_cast<int64_t>(hourStart))),
+               kvp("device", deviceId),
+               kvp("hour", bsoncxx::types::b_date{ std::chrono::system_clock::from_time_t(hourStart) }),
+               kvp("bucketSeconds", bucketSeconds));
+    auto appendSeries = [&](const char* name, uint32_t BucketRing::BucketView::*field)
+    {
+        doc.append(kvp(name, [&](sub_array array)
+        {
+            for (const auto& bucket : bySlot)
+            {
+                array.append(static_cast<int32_t>(bucket.*field));
+            }
+        }));
+    };
+    appendSeries("enter", &BucketRing::BucketView::enterCount);
+    appendSeries("pass", &BucketRing::BucketView::passCount);
+    appendSeries("exit", &BucketRing::BucketView::exitCount);
+    appendSeries("peak", &BucketRing::BucketView::peakOccupancy);
+    doc.append(kvp("totals", [&](sub_document sub)
+               {
+                   sub.append(kvp("totalPeople", totalEnter + totalPass),
+                              kvp("totalEnter", totalEnter),
+                              kvp("totalPass", totalPass),
+                              kvp("totalExit", totalExit),
+                              kvp("peakOccupancy", peakOccupancy));
+               }),
+               kvp("updatedAt", bsoncxx::types::b_date{ std::chrono::system_clock::now() }));
+    return doc.extract();
+}
+
+bool MongoLink::UploadHourlyBuckets(const std::string& deviceId, std::time_t hourStart, int bucketSeconds,
+                                    const std::vector<BucketRing::BucketView>& buckets) const
+{
+    using bsoncxx::builder::basic::kvp;
+    using bsoncxx::builder::basic::make_document;
+
+    try
+    {
+        auto entry = AcquireClient();
+        if (!entry)
         {
-            std::cerr << "Error opening JSON file for upload: " << jsonPath << std::endl;
+            std::cerr << "Error uploading hourly metrics: MongoDB is not connected" << std::endl;
             return false;
         }
-        std::stringstream buffer;
-        buffer << ifs.rdbuf();
-        bsoncxx::document::value doc = bsoncxx::from_json(buffer.str());
-        collection.insert_one(doc.view());
+        auto doc = BuildHourlyDocument(deviceId, hourStart, bucketSeconds, buckets);
+        mongocxx::options::replace options;
+        options.upsert(true);
+        (*entry)["MarbleMetrics"]["MetricsHourly"].replace_one(
+            make_document(kvp("_id", doc.view()["_id"].get_string().value)), doc.view(), options);
+        std::cout << "[MongoLink] Uploaded hourly buckets for " << deviceId << " at " << hourStart << std::endl;
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error uploading hourly metrics to MongoDB: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool MongoLink::UploadMetrics(const std::vector<std::unique_ptr<MetricData>>& metrics) const
+{
+    std::cout << "[MongoLink] Uploading " << metrics.size() << " metric interval(s)" << std::endl;
+    return UploadMetricDocument(BuildMetricDocument(metrics).view());
+}
+
+bool MongoLink::UploadMetricDocument(bsoncxx::document::view document, std::string* remoteId) const
+{
+    try
+    {
+        auto entry = AcquireClient();
+        if (!entry)
+        {
+            std::cerr << "Error uploading metric: MongoDB is not connected" << std::endl;
+            return false;
+        }
+        auto result = (*entry)["MarbleMetrics"]["MetricsData"].insert_one(document);
+        if (result && remoteId && result->inserted_id().type() == bsoncxx::type::k_oid)
+        {
+            *remoteId = result->inserted_id().get_oid().value.to_string();
+        }
         return true;
     }
     catch (const std::exception &e)
@@ -30,82 +310,442 @@ bool MongoLink::UploadMetric(const std::string &jsonPath) const
     }
 }
 
-bool MongoLink::UploadVideo(const std::string &videoPath, const std::string &videoName) const
+bool MongoLink::UploadVideo(const std::string &videoPath, const std::string &videoName, std::string* remoteId) const
 {
     std::cout << "[MongoLink] Uploading video: " << videoPath << " as " << videoName << std::endl;
     try
     {
+        auto entry = AcquireClient();
+        if (!entry)
+        {
+            std::cerr << "Error uploading video: MongoDB is not connected" << std::endl;
+            return false;
+        }
+        mongocxx::gridfs::bucket bucket = (*entry)["MarbleMetrics"].gridfs_bucket();
+        UploadStats stats;
+        if (!WriteGridFSFile(bucket, videoPath, videoName, videoChunkBytes, &stats, 0, UINT64_MAX, &videoPacer))
+        {
+            return false;
+        }
+        if (remoteId)
+        {
+            *remoteId = stats.fileId;
+        }
+
+        double megabytes = static_cast<double>(stats.bytes) / (1024.0 * 1024.0);
+        std::cout << "[MongoLink] Uploaded " << megabytes << " MB in " << stats.seconds << " s ("
+                  << (stats.seconds > 0.0 ? megabytes / stats.seconds : 0.0) << " MB/s, "
+                  << (stats.bytes > 0 ? stats.cpuSeconds * 1024.0 / megabytes : 0.0) << " CPU s/GB)" << std::endl;
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error uploading video to MongoDB GridFS: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool MongoLink::UploadVideoPart(const std::string &videoPath, const std::string &videoName, int partIndex,
+                                uint64_t offset, uint64_t length, bool lastPart, std::string* remoteId) const
+{
+    using bsoncxx::builder::basic::kvp;
+    using bsoncxx::builder::basic::make_document;
+
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), ".part%04d", partIndex);
+    std::string partName = videoName + suffix;
+    try
+    {
+        auto entry = AcquireClient();
+        if (!entry)
+        {
+            std::cerr << "Error uploading video part: MongoDB is not connected" << std::endl;
+            return false;
+        }
+        auto db = (*entry)["MarbleMetrics"];
         mongocxx::gridfs::bucket bucket = db.gridfs_bucket();
-        std::ifstream ifs(videoPath, std::ios::binary);
-        if (!ifs.is_open())
+        UploadStats stats;
+        if (!WriteGridFSFile(bucket, videoPath, partName, videoChunkBytes, &stats, offset, length, &videoPacer))
         {
-            std::cerr << "Error opening video file for upload: " << videoPath << std::endl;
             return false;
         }
 
-        auto uploader = bucket.open_upload_stream(videoName);
-        const size_t bufferSize = 4096;
-        std::vector<char> buffer(bufferSize);
+        bsoncxx::builder::basic::document set;
+        set.append(kvp("updatedAt", bsoncxx::types::b_date{ std::chrono::system_clock::now() }));
+        if (lastPart)
+        {
+            set.append(kvp("partCount", partIndex + 1),
+                       kvp("totalBytes", static_cast<int64_t>(offset + length)));
+        }
+        auto update = make_document(
+            kvp("$addToSet", make_document(kvp("parts", make_document(
+                kvp("index", partIndex),
+                kvp("name", partName),
+                kvp("offset", static_cast<int64_t>(offset)),
+                kvp("length", static_cast<int64_t>(length)))))),
+            kvp("$set", set.extract()));
 
-        while (ifs)
+        if (remoteId)
         {
-            ifs.read(reinterpret_cast<char *>(buffer.data()), bufferSize);
-            std::streamsize bytesRead = ifs.gcount();
-            if (bytesRead > 0)
+            mongocxx::options::find_one_and_update options;
+            options.upsert(true);
+            options.return_document(mongocxx::options::return_document::k_after);
+            options.projection(make_document(kvp("_id", 1)));
+            auto manifest = db["VideoManifests"].find_one_and_update(make_document(kvp("name", videoName)),
+                                                                     update.view(), options);
+            if (manifest)
             {
-                uploader.write(reinterpret_cast<const uint8_t *>(buffer.data()),
-                               static_cast<size_t>(bytesRead));
+                *remoteId = manifest->view()["_id"].get_oid().value.to_string();
             }
         }
+        else
+        {
+            mongocxx::options::update options;
+            options.upsert(true);
+            db["VideoManifests"].update_one(make_document(kvp("name", videoName)), update.view(), options);
+        }
 
-        uploader.close();
+        std::cout << "[MongoLink] Uploaded " << partName << " (" << length / 1024 << " KiB, "
+                  << (stats.seconds > 0.0 ? static_cast<double>(length) / (1024.0 * 1024.0) / stats.seconds : 0.0)
+                  << " MB/s)" << std::endl;
         return true;
     }
     catch (const std::exception &e)
     {
-        std::cerr << "Error uploading video to MongoDB GridFS: " << e.what() << std::endl;
+        std::cerr << "Error uploading video part to MongoDB GridFS: " << e.what() << std::endl;
         return false;
     }
 }
 
-MongoLink::MongoLink()
+bool MongoLink::DeleteVideo(const std::string &remoteId) const
 {
     try
     {
-        instance = std::make_unique<mongocxx::instance>();
-        // Read MongoDB connection string from secrets.json
-        std::ifstream secretsFile("build/Assets/Secrets/secrets.json");
-        if (!secretsFile.is_open())
+        auto entry = AcquireClient();
+        if (!entry)
         {
-            throw std::runtime_error("Could not open secrets.json for MongoDB connection string.");
+            return false;
         }
-        std::stringstream secretsBuffer;
-        secretsBuffer << secretsFile.rdbuf();
-        auto secretsDoc = bsoncxx::from_json(secretsBuffer.str());
-        auto connStrElem = secretsDoc.view()["MongoDBConnectionString"];
-        if (!connStrElem || connStrElem.type() != bsoncxx::type::k_string)
+        mongocxx::gridfs::bucket bucket = (*entry)["MarbleMetrics"].gridfs_bucket();
+        bucket.delete_file(bsoncxx::types::bson_value::view{ bsoncxx::types::b_oid{ bsoncxx::oid{ remoteId } } });
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error deleting video " << remoteId << " from MongoDB GridFS: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void MongoLink::SetVideoChunkSize(int32_t bytes)
+{
+    // Stay clear of the 16 MiB document limit; tiny chunks defeat the purpose
+    videoChunkBytes = std::clamp<int32_t>(bytes, 64 * 1024, 8 * 1024 * 1024);
+}
+
+void MongoLink::UploadPacer::Pace(size_t bytes)
+{
+    const uint64_t bytesPerSecond = rate.load(std::memory_order_relaxed);
+    if (bytesPerSecond == 0)
+    {
+        return;
+    }
+    std::chrono::steady_clock::time_point sendAt;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Idle time earns at most a second of burst
+        auto now = std::chrono::steady_clock::now();
+        nextSend = std::max(nextSend, now - std::chrono::seconds(1));
+        sendAt = nextSend;
+        nextSend += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(bytes) / bytesPerSecond));
+    }
+    std::this_thread::sleep_until(sendAt);
+}
+
+bool MongoLink::WriteGridFSFile(mongocxx::gridfs::bucket& bucket, const std::string& path,
+                                const std::string& name, int32_t chunkBytes, UploadStats* stats,
+                                uint64_t offset, uint64_t length, UploadPacer* pacer)
+{
+    auto wallStart = std::chrono::steady_clock::now();
+    double cpuStart = ThreadCpuSeconds();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        std::cerr << "Error opening video file for upload: " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0)
+    {
+        std::cerr << "Error reading size of video file: " << path << std::endl;
+        ::close(fd);
+        return false;
+    }
+    const uint64_t fileSize = static_cast<uint64_t>(st.st_size);
+    if (offset > fileSize || (length != UINT64_MAX && offset + length > fileSize))
+    {
+        std::cerr << "Error uploading " << path << ": range " << offset << "+" << length
+                  << " is past the end of the file (" << fileSize << " bytes)" << std::endl;
+        ::close(fd);
+        return false;
+    }
+    const size_t rangeSize = static_cast<size_t>(length == UINT64_MAX ? fileSize - offset : length);
+    const size_t chunk = static_cast<size_t>(chunkBytes);
+
+    mongocxx::options::gridfs::upload options;
+    options.chunk_size_bytes(chunkBytes);
+    auto uploader = bucket.open_upload_stream(name, options);
+
+    // mmap offsets must be page aligned; map from the page holding the range start
+    const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const uint64_t mapOffset = offset & ~(pageSize - 1);
+    const size_t mapSize = static_cast<size_t>(offset - mapOffset) + rangeSize;
+    void* mapped = rangeSize > 0 ? mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(mapOffset))
+                                 : MAP_FAILED;
+    try
+    {
+        if (mapped != MAP_FAILED)
         {
-            throw std::runtime_error("MongoDBConnectionString not found or invalid in secrets.json.");
+            // Hand the driver whole chunks straight out of the page cache, and drop
+            // pages we are done with so an hour of video does not evict everything else.
+            madvise(mapped, mapSize, MADV_SEQUENTIAL);
+            uint8_t* base = static_cast<uint8_t*>(mapped);
+            const uint8_t* data = base + (offset - mapOffset);
+            const size_t releaseStep = chunk * 32;
+            size_t released = 0; // bytes of the mapping already given back
+            for (size_t pos = 0; pos < rangeSize; pos += chunk)
+            {
+                size_t done = std::min(pos + chunk, rangeSize);
+                if (pacer)
+                {
+                    pacer->Pace(done - pos);
+                }
+                uploader.write(data + pos, done - pos);
+                size_t mappedDone = static_cast<size_t>(offset - mapOffset) + done;
+                if (mappedDone - released >= releaseStep)
+                {
+                    size_t upTo = mappedDone & ~static_cast<size_t>(pageSize - 1);
+                    madvise(base + released, upTo - released, MADV_DONTNEED);
+                    released = upTo;
+                }
+            }
         }
-        const auto uri = mongocxx::uri{std::string(connStrElem.get_string().value)};
+        else if (rangeSize > 0)
+        {
+            // Fall back to large page-aligned reads, several chunks at a time
+            const size_t blockBytes = (chunk * 4 + 4095) & ~static_cast<size_t>(4095);
+            void* block = nullptr;
+            if (posix_memalign(&block, 4096, blockBytes) != 0)
+            {
+                throw std::runtime_error("out of memory for upload buffer");
+            }
+            std::unique_ptr<uint8_t, decltype(&std::free)> buffer(static_cast<uint8_t*>(block), &std::free);
+            posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(rangeSize), POSIX_FADV_SEQUENTIAL);
+            size_t remaining = rangeSize;
+            off_t readOffset = static_cast<off_t>(offset);
+            while (remaining > 0)
+            {
+                ssize_t n = ::pread(fd, buffer.get(), std::min(blockBytes, remaining), readOffset);
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n < 0)
+                {
+                    throw std::runtime_error(std::string("read failed: ") + std::strerror(errno));
+                }
+                if (n == 0)
+                {
+                    throw std::runtime_error("file shrank during upload");
+                }
+                for (size_t pos = 0; pos < static_cast<size_t>(n); pos += chunk)
+                {
+                    size_t bytes = std::min(chunk, static_cast<size_t>(n) - pos);
+                    if (pacer)
+                    {
+                        pacer->Pace(bytes);
+                    }
+                    uploader.write(buffer.get() + pos, bytes);
+                }
+                remaining -= static_cast<size_t>(n);
+                readOffset += n;
+            }
+        }
+        auto result = uploader.close();
+        if (stats && result.id().type() == bsoncxx::type::k_oid)
+        {
+            stats->fileId = result.id().get_oid().value.to_string();
+        }
+    }
+    catch (...)
+    {
+        if (mapped != MAP_FAILED)
+        {
+            munmap(mapped, mapSize);
+        }
+        ::close(fd);
+        throw;
+    }
+
+    if (mapped != MAP_FAILED)
+    {
+        munmap(mapped, mapSize);
+    }
+    ::close(fd);
+
+    if (stats)
+    {
+        stats->bytes = rangeSize;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+        stats->cpuSeconds = ThreadCpuSeconds() - cpuStart;
+    }
+    return true;
+}
 
-        mongocxx::options::client clientOptions;
-        const auto api =
-            mongocxx::options::server_api(mongocxx::options::server_api::version::k_version_1);
-        clientOptions.server_api_opts(api);
+MongoLink::MongoLink()
+{
+    instance = std::make_unique<mongocxx::instance>();
+    ConnectAsync();
+}
+
+MongoLink::~MongoLink()
+{
+    {
+        std::lock_guard<std::mutex> lock(connectMutex);
+        stopConnecting = true;
+    }
+    connectCondVar.notify_all();
+    // A ping in progress still runs into its server selection timeout
+    if (connectThread.joinable())
+    {
+        connectThread.join();
+    }
+}
 
-        client = std::make_unique<mongocxx::client>(uri, clientOptions);
+void MongoLink::ConnectAsync()
+{
+    std::lock_guard<std::mutex> lock(connectMutex);
+    if (connectThread.joinable() || stopConnecting)
+    {
+        return;
+    }
+    connectThread = std::thread(&MongoLink::ConnectThreadFunc, this);
+}
 
-        db = (*client)["MarbleMetrics"];
+bool MongoLink::WaitUntilConnected(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(connectMutex);
+    return connectCondVar.wait_for(lock, timeout, [this] { return IsConnected() || stopConnecting; }) && IsConnected();
+}
 
-        // Ping the database.
-        const auto ping_cmd =
-            bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("ping", 1));
-        db.run_command(ping_cmd.view());
-        std::cout << "Pinged your deployment. You successfully connected to MongoDB!" << std::endl;
+std::optional<mongocxx::uri> MongoLink::ReadConnectionUri()
+{
+    // Read MongoDB connection string from secrets.json
+    std::ifstream secretsFile("build/Assets/Secrets/secrets.json");
+    if (!secretsFile.is_open())
+    {
+        std::cerr << "[MongoLink] Could not open secrets.json for MongoDB connection string." << std::endl;
+        return std::nullopt;
+    }
+    std::stringstream secretsBuffer;
+    secretsBuffer << secretsFile.rdbuf();
+    auto secretsDoc = bsoncxx::from_json(secretsBuffer.str());
+    auto connStrElem = secretsDoc.view()["MongoDBConnectionString"];
+    if (!connStrElem || connStrElem.type() != bsoncxx::type::k_string)
+    {
+        std::cerr << "[MongoLink] MongoDBConnectionString not found or invalid in secrets.json." << std::endl;
+        return std::nullopt;
+    }
+    return mongocxx::uri{ std::string(connStrElem.get_string().value) };
+}
+
+void MongoLink::ConnectThreadFunc()
+{
+    // Creating the pool may resolve DNS (mongodb+srv) and the ping waits on
+    // server selection, so both stay off the capture and upload threads.
+    std::chrono::seconds backoff{ 2 };
+    const std::chrono::seconds maxBackoff{ 60 };
+    for (;;)
+    {
+        try
+        {
+            if (!poolReady.load(std::memory_order_acquire))
+            {
+                std::optional<mongocxx::uri> uri = ReadConnectionUri();
+                if (!uri)
+                {
+                    return; // a configuration problem; retrying will not fix it
+                }
+
+                mongocxx::options::client clientOptions;
+                const auto api =
+                    mongocxx::options::server_api(mongocxx::options::server_api::version::k_version_1);
+                clientOptions.server_api_opts(api);
+
+                pool = std::make_unique<mongocxx::pool>(*uri, mongocxx::options::pool(clientOptions));
+                poolReady.store(true, std::memory_order_release);
+            }
+
+            // Ping the database.
+            const auto ping_cmd =
+                bsoncxx::builder::basic::make_document(bsoncxx::builder::basic::kvp("ping", 1));
+            auto entry = pool->acquire();
+            (*entry)["MarbleMetrics"].run_command(ping_cmd.view());
+            std::cout << "Pinged your deployment. You successfully connected to MongoDB!" << std::endl;
+            auto db = (*entry)["MarbleMetrics"];
+            CreateIndexes(db);
+
+            {
+                std::lock_guard<std::mutex> lock(connectMutex);
+                connected.store(true, std::memory_order_release);
+            }
+            connectCondVar.notify_all();
+            return;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "[MongoLink] MongoDB not reachable, retrying in " << backoff.count() << " s: " << e.what() << std::endl;
+        }
+
+        std::unique_lock<std::mutex> lock(connectMutex);
+        if (connectCondVar.wait_for(lock, backoff, [this] { return stopConnecting; }))
+        {
+            return;
+        }
+        backoff = std::min(backoff * 2, maxBackoff);
+    }
+}
+
+void MongoLink::CreateIndexes(mongocxx::database& db)
+{
+    using bsoncxx::builder::basic::kvp;
+    using bsoncxx::builder::basic::make_document;
+
+    // create_index is a no-op when the index already exists
+    try
+    {
+        mongocxx::options::index unique;
+        unique.unique(true);
+        auto hourly = db["MetricsHourly"];
+        hourly.create_index(make_document(kvp("device", 1), kvp("hour", 1)), unique);
+        // All devices over a time range
+        hourly.create_index(make_document(kvp("hour", 1)));
     }
     catch (const std::exception &e)
     {
-        std::cerr << "Error initializing MongoDB client: " << e.what() << std::endl;
+        std::cerr << "[MongoLink] Could not create MetricsHourly indexes: " << e.what() << std::endl;
     }
-}
\ No newline at end of file
+}
+
+mongocxx::pool::entry MongoLink::AcquireClient() const
+{
+    // Never wait for the connect thread: a caller without a client fails fast
+    if (!poolReady.load(std::memory_order_acquire))
+    {
+        return mongocxx::pool::entry{};
+    }
+    return pool->acquire();
+}
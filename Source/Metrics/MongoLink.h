@@ -1,11 +1,58 @@
 #pragma once
+#include "BucketRing.h"
+#include "MetricStruct.h"
+
+#include <bsoncxx/document/value.hpp>
 #include <mongocxx/client.hpp>
+#include <mongocxx/gridfs/bucket.hpp>
 #include <mongocxx/instance.hpp>
+#include <mongocxx/pool.hpp>
 #include <mongocxx/uri.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
+#include <vector>
 
 class MongoLink
 {
+public:
+    // GridFS chunk size used for videos. The driver default (255 KiB) means
+    // thousands of chunk documents per hourly file; 1 MiB keeps them well
+    // under the 16 MiB BSON limit while cutting round trips four-fold.
+    static constexpr int32_t kDefaultVideoChunkBytes = 1024 * 1024;
+
+    struct UploadStats
+    {
+        uint64_t bytes = 0;
+        double seconds = 0.0;    // wall time
+        double cpuSeconds = 0.0; // CPU time of the calling thread
+        std::string fileId;      // ObjectId hex of the new GridFS file
+    };
+
+    // Metric files sent per bulk write by UploadMetricFiles
+    static constexpr size_t kMetricBatchSize = 128;
+
+    // Holds concurrent GridFS uploads to a shared byte rate by spacing their
+    // chunk writes, so a long video does not saturate the uplink.
+    class UploadPacer
+    {
+    public:
+        void SetRate(uint64_t bytesPerSecond) { rate.store(bytesPerSecond, std::memory_order_relaxed); }
+        // Blocks until bytes more may be sent; returns at once when the rate is 0
+        void Pace(size_t bytes);
+
+    private:
+        std::atomic<uint64_t> rate{ 0 };
+        std::mutex mutex;
+        std::chrono::steady_clock::time_point nextSend;
+    };
+
 public:
     MongoLink(const MongoLink&) = delete;
     MongoLink& operator=(const MongoLink&) = delete;
@@ -15,14 +62,81 @@ public:
         return instance;
     }
 
-    bool UploadMetric(const std::string& jsonPath) const;
-    bool UploadVideo(const std::string& videoPath, const std::string& videoName) const;
-    
+    // Start connecting on a background thread; called by the constructor, so
+    // GetInstance() never waits on the network. Until the connection is up,
+    // uploads fail fast and the UploadQueue retries them later.
+    void ConnectAsync();
+    bool IsConnected() const { return connected.load(std::memory_order_acquire); }
+    // For one-shot tools that have nothing to do until the link is up
+    bool WaitUntilConnected(std::chrono::milliseconds timeout);
+
+    // Upload methods that take a remoteId pointer store the ObjectId hex of the
+    // created document or GridFS file there on success.
+    bool UploadMetric(const std::string& jsonPath, std::string* remoteId = nullptr) const;
+    // Insert or replace many metric files with one unordered bulk write per
+    // kMetricBatchSize files. remoteIds must match jsonPaths in size: a non-empty
+    // id replaces that document (a re-upload of a changed file), an empty one
+    // inserts a new document and receives its id.
+    bool UploadMetricFiles(const std::vector<std::string>& jsonPaths, std::vector<std::string>& remoteIds) const;
+    // Upload a day of intervals built directly as BSON, skipping the JSON file round trip
+    bool UploadMetrics(const std::vector<std::unique_ptr<MetricData>>& metrics) const;
+    bool UploadMetricDocument(bsoncxx::document::view document, std::string* remoteId = nullptr) const;
+    // Upsert one document per device per hour into MetricsHourly, holding the
+    // minute buckets as fixed-length arrays plus the hour's totals, so a
+    // dashboard range query reads a few small documents instead of whole days.
+    // Re-sending an hour replaces it, so a partial hour can be uploaded early.
+    bool UploadHourlyBuckets(const std::string& deviceId, std::time_t hourStart, int bucketSeconds,
+                             const std::vector<BucketRing::BucketView>& buckets) const;
+    static bsoncxx::document::value BuildHourlyDocument(const std::string& deviceId, std::time_t hourStart,
+                                                        int bucketSeconds,
+                                                        const std::vector<BucketRing::BucketView>& buckets);
+    static bsoncxx::document::value BuildMetricDocument(const std::vector<std::unique_ptr<MetricData>>& metrics);
+    bool UploadVideo(const std::string& videoPath, const std::string& videoName, std::string* remoteId = nullptr) const;
+    // Remove a GridFS file, e.g. the previous upload of a video that changed
+    bool DeleteVideo(const std::string& remoteId) const;
+    // Upload bytes [offset, offset + length) of a recording as GridFS file
+    // "<videoName>.partNNNN" and record it in the VideoManifests collection. The
+    // manifest lists every uploaded part; lastPart also stores the part count,
+    // so a reader knows the video is complete once all parts are present.
+    // remoteId, when given, receives the ObjectId hex of the manifest document.
+    bool UploadVideoPart(const std::string& videoPath, const std::string& videoName, int partIndex,
+                         uint64_t offset, uint64_t length, bool lastPart, std::string* remoteId = nullptr) const;
+    void SetVideoChunkSize(int32_t bytes);
+    // Cap the bytes per second of video uploads; 0 is unlimited. Metric and
+    // hourly documents are small and are never held back.
+    void SetMaxVideoUploadRate(uint64_t bytesPerSecond) { videoPacer.SetRate(bytesPerSecond); }
+
+    // Stream a file, or the byte range [offset, offset + length) of it, into a
+    // GridFS bucket in whole chunks, reading it through mmap (or large aligned
+    // reads if mapping fails). pacer, when given, paces every chunk write.
+    static bool WriteGridFSFile(mongocxx::gridfs::bucket& bucket, const std::string& path,
+                                const std::string& name, int32_t chunkBytes, UploadStats* stats = nullptr,
+                                uint64_t offset = 0, uint64_t length = UINT64_MAX, UploadPacer* pacer = nullptr);
+
+
 private:
     MongoLink();
+    ~MongoLink();
+
+    void ConnectThreadFunc();
+    static void CreateIndexes(mongocxx::database& db);
+    static std::optional<mongocxx::uri> ReadConnectionUri();
+
+    // mongocxx::client is not thread-safe; every upload borrows its own from the
+    // pool so uploads can run in parallel. Null until the connect thread has
+    // created the pool.
+    mongocxx::pool::entry AcquireClient() const;
 
 private:
     std::unique_ptr<mongocxx::instance> instance; // This should be done only once.
-    std::unique_ptr<mongocxx::client> client;
-    mongocxx::database db;
+    std::unique_ptr<mongocxx::pool> pool; // written once by the connect thread, then published by poolReady
+    std::atomic<bool> poolReady{ false };
+    std::atomic<bool> connected{ false };
+
+    std::thread connectThread;
+    std::mutex connectMutex;
+    std::condition_variable connectCondVar;
+    bool stopConnecting = false;
+    int32_t videoChunkBytes = kDefaultVideoChunkBytes;
+    mutable UploadPacer videoPacer;
 };
\ No newline at end of file
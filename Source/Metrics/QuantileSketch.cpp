@@ -0,0 +1,161 @@
+#include "QuantileSketch.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr double kPi = 3.14159265358979323846;
+
+// k1 scale function and its inverse: centroids near q=0 and q=1 stay small,
+// which is what keeps p99 accurate.
+double ScaleK(double q, double compression)
+{
+    return compression / (2.0 * kPi) * std::asin(2.0 * q - 1.0);
+}
+
+double ScaleQ(double k, double compression)
+{
+    double angle = std::min(kPi / 2.0, std::max(-kPi / 2.0, k * 2.0 * kPi / compression));
+    return (std::sin(angle) + 1.0) / 2.0;
+}
+} // namespace
+
+QuantileSketch::QuantileSketch(double compression)
+    : compression(std::max(20.0, compression)),
+      bufferCapacity(static_cast<size_t>(std::max(20.0, compression)) * 5)
+{
+    centroids.reserve(static_cast<size_t>(this->compression) + 1);
+    buffer.reserve(bufferCapacity);
+}
+
+void QuantileSketch::Add(double value, double weight)
+{
+    if (!(weight > 0.0) || std::isnan(value))
+    {
+        return;
+    }
+
+    if (IsEmpty())
+    {
+        min = value;
+        max = value;
+    }
+    else
+    {
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+
+    buffer.push_back({ value, weight });
+    bufferWeight += weight;
+    if (buffer.size() >= bufferCapacity)
+    {
+        Flush();
+    }
+}
+
+void QuantileSketch::Merge(const QuantileSketch& other)
+{
+    if (other.IsEmpty())
+    {
+        return;
+    }
+
+    other.Flush();
+    double otherMin = other.min;
+    double otherMax = other.max;
+    for (const Centroid& c : other.centroids)
+    {
+        Add(c.mean, c.weight);
+    }
+    min = std::min(min, otherMin);
+    max = std::max(max, otherMax);
+}
+
+void QuantileSketch::Reset()
+{
+    centroids.clear();
+    buffer.clear();
+    totalWeight = 0.0;
+    bufferWeight = 0.0;
+    min = 0.0;
+    max = 0.0;
+}
+
+void QuantileSketch::Flush() const
+{
+    if (buffer.empty())
+    {
+        return;
+    }
+
+    buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+    std::sort(buffer.begin(), buffer.end(), [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+
+    double total = totalWeight + bufferWeight;
+    centroids.clear();
+
+    Centroid current = buffer.front();
+    double weightSoFar = 0.0;
+    double limit = total * ScaleQ(ScaleK(0.0, compression) + 1.0, compression);
+    for (size_t i = 1; i < buffer.size(); ++i)
+    {
+        const Centroid& next = buffer[i];
+        if (weightSoFar + current.weight + next.weight <= limit)
+        {
+            current.weight += next.weight;
+            current.mean += (next.mean - current.mean) * next.weight / current.weight;
+        }
+        else
+        {
+            weightSoFar += current.weight;
+            centroids.push_back(current);
+            limit = total * ScaleQ(ScaleK(weightSoFar / total, compression) + 1.0, compression);
+            current = next;
+        }
+    }
+    centroids.push_back(current);
+
+    buffer.clear();
+    totalWeight = total;
+    bufferWeight = 0.0;
+}
+
+double QuantileSketch::Quantile(double q) const
+{
+    if (IsEmpty())
+    {
+        return 0.0;
+    }
+    Flush();
+
+    q = std::min(1.0, std::max(0.0, q));
+    if (centroids.size() == 1)
+    {
+        return centroids.front().mean;
+    }
+
+    // Each centroid's mass is centred on its mean; interpolate between
+    // neighbouring centres and use min/max for the outer halves.
+    double target = q * totalWeight;
+    double cumulative = 0.0;
+    for (size_t i = 0; i < centroids.size(); ++i)
+    {
+        const Centroid& c = centroids[i];
+        double centre = cumulative + c.weight / 2.0;
+        if (target < centre)
+        {
+            double leftMean = i == 0 ? min : centroids[i - 1].mean;
+            double leftPos = i == 0 ? 0.0 : cumulative - centroids[i - 1].weight / 2.0;
+            double span = centre - leftPos;
+            return span > 0.0 ? leftMean + (c.mean - leftMean) * (target - leftPos) / span : c.mean;
+        }
+        cumulative += c.weight;
+    }
+
+    const Centroid& last = centroids.back();
+    double lastCentre = totalWeight - last.weight / 2.0;
+    double span = totalWeight - lastCentre;
+    return span > 0.0 ? last.mean + (max - last.mean) * (target - lastCentre) / span : max;
+}
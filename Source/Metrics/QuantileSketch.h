@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Merging t-digest: a fixed-memory sketch of a distribution that answers
+// quantile queries with small relative error at the tails (p90/p99).
+// Memory is bounded by the compression factor, not by the number of samples,
+// so each metric interval can carry one without growing over the day.
+class QuantileSketch
+{
+public:
+    explicit QuantileSketch(double compression = 100.0);
+
+    void Add(double value, double weight = 1.0);
+    void Merge(const QuantileSketch& other);
+    void Reset();
+
+    // q in [0, 1]. Returns 0 when empty.
+    double Quantile(double q) const;
+
+    double GetCount() const { return totalWeight + bufferWeight; }
+    double GetMin() const { return min; }
+    double GetMax() const { return max; }
+    bool IsEmpty() const { return GetCount() <= 0.0; }
+
+private:
+    struct Centroid
+    {
+        double mean;
+        double weight;
+    };
+
+    // Fold the unsorted buffer into the centroid list
+    void Flush() const;
+
+private:
+    double compression;
+    size_t bufferCapacity;
+
+    mutable std::vector<Centroid> centroids;
+    mutable std::vector<Centroid> buffer;
+    mutable double totalWeight = 0.0;  // weight held in centroids
+    mutable double bufferWeight = 0.0; // weight still in buffer
+    double min = 0.0;
+    double max = 0.0;
+};
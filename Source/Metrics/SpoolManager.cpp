@@ -0,0 +1,298 @@
+#include "SpoolManager.h"
+#include "UploadQueue.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <json.hpp>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+SpoolManager::~SpoolManager()
+{
+    Stop();
+}
+
+bool SpoolManager::Start(const std::string& indexPath, const std::vector<std::string>& directories)
+{
+    return Start(indexPath, directories, Options{});
+}
+
+bool SpoolManager::Start(const std::string& indexPath, const std::vector<std::string>& directories,
+                         const Options& options)
+{
+    if (running.load())
+    {
+        return true;
+    }
+
+    this->options = options;
+    this->indexPath = indexPath;
+    this->directories = directories;
+    LoadIndex();
+
+    stopRequested.store(false);
+    running.store(true);
+    spoolThread = std::thread(&SpoolManager::SpoolThreadFunc, this);
+
+    std::cout << "[SpoolManager] Started with a quota of " << options.quotaBytes / (1024 * 1024) << " MiB" << std::endl;
+    return true;
+}
+
+void SpoolManager::Stop()
+{
+    if (!running.load())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopRequested.store(true);
+    }
+    wakeCondVar.notify_all();
+    if (spoolThread.joinable())
+    {
+        spoolThread.join();
+    }
+    running.store(false);
+}
+
+void SpoolManager::SetActivityFunc(ActivityFunc fn)
+{
+    std::lock_guard<std::mutex> lock(activityMutex);
+    activityFunc = std::move(fn);
+}
+
+void SpoolManager::RequestScan()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeRequested = true;
+    }
+    wakeCondVar.notify_all();
+}
+
+void SpoolManager::SpoolThreadFunc()
+{
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    while (!stopRequested.load())
+    {
+        wakeRequested = false;
+        lock.unlock();
+        Scan();
+        lock.lock();
+        wakeCondVar.wait_for(lock, options.scanInterval, [this] { return wakeRequested || stopRequested.load(); });
+    }
+}
+
+void SpoolManager::Scan()
+{
+    namespace fs = std::filesystem;
+    const std::time_t now = std::time(0);
+
+    ActivityFunc activity;
+    {
+        std::lock_guard<std::mutex> lock(activityMutex);
+        activity = activityFunc;
+    }
+
+    bool changed = false;
+    uint64_t total = 0;
+    std::unordered_map<std::string, Entry> present;
+    for (const auto& directory : directories)
+    {
+        std::error_code ec;
+        for (const auto& file : fs::directory_iterator(directory, ec))
+        {
+            // .json sidecars (clip event lists) go with their video, see Evict()
+            if (!file.is_regular_file(ec) || file.path().extension() == ".tmp" || file.path().extension() == ".json")
+            {
+                continue;
+            }
+            std::string path = file.path().string();
+            struct stat st{};
+            if (::stat(path.c_str(), &st) != 0)
+            {
+                continue;
+            }
+
+            auto it = entries.find(path);
+            Entry entry = it != entries.end() ? it->second : Entry{};
+            if (it == entries.end())
+            {
+                // A file already on disk when we first look is dated by its mtime
+                entry.firstSeen = std::min<int64_t>(now, st.st_mtime);
+                changed = true;
+            }
+            if (entry.bytes != static_cast<uint64_t>(st.st_size) || entry.lastModified != st.st_mtime)
+            {
+                entry.bytes = static_cast<uint64_t>(st.st_size);
+                entry.lastModified = st.st_mtime;
+                entry.activity = -1;
+                changed = true;
+            }
+            bool settled = now - entry.lastModified >= options.settleTime.count();
+            if (settled && entry.activity < 0 && activity)
+            {
+                entry.activity = static_cast<int64_t>(activity(entry.firstSeen, entry.lastModified + 1));
+                changed = true;
+            }
+            total += entry.bytes;
+            present.emplace(std::move(path), entry);
+        }
+    }
+    changed = changed || present.size() != entries.size();
+    entries = std::move(present);
+    spoolBytes.store(total);
+
+    uint64_t excess = total > options.quotaBytes ? total - options.quotaBytes : 0;
+    uint64_t freeBytes = FreeBytes();
+    if (freeBytes < options.minFreeBytes)
+    {
+        excess = std::max(excess, options.minFreeBytes - freeBytes);
+    }
+    if (excess > 0)
+    {
+        Evict(excess, now);
+        changed = true;
+    }
+
+    if (changed)
+    {
+        SaveIndex();
+    }
+}
+
+void SpoolManager::Evict(uint64_t bytesToFree, std::time_t now)
+{
+    struct Candidate
+    {
+        std::string path;
+        const Entry* entry;
+        bool pendingUpload;
+    };
+
+    std::vector<Candidate> candidates;
+    for (const auto& [path, entry] : entries)
+    {
+        if (now - entry.lastModified < options.settleTime.count())
+        {
+            continue; // still being recorded
+        }
+        candidates.push_back({ path, &entry, UploadQueue::GetInstance().IsPending(path) });
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+    {
+        if (a.pendingUpload != b.pendingUpload)
+        {
+            return !a.pendingUpload;
+        }
+        if (a.pendingUpload && a.entry->activity != b.entry->activity)
+        {
+            return a.entry->activity < b.entry->activity;
+        }
+        return a.entry->firstSeen < b.entry->firstSeen;
+    });
+
+    uint64_t freed = 0;
+    std::vector<std::string> removed;
+    for (const auto& candidate : candidates)
+    {
+        if (freed >= bytesToFree)
+        {
+            break;
+        }
+        std::error_code ec;
+        if (!std::filesystem::remove(candidate.path, ec) || ec)
+        {
+            std::cerr << "[SpoolManager] Cannot evict " << candidate.path << ": " << ec.message() << std::endl;
+            continue;
+        }
+        std::filesystem::remove(std::filesystem::path(candidate.path).replace_extension(".json"), ec);
+        std::cerr << "[SpoolManager] Evicted " << candidate.path << " (" << candidate.entry->bytes / (1024 * 1024)
+                  << " MiB, " << (candidate.pendingUpload ? "never uploaded" : "no upload pending")
+                  << ", activity " << candidate.entry->activity << ")" << std::endl;
+        freed += candidate.entry->bytes;
+        removed.push_back(candidate.path);
+    }
+
+    for (const auto& path : removed)
+    {
+        entries.erase(path);
+    }
+    spoolBytes.fetch_sub(std::min(freed, spoolBytes.load()));
+    if (freed < bytesToFree)
+    {
+        std::cerr << "[SpoolManager] Still " << (bytesToFree - freed) / (1024 * 1024)
+                  << " MiB over budget; nothing else can be evicted yet" << std::endl;
+    }
+}
+
+uint64_t SpoolManager::FreeBytes() const
+{
+    struct statvfs fs{};
+    if (directories.empty() || statvfs(directories.front().c_str(), &fs) != 0)
+    {
+        return UINT64_MAX;
+    }
+    return static_cast<uint64_t>(fs.f_bavail) * fs.f_frsize;
+}
+
+bool SpoolManager::LoadIndex()
+{
+    entries.clear();
+    std::ifstream in(indexPath);
+    if (!in.is_open())
+    {
+        return true; // first run
+    }
+
+    nlohmann::json json = nlohmann::json::parse(in, nullptr, false);
+    if (json.is_discarded() || !json.contains("files"))
+    {
+        std::cerr << "[SpoolManager] Ignoring unreadable index " << indexPath << std::endl;
+        return false;
+    }
+    for (const auto& item : json["files"].items())
+    {
+        const auto& value = item.value();
+        Entry entry;
+        entry.bytes = value.value("bytes", uint64_t{ 0 });
+        entry.firstSeen = value.value("firstSeen", int64_t{ 0 });
+        entry.lastModified = value.value("lastModified", int64_t{ 0 });
+        entry.activity = value.value("activity", int64_t{ -1 });
+        entries[item.key()] = entry;
+    }
+    return true;
+}
+
+bool SpoolManager::SaveIndex() const
+{
+    nlohmann::json files = nlohmann::json::object();
+    for (const auto& [path, entry] : entries)
+    {
+        files[path] = {
+            {"bytes", entry.bytes},
+            {"firstSeen", entry.firstSeen},
+            {"lastModified", entry.lastModified},
+            {"activity", entry.activity},
+        };
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(indexPath).parent_path(), ec);
+    std::string tempPath = indexPath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::trunc);
+        if (!out.is_open())
+        {
+            std::cerr << "[SpoolManager] Cannot write " << tempPath << std::endl;
+            return false;
+        }
+        out << nlohmann::json{ {"files", files} }.dump() << "\n";
+    }
+    std::filesystem::rename(tempPath, indexPath, ec);
+    return !ec;
+}
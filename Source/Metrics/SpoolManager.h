@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Keeps recorded video inside a disk budget while uploads are backed up, so a
+// long outage costs the oldest or quietest footage instead of filling the SD
+// card and stopping the recorder. Only the configured video directories are
+// managed; metric files are never touched. A small JSON index remembers when
+// each file first appeared and how many people were counted while it was
+// recorded.
+//
+// Eviction order once over quota:
+//   1. files with no upload pending (already uploaded, or upload disabled), oldest first
+//   2. files still waiting to upload, lowest activity first, then oldest
+// Files modified within settleTime are assumed to be recording and are kept.
+class SpoolManager
+{
+public:
+    struct Options
+    {
+        uint64_t quotaBytes = 8ull * 1024 * 1024 * 1024;
+        uint64_t minFreeBytes = 512ull * 1024 * 1024; // evict as well when the filesystem runs low
+        std::chrono::seconds scanInterval{ 30 };
+        std::chrono::seconds settleTime{ 300 };
+    };
+
+    // People counted during [from, to), used to rank footage still waiting to upload
+    using ActivityFunc = std::function<uint64_t(std::time_t from, std::time_t to)>;
+
+public:
+    SpoolManager(const SpoolManager&) = delete;
+    SpoolManager& operator=(const SpoolManager&) = delete;
+    static SpoolManager& GetInstance()
+    {
+        static SpoolManager instance;
+        return instance;
+    }
+
+    bool Start(const std::string& indexPath, const std::vector<std::string>& directories);
+    bool Start(const std::string& indexPath, const std::vector<std::string>& directories, const Options& options);
+    void Stop();
+    void SetActivityFunc(ActivityFunc fn);
+
+    // Scan on the spool thread now instead of at the next interval, e.g. right
+    // after a recording was closed.
+    void RequestScan();
+    uint64_t GetSpoolBytes() const { return spoolBytes.load(); }
+
+private:
+    struct Entry
+    {
+        uint64_t bytes = 0;
+        int64_t firstSeen = 0;    // epoch seconds; close to the recording start
+        int64_t lastModified = 0;
+        int64_t activity = -1;    // -1 until the file has settled
+    };
+
+    SpoolManager() = default;
+    ~SpoolManager();
+
+    void SpoolThreadFunc();
+    void Scan();
+    void Evict(uint64_t bytesToFree, std::time_t now);
+    uint64_t FreeBytes() const;
+
+    bool LoadIndex();
+    bool SaveIndex() const;
+
+private:
+    Options options;
+    std::string indexPath;
+    std::vector<std::string> directories;
+
+    std::unordered_map<std::string, Entry> entries; // keyed by path; spool thread only after Start()
+    std::atomic<uint64_t> spoolBytes{ 0 };
+
+    std::mutex activityMutex;
+    ActivityFunc activityFunc;
+
+    std::thread spoolThread;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondVar;
+    bool wakeRequested = false;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> stopRequested{ false };
+};
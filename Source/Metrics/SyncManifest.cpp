@@ -0,0 +1,305 @@
+#include "SyncManifest.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <json.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+// xxHash64 (seed 0), so entries can be checked by hand with xxhsum
+constexpr uint64_t kPrime1 = 11400714785074694791ull;
+constexpr uint64_t kPrime2 = 14029467366897019727ull;
+constexpr uint64_t kPrime3 = 1609587929392839161ull;
+constexpr uint64_t kPrime4 = 9650029242287828579ull;
+constexpr uint64_t kPrime5 = 2870177450012600261ull;
+
+inline uint64_t Rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t Read64(const uint8_t* p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t Read32(const uint8_t* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t Round(uint64_t acc, uint64_t input)
+{
+    acc += input * kPrime2;
+    acc = Rotl(acc, 31);
+    return acc * kPrime1;
+}
+
+inline uint64_t MergeRound(uint64_t acc, uint64_t val)
+{
+    acc ^= Round(0, val);
+    return acc * kPrime1 + kPrime4;
+}
+
+uint64_t XXH64(const uint8_t* p, size_t len)
+{
+    const uint8_t* end = p + len;
+    uint64_t h;
+
+    if (len >= 32)
+    {
+        const uint8_t* limit = end - 32;
+        uint64_t v1 = kPrime1 + kPrime2;
+        uint64_t v2 = kPrime2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - kPrime1;
+        do
+        {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+        h = MergeRound(h, v1);
+        h = MergeRound(h, v2);
+        h = MergeRound(h, v3);
+        h = MergeRound(h, v4);
+    }
+    else
+    {
+        h = kPrime5;
+    }
+
+    h += static_cast<uint64_t>(len);
+
+    while (p + 8 <= end)
+    {
+        h ^= Round(0, Read64(p));
+        h = Rotl(h, 27) * kPrime1 + kPrime4;
+        p += 8;
+    }
+    if (p + 4 <= end)
+    {
+        h ^= static_cast<uint64_t>(Read32(p)) * kPrime1;
+        h = Rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    while (p < end)
+    {
+        h ^= (*p) * kPrime5;
+        h = Rotl(h, 11) * kPrime1;
+        ++p;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+} // namespace
+
+bool SyncManifest::Load(const std::string& path)
+{
+    this->path = path;
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    entries.clear();
+
+    std::ifstream in(path);
+    if (!in.is_open())
+    {
+        return true; // nothing synced yet
+    }
+
+    nlohmann::json json = nlohmann::json::parse(in, nullptr, false);
+    if (json.is_discarded() || !json.contains("files"))
+    {
+        std::cerr << "[SyncManifest] Ignoring unreadable manifest " << path << std::endl;
+        return false;
+    }
+
+    for (const auto& item : json["files"].items())
+    {
+        const auto& value = item.value();
+        Entry entry;
+        entry.size = value.value("size", uint64_t{ 0 });
+        entry.mtimeNs = value.value("mtimeNs", int64_t{ 0 });
+        entry.hash = std::stoull(value.value("hash", std::string("0")), nullptr, 16);
+        entry.remoteId = value.value("remoteId", "");
+        entry.fragmented = value.value("fragmented", false);
+        entries[item.key()] = entry;
+    }
+    return true;
+}
+
+bool SyncManifest::Save() const
+{
+    // Taken first, so the newest entries are also the last ones renamed into place
+    std::lock_guard<std::mutex> saveLock(saveMutex);
+    nlohmann::json files = nlohmann::json::object();
+    {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+        for (const auto& [file, entry] : entries)
+        {
+            char hash[17];
+            std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(entry.hash));
+            files[file] = {
+                {"size", entry.size},
+                {"mtimeNs", entry.mtimeNs},
+                {"hash", hash},
+                {"remoteId", entry.remoteId},
+            };
+            if (entry.fragmented)
+            {
+                files[file]["fragmented"] = true;
+            }
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    // Unique per save, so a writer in another process cannot interleave with this one
+    static std::atomic<uint64_t> saveCount{ 0 };
+    std::string tempPath = path + ".tmp." + std::to_string(::getpid()) + "." + std::to_string(saveCount.fetch_add(1));
+    {
+        std::ofstream out(tempPath, std::ios::trunc);
+        if (!out.is_open())
+        {
+            std::cerr << "[SyncManifest] Cannot write " << tempPath << std::endl;
+            return false;
+        }
+        out << std::setw(4) << nlohmann::json{ {"files", files} } << std::endl;
+    }
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec)
+    {
+        std::cerr << "[SyncManifest] Cannot replace " << path << ": " << ec.message() << std::endl;
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool SyncManifest::Stat(const std::string& file, Entry& entry)
+{
+    struct stat st{};
+    if (::stat(file.c_str(), &st) != 0)
+    {
+        return false;
+    }
+    entry.size = static_cast<uint64_t>(st.st_size);
+    entry.mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+bool SyncManifest::Describe(const std::string& file, Entry& entry)
+{
+    return Stat(file, entry) && HashFile(file, entry.hash);
+}
+
+bool SyncManifest::IsUnchanged(const std::string& file, Entry* current, Entry* previous)
+{
+    Entry now;
+    if (!Stat(file, now))
+    {
+        return false;
+    }
+
+    Entry recorded;
+    bool known = false;
+    {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+        auto it = entries.find(file);
+        if (it != entries.end())
+        {
+            recorded = it->second;
+            known = true;
+        }
+    }
+    if (previous)
+    {
+        *previous = known ? recorded : Entry{};
+    }
+
+    if (known && recorded.size == now.size && recorded.mtimeNs == now.mtimeNs && !recorded.remoteId.empty())
+    {
+        return true;
+    }
+
+    if (!HashFile(file, now.hash))
+    {
+        return false;
+    }
+    if (known && recorded.size == now.size && recorded.hash == now.hash && !recorded.remoteId.empty())
+    {
+        // Touched but not modified: remember the new mtime so we skip hashing next time
+        now.remoteId = recorded.remoteId;
+        Record(file, now);
+        return true;
+    }
+
+    if (current)
+    {
+        *current = now;
+    }
+    return false;
+}
+
+void SyncManifest::Record(const std::string& file, const Entry& entry)
+{
+    std::lock_guard<std::mutex> lock(entriesMutex);
+    entries[file] = entry;
+}
+
+bool SyncManifest::HashFile(const std::string& file, uint64_t& hash)
+{
+    int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0)
+    {
+        ::close(fd);
+        hash = XXH64(nullptr, 0);
+        return true;
+    }
+
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        std::cerr << "[SyncManifest] Cannot map " << file << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    hash = XXH64(static_cast<const uint8_t*>(mapped), size);
+    munmap(mapped, size);
+    return true;
+}
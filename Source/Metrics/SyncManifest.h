@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Remembers which local files have already been uploaded, so a sync only
+// sends files that are new or whose content changed. Each entry keeps the
+// size, modification time and xxHash64 of the uploaded content together with
+// the id of the remote document / GridFS file. The hash is only recomputed
+// when size or mtime differ from the recorded values.
+//
+// Everything that uploads shares GetInstance(), so no uploader overwrites
+// entries another one recorded; Save() may be called from any thread.
+class SyncManifest
+{
+public:
+    static constexpr const char* kDefaultPath = "build/Data/sync_manifest.json";
+
+    struct Entry
+    {
+        uint64_t size = 0;
+        int64_t mtimeNs = 0;
+        uint64_t hash = 0;
+        std::string remoteId; // ObjectId hex of the uploaded document or GridFS file
+        // Uploaded as parts while recording; remoteId is then the VideoManifests
+        // document, not a GridFS file
+        bool fragmented = false;
+    };
+
+public:
+    SyncManifest() = default;
+    SyncManifest(const SyncManifest&) = delete;
+    SyncManifest& operator=(const SyncManifest&) = delete;
+    // The manifest at kDefaultPath, loaded on first use
+    static SyncManifest& GetInstance()
+    {
+        static SyncManifest instance(kDefaultPath);
+        return instance;
+    }
+
+    bool Load(const std::string& path = kDefaultPath);
+    bool Save() const;
+
+    // True if file was uploaded before and its content has not changed since.
+    // Otherwise fills current (when given) with the file's present state, ready
+    // for Record() once the upload succeeds, and previous with the old entry.
+    bool IsUnchanged(const std::string& file, Entry* current = nullptr, Entry* previous = nullptr);
+    void Record(const std::string& file, const Entry& entry);
+    // Stat and hash file, for recording an upload that did not go through IsUnchanged()
+    static bool Describe(const std::string& file, Entry& entry);
+
+    static bool HashFile(const std::string& file, uint64_t& hash);
+
+private:
+    explicit SyncManifest(const std::string& path) { Load(path); }
+    static bool Stat(const std::string& file, Entry& entry);
+
+private:
+    std::string path;
+    // Serializes whole saves; each also writes its own temp file
+    mutable std::mutex saveMutex;
+    mutable std::mutex entriesMutex;
+    std::unordered_map<std::string, Entry> entries; // keyed by file path
+};
@@ -0,0 +1,531 @@
+#include "UploadQueue.h"
+#include "BucketRing.h"
+#include "MongoLink.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <json.hpp>
+#include <random>
+#include <unordered_map>
+
+namespace
+{
+const char* JobTypeName(UploadQueue::JobType type)
+{
+    switch (type)
+    {
+    case UploadQueue::JobType::Metric:
+        return "metric";
+    case UploadQueue::JobType::VideoPart:
+        return "videoPart";
+    case UploadQueue::JobType::HourlyBuckets:
+        return "hourly";
+    default:
+        return "video";
+    }
+}
+
+UploadQueue::JobType JobTypeFromName(const std::string& name)
+{
+    if (name == "metric")
+    {
+        return UploadQueue::JobType::Metric;
+    }
+    if (name == "hourly")
+    {
+        return UploadQueue::JobType::HourlyBuckets;
+    }
+    return name == "videoPart" ? UploadQueue::JobType::VideoPart : UploadQueue::JobType::Video;
+}
+} // namespace
+
+UploadQueue::~UploadQueue()
+{
+    Stop();
+}
+
+bool UploadQueue::Start(const std::string& journalPath)
+{
+    return Start(journalPath, Options{});
+}
+
+bool UploadQueue::Start(const std::string& journalPath, const Options& options)
+{
+    if (running.load())
+    {
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        this->options = options;
+        this->options.workerCount = std::max(1, options.workerCount);
+        this->journalPath = journalPath;
+
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(journalPath).parent_path(), ec);
+        if (!LoadJournal() || !RewriteJournal())
+        {
+            return false;
+        }
+    }
+    // Throttle the video bytes actually sent rather than job starts, so a large
+    // video neither blocks the small metric jobs queued behind it nor bursts.
+    MongoLink::GetInstance().SetMaxVideoUploadRate(this->options.maxBytesPerSecond);
+    stopRequested.store(false);
+    running.store(true);
+    for (int i = 0; i < this->options.workerCount; ++i)
+    {
+        workers.emplace_back(&UploadQueue::WorkerThreadFunc, this);
+    }
+
+    std::cout << "[UploadQueue] Started with " << GetPendingCount() << " pending job(s)" << std::endl;
+    return true;
+}
+
+void UploadQueue::Stop()
+{
+    if (!running.load())
+    {
+        return;
+    }
+
+    stopRequested.store(true);
+    jobsCondVar.notify_all();
+    for (std::thread& worker : workers)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+    workers.clear();
+
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    journal.close();
+    running.store(false);
+}
+
+bool UploadQueue::WaitIdle(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(jobsMutex);
+    return jobsCondVar.wait_for(lock, timeout, [this] { return jobs.empty() && inFlightJobs == 0; });
+}
+
+size_t UploadQueue::GetPendingCount() const
+{
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    return jobs.size() + inFlightJobs;
+}
+
+bool UploadQueue::EnqueueVideo(const std::string& videoPath, const std::string& videoName)
+{
+    Job job;
+    job.type = JobType::Video;
+    job.path = videoPath;
+    job.name = videoName;
+    std::error_code ec;
+    job.bytes = std::filesystem::file_size(videoPath, ec);
+    return Enqueue(std::move(job));
+}
+
+bool UploadQueue::EnqueueVideoPart(const std::string& videoPath, const std::string& videoName, int partIndex,
+                                   uint64_t offset, uint64_t length, bool lastPart)
+{
+    Job job;
+    job.type = JobType::VideoPart;
+    job.path = videoPath;
+    job.name = videoName;
+    job.bytes = length;
+    job.partIndex = partIndex;
+    job.offset = offset;
+    job.lastPart = lastPart;
+    return Enqueue(std::move(job));
+}
+
+bool UploadQueue::EnqueueMetric(const std::string& jsonPath, bsoncxx::document::value document)
+{
+    Job job;
+    job.type = JobType::Metric;
+    job.path = jsonPath;
+    job.name = std::filesystem::path(jsonPath).filename().string();
+    job.bytes = document.view().length();
+    job.document = std::make_shared<bsoncxx::document::value>(std::move(document));
+    return Enqueue(std::move(job));
+}
+
+bool UploadQueue::EnqueueHourlyBuckets(const std::string& ringPath, const std::string& deviceId, std::time_t hourStart)
+{
+    Job job;
+    job.type = JobType::HourlyBuckets;
+    job.path = ringPath;
+    job.name = deviceId;
+    job.hourStart = static_cast<int64_t>(hourStart);
+    return Enqueue(std::move(job));
+}
+
+bool UploadQueue::Enqueue(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        job.id = nextJobId++;
+        job.notBefore = std::chrono::steady_clock::now();
+
+        // Jobs queued before Start() are kept in memory and journaled when it runs
+        if (journal.is_open())
+        {
+            AppendJournal(JournalEntry(job));
+        }
+
+        ++pendingPaths[job.path];
+        std::cout << "[UploadQueue] Queued " << JobTypeName(job.type) << " " << job.path;
+        if (job.type == JobType::VideoPart)
+        {
+            std::cout << " part " << job.partIndex << " (" << job.bytes << " bytes)";
+        }
+        std::cout << std::endl;
+        jobs.push_back(std::move(job));
+    }
+    jobsCondVar.notify_one();
+    return true;
+}
+
+void UploadQueue::WorkerThreadFunc()
+{
+    for (;;)
+    {
+        std::optional<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(jobsMutex);
+            job = TakeReadyJob(lock);
+        }
+        if (!job)
+        {
+            return;
+        }
+        bool success = RunJob(*job);
+        FinishJob(std::move(*job), success);
+    }
+}
+
+std::optional<UploadQueue::Job> UploadQueue::TakeReadyJob(std::unique_lock<std::mutex>& lock)
+{
+    while (!stopRequested.load())
+    {
+        auto now = std::chrono::steady_clock::now();
+        auto wakeAt = std::chrono::steady_clock::time_point::max();
+        for (auto it = jobs.begin(); it != jobs.end(); ++it)
+        {
+            if (it->notBefore > now)
+            {
+                wakeAt = std::min(wakeAt, it->notBefore);
+                continue;
+            }
+            // Stay within the byte budget, but never starve a job that is larger than it
+            if (inFlightJobs > 0 && inFlightBytes + it->bytes > options.maxInFlightBytes)
+            {
+                continue;
+            }
+
+            Job job = std::move(*it);
+            jobs.erase(it);
+            inFlightBytes += job.bytes;
+            ++inFlightJobs;
+            return job;
+        }
+
+        if (wakeAt == std::chrono::steady_clock::time_point::max())
+        {
+            jobsCondVar.wait(lock);
+        }
+        else
+        {
+            jobsCondVar.wait_until(lock, wakeAt);
+        }
+    }
+    return std::nullopt;
+}
+
+bool UploadQueue::IsPending(const std::string& path) const
+{
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    return pendingPaths.count(path) > 0;
+}
+
+bool UploadQueue::RunJob(const Job& job)
+{
+    MongoLink& mongo = MongoLink::GetInstance();
+    // Whole files already uploaded, so a replayed or repeated job is skipped
+    SyncManifest& manifest = SyncManifest::GetInstance();
+    if (job.type == JobType::VideoPart)
+    {
+        std::string remoteId;
+        if (!mongo.UploadVideoPart(job.path, job.name, job.partIndex, job.offset, job.bytes, job.lastPart,
+                                   job.lastPart ? &remoteId : nullptr))
+        {
+            return false;
+        }
+        // The recording is complete and uploaded; a later full sync must not send it again
+        SyncManifest::Entry entry;
+        if (job.lastPart && !remoteId.empty() && SyncManifest::Describe(job.path, entry))
+        {
+            entry.remoteId = remoteId;
+            entry.fragmented = true;
+            manifest.Record(job.path, entry);
+            manifest.Save();
+        }
+        return true;
+    }
+    if (job.type == JobType::HourlyBuckets)
+    {
+        BucketRing ring;
+        if (!ring.Open(job.path, 60, 1, true))
+        {
+            return false;
+        }
+        std::time_t hourStart = static_cast<std::time_t>(job.hourStart);
+        std::vector<BucketRing::BucketView> buckets;
+        ring.ForEachBucket(hourStart, hourStart + 3600, [&](const BucketRing::BucketView& view)
+        {
+            buckets.push_back(view);
+        });
+        return mongo.UploadHourlyBuckets(job.name, hourStart, ring.GetBucketSeconds(), buckets);
+    }
+
+    SyncManifest::Entry current, previous;
+    if (manifest.IsUnchanged(job.path, &current, &previous))
+    {
+        std::cout << "[UploadQueue] Skipping unchanged " << job.path << std::endl;
+        return true;
+    }
+
+    std::string remoteId;
+    bool success;
+    if (job.type == JobType::Metric)
+    {
+        if (!previous.remoteId.empty())
+        {
+            // The day's file grew since its last upload: replace that document
+            std::vector<std::string> remoteIds{ previous.remoteId };
+            success = mongo.UploadMetricFiles({ job.path }, remoteIds);
+            remoteId = remoteIds.front();
+        }
+        else if (job.document)
+        {
+            success = mongo.UploadMetricDocument(job.document->view(), &remoteId);
+        }
+        else
+        {
+            success = mongo.UploadMetric(job.path, &remoteId);
+        }
+    }
+    else
+    {
+        success = mongo.UploadVideo(job.path, job.name, &remoteId);
+        // A fragmented upload's parts are kept; its id is not a GridFS file
+        if (success && !previous.remoteId.empty() && !previous.fragmented && previous.remoteId != remoteId)
+        {
+            mongo.DeleteVideo(previous.remoteId);
+        }
+    }
+
+    // current stays empty if the file could not be read before the upload
+    if (success && !remoteId.empty() && current.mtimeNs != 0)
+    {
+        current.remoteId = remoteId;
+        manifest.Record(job.path, current);
+        manifest.Save();
+    }
+    return success;
+}
+
+void UploadQueue::FinishJob(Job job, bool success)
+{
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    inFlightBytes -= std::min(inFlightBytes, job.bytes);
+    --inFlightJobs;
+
+    // A file that disappeared will never upload; drop the job instead of retrying forever
+    bool missing = !success && !job.document && !std::filesystem::exists(job.path);
+    if (success || missing)
+    {
+        auto pendingIt = pendingPaths.find(job.path);
+        if (pendingIt != pendingPaths.end() && --pendingIt->second <= 0)
+        {
+            pendingPaths.erase(pendingIt);
+        }
+        if (success && lastUploadFailed)
+        {
+            // The link is back: retry everything now rather than when each backoff
+            // expires; the rate limit keeps the backlog from flooding the uplink.
+            lastUploadFailed = false;
+            auto now = std::chrono::steady_clock::now();
+            for (auto& queued : jobs)
+            {
+                queued.notBefore = std::min(queued.notBefore, now);
+            }
+        }
+        if (missing)
+        {
+            std::cerr << "[UploadQueue] Dropping " << JobTypeName(job.type) << " job, file is gone: " << job.path << std::endl;
+        }
+        if (journal.is_open())
+        {
+            AppendJournal(nlohmann::json{ {"op", "done"}, {"id", job.id} }.dump());
+        }
+        if (jobs.empty() && inFlightJobs == 0)
+        {
+            RewriteJournal();
+        }
+        jobsCondVar.notify_all();
+        return;
+    }
+
+    // Exponential backoff with jitter, so a flapping link is not hammered
+    lastUploadFailed = true;
+    ++job.attempts;
+    static thread_local std::mt19937 rng{ std::random_device{}() };
+    auto backoff = options.initialBackoff * (1ll << std::min(job.attempts - 1, 16));
+    backoff = std::min<std::chrono::seconds>(backoff, options.maxBackoff);
+    auto jitter = std::chrono::milliseconds(std::uniform_int_distribution<int64_t>(
+        0, std::chrono::duration_cast<std::chrono::milliseconds>(backoff).count() / 4)(rng));
+    job.notBefore = std::chrono::steady_clock::now() + backoff + jitter;
+
+    std::cerr << "[UploadQueue] Upload of " << job.path << " failed (attempt " << job.attempts << "), retrying in "
+              << std::chrono::duration_cast<std::chrono::seconds>(backoff + jitter).count() << "s" << std::endl;
+    jobs.push_back(std::move(job));
+    jobsCondVar.notify_all();
+}
+
+bool UploadQueue::LoadJournal()
+{
+    std::ifstream in(journalPath);
+    if (!in.is_open())
+    {
+        return true; // first run
+    }
+
+    std::unordered_map<uint64_t, Job> pending;
+    std::vector<uint64_t> order;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        nlohmann::json entry = nlohmann::json::parse(line, nullptr, false);
+        if (entry.is_discarded() || !entry.contains("op") || !entry.contains("id"))
+        {
+            continue; // torn tail after a power cut
+        }
+
+        uint64_t id = entry["id"].get<uint64_t>();
+        nextJobId = std::max(nextJobId, id + 1);
+        if (entry["op"] == "done")
+        {
+            pending.erase(id);
+            continue;
+        }
+
+        Job job;
+        job.id = id;
+        job.type = JobTypeFromName(entry.value("type", "video"));
+        job.path = entry.value("path", "");
+        job.name = entry.value("name", "");
+        if (job.type == JobType::VideoPart)
+        {
+            job.partIndex = entry.value("part", 0);
+            job.offset = entry.value("offset", uint64_t{ 0 });
+            job.bytes = entry.value("length", uint64_t{ 0 });
+            job.lastPart = entry.value("last", false);
+        }
+        else if (job.type == JobType::HourlyBuckets)
+        {
+            job.hourStart = entry.value("hour", int64_t{ 0 });
+        }
+        else
+        {
+            std::error_code ec;
+            job.bytes = std::filesystem::file_size(job.path, ec);
+        }
+        if (pending.emplace(id, std::move(job)).second)
+        {
+            order.push_back(id);
+        }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    for (uint64_t id : order)
+    {
+        auto it = pending.find(id);
+        if (it != pending.end())
+        {
+            it->second.notBefore = now;
+            ++pendingPaths[it->second.path];
+            jobs.push_back(std::move(it->second));
+        }
+    }
+    return true;
+}
+
+bool UploadQueue::RewriteJournal()
+{
+    // Compact to just the queued jobs; only called while no upload is running.
+    journal.close();
+    std::string tempPath = journalPath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::trunc);
+        if (!out.is_open())
+        {
+            std::cerr << "[UploadQueue] Cannot write journal " << tempPath << std::endl;
+            return false;
+        }
+        for (const Job& job : jobs)
+        {
+            out << JournalEntry(job) << "\n";
+        }
+        if (inFlightJobs == 0 && jobs.empty())
+        {
+            // Keep ids increasing across restarts
+            out << nlohmann::json{ {"op", "done"}, {"id", nextJobId - 1} }.dump() << "\n";
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, journalPath, ec);
+    if (ec)
+    {
+        std::cerr << "[UploadQueue] Cannot replace journal " << journalPath << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    journal.open(journalPath, std::ios::app);
+    return journal.is_open();
+}
+
+std::string UploadQueue::JournalEntry(const Job& job)
+{
+    nlohmann::json entry = {
+        {"op", "add"},
+        {"id", job.id},
+        {"type", JobTypeName(job.type)},
+        {"path", job.path},
+        {"name", job.name},
+    };
+    if (job.type == JobType::VideoPart)
+    {
+        entry["part"] = job.partIndex;
+        entry["offset"] = job.offset;
+        entry["length"] = job.bytes;
+        entry["last"] = job.lastPart;
+    }
+    else if (job.type == JobType::HourlyBuckets)
+    {
+        entry["hour"] = job.hourStart;
+    }
+    return entry.dump();
+}
+
+void UploadQueue::AppendJournal(const std::string& line)
+{
+    journal << line << "\n";
+    journal.flush();
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include "SyncManifest.h"
+
+#include <bsoncxx/document/value.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Background uploads to MongoLink. Callers only enqueue a job and return;
+// worker threads do the network I/O and retry failures with exponential
+// backoff. Every job is recorded in a JSON-lines journal before Enqueue*()
+// returns, so uploads interrupted by a restart or an offline period resume on
+// the next Start().
+class UploadQueue
+{
+public:
+    enum class JobType
+    {
+        Video,
+        Metric,
+        VideoPart,
+        HourlyBuckets
+    };
+
+    struct Options
+    {
+        // Each worker borrows its own pooled MongoDB client
+        int workerCount = 2;
+        size_t maxInFlightBytes = 64ull * 1024 * 1024; // a larger job still runs, but alone
+        std::chrono::seconds initialBackoff{ 5 };
+        std::chrono::seconds maxBackoff{ 600 };
+        // Cap on video bytes sent per second across all workers, so a backlog drains
+        // without saturating the uplink; metric jobs are not held back. 0 is unlimited
+        uint64_t maxBytesPerSecond = 4ull * 1024 * 1024;
+    };
+
+public:
+    UploadQueue(const UploadQueue&) = delete;
+    UploadQueue& operator=(const UploadQueue&) = delete;
+    static UploadQueue& GetInstance()
+    {
+        static UploadQueue instance;
+        return instance;
+    }
+
+    bool Start(const std::string& journalPath);
+    bool Start(const std::string& journalPath, const Options& options);
+    // Waits for uploads already running; queued jobs stay in the journal.
+    void Stop();
+    bool IsRunning() const { return running.load(); }
+    // Block until nothing is queued or uploading, e.g. before shutting down.
+    bool WaitIdle(std::chrono::milliseconds timeout);
+
+    bool EnqueueVideo(const std::string& videoPath, const std::string& videoName);
+    // One byte range of a recording that may still be growing; see MongoLink::UploadVideoPart
+    bool EnqueueVideoPart(const std::string& videoPath, const std::string& videoName, int partIndex,
+                          uint64_t offset, uint64_t length, bool lastPart);
+    // The document is used for the first attempt; after a restart the job
+    // falls back to uploading the JSON file at jsonPath.
+    bool EnqueueMetric(const std::string& jsonPath, bsoncxx::document::value document);
+    // One hour of the per-minute bucket ring at ringPath; the ring is read when
+    // the job runs, so a retry always sends the latest counts.
+    bool EnqueueHourlyBuckets(const std::string& ringPath, const std::string& deviceId, std::time_t hourStart);
+
+    size_t GetPendingCount() const;
+    // True while a job for path is queued or uploading
+    bool IsPending(const std::string& path) const;
+
+private:
+    struct Job
+    {
+        uint64_t id = 0;
+        JobType type = JobType::Video;
+        std::string path;
+        std::string name;
+        uint64_t bytes = 0;
+        // VideoPart only
+        int partIndex = 0;
+        uint64_t offset = 0;
+        bool lastPart = false;
+        // HourlyBuckets only
+        int64_t hourStart = 0;
+        int attempts = 0;
+        std::chrono::steady_clock::time_point notBefore;
+        std::shared_ptr<bsoncxx::document::value> document;
+    };
+
+    UploadQueue() = default;
+    ~UploadQueue();
+
+    bool Enqueue(Job job);
+    void WorkerThreadFunc();
+    std::optional<Job> TakeReadyJob(std::unique_lock<std::mutex>& lock);
+    bool RunJob(const Job& job);
+    void FinishJob(Job job, bool success);
+
+    bool LoadJournal();
+    bool RewriteJournal();
+    void AppendJournal(const std::string& line);
+    static std::string JournalEntry(const Job& job);
+
+private:
+    Options options;
+    std::string journalPath;
+    std::ofstream journal;
+
+    mutable std::mutex jobsMutex;
+    std::condition_variable jobsCondVar;
+    std::deque<Job> jobs;
+    uint64_t nextJobId = 1;
+    uint64_t inFlightBytes = 0;
+    size_t inFlightJobs = 0;
+    std::unordered_map<std::string, int> pendingPaths; // jobs per file, queued or in flight
+    bool lastUploadFailed = false;
+
+    std::vector<std::thread> workers;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> stopRequested{ false };
+};
@@ -0,0 +1,196 @@
+#include "Utility/RingQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Hands items from producer threads to consumer threads through
+//   mutex  the mutex + deque + condition variable design BoundedQueue had
+//   spsc   SpscRing (one producer, one consumer only)
+//   mpmc   MpmcRing
+// Items are move-only, as audio chunks and frames are. Consumers block with a
+// timeout when the queue is empty and producers spin on a full ring, so the
+// numbers include the sleeping/wake-up path. Every item is checked to arrive
+// exactly once.
+// Usage: RingQueueBench [items] [producers] [consumers] [capacity]
+namespace
+{
+// Move-only like the real payloads, but without a heap allocation per item so
+// the allocator does not dominate the timings
+struct Item
+{
+    uint64_t value = 0;
+
+    Item() = default;
+    explicit Item(uint64_t value) : value(value) {}
+    Item(Item&& other) noexcept : value(other.value) {}
+    Item& operator=(Item&& other) noexcept
+    {
+        value = other.value;
+        return *this;
+    }
+    Item(const Item&) = delete;
+    Item& operator=(const Item&) = delete;
+};
+
+class MutexQueue
+{
+public:
+    explicit MutexQueue(size_t capacity) : capacity(capacity) {}
+
+    bool push(Item&& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (queue.size() >= capacity)
+        {
+            return false;
+        }
+        queue.push_back(std::move(item));
+        condVar.notify_one();
+        return true;
+    }
+
+    bool pop(Item& out, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!condVar.wait_for(lock, timeout, [this] { return closed || !queue.empty(); }) || queue.empty())
+        {
+            return false;
+        }
+        out = std::move(queue.front());
+        queue.pop_front();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        condVar.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable condVar;
+    std::deque<Item> queue;
+    size_t capacity;
+    bool closed = false;
+};
+
+struct RingAdapter
+{
+    template<typename Ring>
+    static bool push(Ring& ring, Item&& item) { return ring.tryPush(std::move(item)); }
+    template<typename Ring>
+    static bool pop(Ring& ring, Item& out, std::chrono::milliseconds timeout) { return ring.popWait(out, timeout); }
+};
+
+struct MutexAdapter
+{
+    static bool push(MutexQueue& queue, Item&& item) { return queue.push(std::move(item)); }
+    static bool pop(MutexQueue& queue, Item& out, std::chrono::milliseconds timeout) { return queue.pop(out, timeout); }
+};
+
+template<typename Adapter, typename Queue>
+bool Run(const std::string& name, Queue& queue, uint64_t items, int producers, int consumers)
+{
+    std::atomic<uint64_t> received{ 0 };
+    std::atomic<uint64_t> sum{ 0 };
+    std::atomic<uint64_t> fullSpins{ 0 };
+    std::atomic<int> producersLeft{ producers };
+    std::vector<std::thread> threads;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int c = 0; c < consumers; ++c)
+    {
+        threads.emplace_back([&]
+        {
+            Item item;
+            uint64_t localSum = 0, localCount = 0;
+            while (true)
+            {
+                if (Adapter::pop(queue, item, std::chrono::milliseconds(10)))
+                {
+                    localSum += item.value;
+                    ++localCount;
+                }
+                else if (producersLeft.load() == 0)
+                {
+                    break;
+                }
+            }
+            sum.fetch_add(localSum);
+            received.fetch_add(localCount);
+        });
+    }
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]
+        {
+            uint64_t spins = 0;
+            for (uint64_t i = p; i < items; i += producers)
+            {
+                Item item(i);
+                while (!Adapter::push(queue, std::move(item)))
+                {
+                    ++spins;
+                    std::this_thread::yield();
+                }
+            }
+            fullSpins.fetch_add(spins);
+            if (producersLeft.fetch_sub(1) == 1)
+            {
+                queue.close();
+            }
+        });
+    }
+    for (std::thread& t : threads)
+    {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    const uint64_t expectedSum = items * (items - 1) / 2;
+    bool ok = received.load() == items && sum.load() == expectedSum;
+    std::cout << std::fixed << std::setprecision(1) << std::setw(6) << name << ": "
+              << items / seconds / 1e6 << " M items/s, " << seconds * 1e9 / items << " ns/item, "
+              << fullSpins.load() << " full retries" << (ok ? "" : "  MISMATCH") << std::endl;
+    return ok;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint64_t items = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    int producers = argc > 2 ? std::atoi(argv[2]) : 1;
+    int consumers = argc > 3 ? std::atoi(argv[3]) : 1;
+    size_t capacity = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 1024;
+
+    std::cout << items << " items, " << producers << " producer(s), " << consumers << " consumer(s), capacity "
+              << capacity << "\n";
+    bool ok = true;
+    {
+        MutexQueue queue(capacity);
+        ok = Run<MutexAdapter>("mutex", queue, items, producers, consumers) && ok;
+    }
+    if (producers == 1 && consumers == 1)
+    {
+        SpscRing<Item> ring(capacity);
+        ok = Run<RingAdapter>("spsc", ring, items, producers, consumers) && ok;
+    }
+    {
+        MpmcRing<Item> ring(capacity);
+        ok = Run<RingAdapter>("mpmc", ring, items, producers, consumers) && ok;
+        auto counters = ring.getCounters();
+        std::cout << "        mpmc high water " << counters.highWater << " of " << ring.capacity() << "\n";
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,380 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+enum class RingMode
+{
+    Spsc, // one producer thread, one consumer thread
+    Mpmc  // any number of each
+};
+
+// Fixed-capacity lock-free queue. Every slot carries a sequence number saying
+// whose turn it is (D. Vyukov's bounded MPMC queue), so pushes and pops never
+// take a lock and never allocate: items are move-constructed into the ring and
+// moved out again.
+//
+// Policies, chosen per call:
+//   tryPush         fail when full (counted as a drop)
+//   pushDropOldest  discard the oldest item to make room
+//   pushWait        block until there is room, the timeout passes or close()
+//   tryPop / popBatch / popWait / popBatchWait likewise on the consumer side
+// Blocking only sleeps on a condition variable when the ring is full/empty;
+// the fast path checks an atomic sleeper count and skips the mutex.
+//
+// Spsc claims producer positions with a plain store. Consumer positions are
+// always claimed with a compare-exchange, because pushDropOldest lets the
+// producer pop as well; uncontended, that costs about the same as a store.
+template<typename T, RingMode Mode>
+class RingQueue
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Counters
+    {
+        uint64_t pushed = 0;
+        uint64_t popped = 0;
+        uint64_t dropped = 0;   // rejected by tryPush or discarded by pushDropOldest
+        size_t highWater = 0;   // most items queued at once
+    };
+
+public:
+    // Capacity is rounded up to a power of two
+    explicit RingQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        mask = size - 1;
+        slots = std::make_unique<Slot[]>(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~RingQueue()
+    {
+        while (consume([](T&&) {}))
+        {
+        }
+    }
+
+    RingQueue(const RingQueue&) = delete;
+    RingQueue& operator=(const RingQueue&) = delete;
+
+    size_t capacity() const { return mask + 1; }
+
+    // Approximate while other threads are pushing or popping
+    size_t size() const
+    {
+        size_t tail = enqueuePos.load(std::memory_order_acquire);
+        size_t head = dequeuePos.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+    bool empty() const { return size() == 0; }
+
+    // Producer side. item is only moved from when it was queued.
+    bool tryPush(T&& item)
+    {
+        if (closed.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+        if (!enqueue(item))
+        {
+            produced.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        wakeWaiters();
+        return true;
+    }
+
+    bool pushDropOldest(T&& item)
+    {
+        if (closed.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+        while (!enqueue(item))
+        {
+            if (closed.load(std::memory_order_relaxed))
+            {
+                return false;
+            }
+            if (consume([](T&&) {}))
+            {
+                produced.dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                // A consumer has claimed the oldest slot but not released it yet
+                std::this_thread::yield();
+            }
+        }
+        wakeWaiters();
+        return true;
+    }
+
+    bool pushWait(T&& item, std::chrono::milliseconds timeout)
+    {
+        bool pushed = waitUntil([&] { return !closed.load(std::memory_order_relaxed) && enqueue(item); },
+                                Clock::now() + timeout);
+        if (pushed)
+        {
+            wakeWaiters();
+        }
+        return pushed;
+    }
+
+    // Consumer side
+    bool tryPop(T& out)
+    {
+        if (!consume([&out](T&& item) { out = std::move(item); }))
+        {
+            return false;
+        }
+        wakeWaiters();
+        return true;
+    }
+
+    // Appends up to maxItems to out; returns how many
+    size_t popBatch(std::vector<T>& out, size_t maxItems)
+    {
+        size_t count = 0;
+        while (count < maxItems && consume([&out](T&& item) { out.push_back(std::move(item)); }))
+        {
+            ++count;
+        }
+        if (count > 0)
+        {
+            wakeWaiters();
+        }
+        return count;
+    }
+
+    // False on timeout, or once closed and drained
+    bool popWait(T& out, std::chrono::milliseconds timeout)
+    {
+        bool popped = waitUntil([&] { return consume([&out](T&& item) { out = std::move(item); }); },
+                                Clock::now() + timeout);
+        if (popped)
+        {
+            wakeWaiters();
+        }
+        return popped;
+    }
+
+    size_t popBatchWait(std::vector<T>& out, size_t maxItems, std::chrono::milliseconds timeout)
+    {
+        if (maxItems == 0)
+        {
+            return 0;
+        }
+        size_t count = 0;
+        if (waitUntil([&] { return consume([&out](T&& item) { out.push_back(std::move(item)); }); },
+                      Clock::now() + timeout))
+        {
+            count = 1 + popBatch(out, maxItems - 1);
+            if (count == 1)
+            {
+                wakeWaiters();
+            }
+        }
+        return count;
+    }
+
+    // Pushes fail from now on; pops drain what is left. Wakes every waiter.
+    void close()
+    {
+        closed.store(true);
+        std::lock_guard<std::mutex> lk(sleepMutex);
+        sleepCondVar.notify_all();
+    }
+    bool isClosed() const { return closed.load(); }
+
+    Counters getCounters() const
+    {
+        Counters c;
+        c.pushed = produced.pushed.load(std::memory_order_relaxed);
+        c.popped = consumed.popped.load(std::memory_order_relaxed);
+        c.dropped = produced.dropped.load(std::memory_order_relaxed);
+        c.highWater = produced.highWater.load(std::memory_order_relaxed);
+        return c;
+    }
+
+private:
+    static constexpr size_t CacheLine = 64;
+
+    struct alignas(CacheLine) Slot
+    {
+        std::atomic<size_t> sequence{ 0 };
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    bool enqueue(T& item)
+    {
+        Slot* slot = nullptr;
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            slot = &slots[pos & mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if constexpr (Mode == RingMode::Spsc)
+                {
+                    enqueuePos.store(pos + 1, std::memory_order_relaxed);
+                    break;
+                }
+                else if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (slot->storage) T(std::move(item));
+        slot->sequence.store(pos + 1, std::memory_order_release);
+
+        produced.pushed.fetch_add(1, std::memory_order_relaxed);
+        size_t depth = pos + 1 - dequeuePos.load(std::memory_order_relaxed);
+        size_t high = produced.highWater.load(std::memory_order_relaxed);
+        while (depth > high && depth <= capacity() &&
+               !produced.highWater.compare_exchange_weak(high, depth, std::memory_order_relaxed))
+        {
+        }
+        return true;
+    }
+
+    template<typename Sink>
+    bool consume(Sink&& sink)
+    {
+        Slot* slot = nullptr;
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            slot = &slots[pos & mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // empty
+            }
+            else
+            {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        T* item = std::launder(reinterpret_cast<T*>(slot->storage));
+        sink(std::move(*item));
+        item->~T();
+        slot->sequence.store(pos + mask + 1, std::memory_order_release);
+        consumed.popped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // op() retries the push/pop. The sleeper count is raised before retrying
+    // and read by wakeWaiters() after publishing, with a full fence on both
+    // sides, so a waiter either sees the change or gets notified.
+    template<typename Op>
+    bool waitUntil(Op&& op, Clock::time_point deadline)
+    {
+        if (op())
+        {
+            return true;
+        }
+        std::unique_lock<std::mutex> lk(sleepMutex);
+        while (true)
+        {
+            sleepers.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (op())
+            {
+                sleepers.fetch_sub(1);
+                return true;
+            }
+            if (closed.load())
+            {
+                sleepers.fetch_sub(1);
+                return false;
+            }
+            bool timedOut = sleepCondVar.wait_until(lk, deadline) == std::cv_status::timeout;
+            sleepers.fetch_sub(1);
+            if (timedOut)
+            {
+                return op();
+            }
+        }
+    }
+
+    void wakeWaiters()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0)
+        {
+            std::lock_guard<std::mutex> lk(sleepMutex);
+            sleepCondVar.notify_all();
+        }
+    }
+
+private:
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+
+    // Producers and consumers each get their own cache line, counters included
+    struct alignas(CacheLine) ProducerSide
+    {
+        std::atomic<uint64_t> pushed{ 0 };
+        std::atomic<uint64_t> dropped{ 0 };
+        std::atomic<size_t> highWater{ 0 };
+    };
+    struct alignas(CacheLine) ConsumerSide
+    {
+        std::atomic<uint64_t> popped{ 0 };
+    };
+    alignas(CacheLine) std::atomic<size_t> enqueuePos{ 0 };
+    ProducerSide produced;
+    alignas(CacheLine) std::atomic<size_t> dequeuePos{ 0 };
+    ConsumerSide consumed;
+
+    alignas(CacheLine) std::atomic<bool> closed{ false };
+    std::atomic<int> sleepers{ 0 };
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondVar;
+};
+
+template<typename T>
+using SpscRing = RingQueue<T, RingMode::Spsc>;
+
+template<typename T>
+using MpmcRing = RingQueue<T, RingMode::Mpmc>;
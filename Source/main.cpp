@@ -1,19 +1,38 @@
+#include "Camera/FragmentUploader.h"
 #include "Camera/GStreamer.h"
 #include "Hardware/Pinboard.h"
 #include "ImageRec/YoloModel.h"
+#include "Metrics/CountingEngine.h"
+#include "Metrics/LiveStatsServer.h"
 #include "Metrics/MetricTracker.h"
+#include "Metrics/MongoLink.h"
+#include "Metrics/SpoolManager.h"
+#include "Metrics/UploadQueue.h"
 
 #include <atomic>
+#include <chrono>
+#include <filesystem>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
 
-int main()
+int main(int argc, char** argv)
 {
     try
     {
 #pragma region Setup
         bool uploadToMongoDB = false;
+        // --event-clips keeps video only around people (with pre/post-roll)
+        // instead of all day; off by default so continuous recording is kept
+        bool recordEventClips = false;
+        for (int i = 1; i < argc; ++i)
+        {
+            if (std::string(argv[i]) == "--event-clips")
+            {
+                recordEventClips = true;
+            }
+        }
 #ifndef NDEBUG
         uploadToMongoDB = true;
 
@@ -23,7 +42,8 @@ int main()
         int pushCount = 0;
 #endif
 
-        int W = 640, H = 480, FPS = 30;
+        // Recording resolution; inference gets its own stream scaled to the model input
+        int W = 1280, H = 720, FPS = 30;
 
         // Initialize ONNX Classifier
         std::string modelPath = "build/Assets/onnx/yolov5n-sim.onnx";
@@ -38,6 +58,7 @@ int main()
         }
 
         std::unique_ptr<GStreamer> gst = std::make_unique<GStreamer>();
+        gst->setInferenceSize(model->getInputSize());
         if (!gst->openCapture(GStreamer::CaptureBackend::LIBCAMERA, W, H, FPS))
         {
             std::cerr
@@ -48,11 +69,78 @@ int main()
                 return 1;
             }
         }
+        // Connects in the background; nothing below waits for the network
+        MongoLink::GetInstance().ConnectAsync();
+        // Uploads run on background workers; unfinished ones resume from the journal
+        UploadQueue::GetInstance().Start("build/Data/Uploads/queue.journal");
+        FragmentUploader::resumePending();
+        // Keep recordings within a disk budget while uploads are backed up
+        SpoolManager::GetInstance().Start("build/Data/Uploads/spool.json", {"build/Data/Videos", "build/Data/Videos/Clips"});
+
+        if (recordEventClips)
+        {
+            gst->setEventClips(true);
+        }
+        else if (uploadToMongoDB)
+        {
+            // Upload 2 s fMP4 fragments as they are written instead of a whole hour at rollover
+            gst->setFragmentedRecording(2000);
+        }
+        // Runs on the capture bus thread whenever a recording file is finished
+        gst->setSegmentCallback([uploadToMongoDB](const std::string &path, bool uploadedWhileRecording)
+        {
+            if (uploadToMongoDB && !uploadedWhileRecording)
+            {
+                // Hand the finished file to the upload workers; never upload on the capture thread
+                UploadQueue::GetInstance().EnqueueVideo(path, std::filesystem::path(path).filename().string());
+                // An event clip's sidecar lists the people it shows; send it alongside
+                std::filesystem::path sidecar = std::filesystem::path(path).replace_extension(".json");
+                std::error_code ec;
+                if (std::filesystem::exists(sidecar, ec))
+                {
+                    UploadQueue::GetInstance().EnqueueVideo(sidecar.string(), sidecar.filename().string());
+                }
+            }
+            SpoolManager::GetInstance().RequestScan();
+        });
         gst->startRecordingDateTime();
 
         std::unique_ptr<MetricTracker> metricTracker = std::make_unique<MetricTracker>();
+        if (metricTracker->OpenBucketRing("build/Data/Buckets/minutes.ring"))
+        {
+            metricTracker->RestoreFromBuckets();
+
+            // Rank footage still waiting to upload by how many people it shows
+            auto activityRing = std::make_shared<BucketRing>();
+            if (activityRing->Open("build/Data/Buckets/minutes.ring", 60, 1, true))
+            {
+                SpoolManager::GetInstance().SetActivityFunc([activityRing](std::time_t from, std::time_t to)
+                {
+                    MetricData data = activityRing->Rollup(from, to);
+                    return static_cast<uint64_t>(data.enterCount + data.passCount);
+                });
+            }
+        }
+        metricTracker->OpenEventLog("build/Data/Events");
+        if (recordEventClips)
+        {
+            // Link every counted person to the clip that shows them
+            GStreamer *camera = gst.get();
+            metricTracker->SetEventCallback([camera](const MetricEvent &event) { camera->addClipEvent(event); });
+        }
         metricTracker->NewMetric();
 
+        // Without a counting config every confirmed track counts as an entry
+        CountingEngine countingEngine;
+        bool useCountingEngine = countingEngine.LoadConfig("build/Assets/Config/counting.yaml");
+
+        // Live counts for local clients, e.g. curl http://127.0.0.1:8080/stats
+        LiveStatsServer liveStats(*metricTracker);
+        GStreamer *camera = gst.get();
+        liveStats.SetEncoderStatsFunc([camera]() { return camera->encoderStatsJson(); });
+        liveStats.SetCaptureStatsFunc([camera]() { return camera->captureHealthJson(); });
+        liveStats.Start(8080);
+
         float predictionDelay = 500.0f; // milliseconds between predictions
         float currentTime =
             static_cast<float>(cv::getTickCount()) / cv::getTickFrequency() * 1000.0f;
@@ -63,41 +151,100 @@ int main()
 #pragma endregion
 
 #pragma region DetectionThread
-        cv::Mat latestFrame;
+        FrameRef latestFrame; // maps the capture buffer; never written after capture
         std::vector<YoloDetection> latestDetections;
         std::mutex frameMutex, detectionMutex;
         std::atomic<bool> running(true);
 
         auto detectionThread = [&]()
         {
+            uint64_t lastSequence = 0;
             while (running.load())
             {
-                cv::Mat frameCopy;
+                FrameRef frameRef;
                 {
                     std::lock_guard<std::mutex> lock(frameMutex);
-                    if (latestFrame.empty())
-                        continue;
-                    frameCopy = latestFrame.clone();
+                    frameRef = latestFrame;
+                }
+                if (!frameRef)
+                {
+                    // No camera yet, or it is being restarted
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    continue;
+                }
+                if (frameRef->sequence == lastSequence)
+                {
+                    // Already processed; wait for the camera instead of re-running the model
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                    continue;
                 }
+                lastSequence = frameRef->sequence;
 
-                if (!frameCopy.empty())
+                const CameraFrame &frameCopy = *frameRef;
+                if (!frameCopy.image.empty())
                 {
-                    cv::Mat resultFrame;
-                    cv::cvtColor(frameCopy, resultFrame, cv::COLOR_BGR2RGB);
-                    std::vector<YoloDetection> detections = model->detect(resultFrame, 0.3f, 0.5f);
+                    // YUV straight in: the model converts while it scales down
+                    std::vector<YoloDetection> detections = model->detect(frameCopy, 0.3f, 0.5f);
                     {
                         std::lock_guard<std::mutex> lock(detectionMutex);
                         latestDetections = detections;
                     }
+                    // Everything counted from here on is stamped with this frame's capture time
+                    metricTracker->BeginFrame({frameCopy.sequence, frameCopy.captureWallMs, frameCopy.captureTime});
+                    for (const auto &track : model->getStartedTracks())
+                    {
+                        metricTracker->TrackStarted(track.trackId, track.firstSeenMs);
+                    }
+                    for (const auto &track : model->getExpiredTracks())
+                    {
+                        metricTracker->TrackEnded(track.trackId, track.firstSeenMs, track.lastSeenMs);
+                        countingEngine.RemoveTrack(track.trackId, *metricTracker);
+                    }
+                    std::vector<HeatmapRect> heatmapBoxes;
+                    std::vector<LiveTrack> liveTracks;
+                    heatmapBoxes.reserve(detections.size());
+                    liveTracks.reserve(detections.size());
                     for (const auto &det : detections)
                     {
-                        if (det.score < 0.3f)
-                            continue;
+                        if (det.score >= 0.3f && det.trackId >= 0)
+                        {
+                            heatmapBoxes.push_back({det.box.x, det.box.y, det.box.width, det.box.height});
+                            liveTracks.push_back({det.trackId, det.score, det.box.x, det.box.y, det.box.width, det.box.height});
+                        }
+                    }
+                    if (!heatmapBoxes.empty())
+                        gst->markActivity(); // keeps an event clip recording
+                    gst->setSceneActivity(static_cast<int>(heatmapBoxes.size()));
+                    metricTracker->AddDetections(heatmapBoxes, frameCopy.width, frameCopy.height);
+                    liveStats.PublishTracks(std::move(liveTracks), frameCopy.width, frameCopy.height,
+                                            frameCopy.captureWallMs, frameCopy.sequence);
 
-                        if (det.trackId >= 0)
+                    if (useCountingEngine)
+                    {
+                        // Count on the feet: bottom-centre of each box, normalized
+                        std::vector<TrackPoint> points;
+                        points.reserve(heatmapBoxes.size());
+                        for (const auto &det : detections)
                         {
-                            // For this example, consider trackIds >= 0 as "entered"
-                            metricTracker->PersonEntered(det.trackId);
+                            if (det.score >= 0.3f && det.trackId >= 0)
+                                points.push_back({det.trackId,
+                                                  (det.box.x + det.box.width * 0.5f) / frameCopy.width,
+                                                  static_cast<float>(det.box.y + det.box.height) / frameCopy.height});
+                        }
+                        countingEngine.Update(points, *metricTracker);
+                    }
+                    else
+                    {
+                        for (const auto &det : detections)
+                        {
+                            if (det.score < 0.3f)
+                                continue;
+
+                            if (det.trackId >= 0)
+                            {
+                                // For this example, consider trackIds >= 0 as "entered"
+                                metricTracker->PersonEntered(det.trackId);
+                            }
                         }
                     }
                 }
@@ -113,10 +260,12 @@ int main()
 #pragma region MainLoop
         while (true)
         {
-            cv::Mat frame = gst->captureFrame();
+            // nullptr while the camera pipeline is being restarted; dropping the
+            // last frame then lets the old pipeline's buffers go
+            FrameRef frame = gst->captureFrame();
             {
                 std::lock_guard<std::mutex> lock(frameMutex);
-                latestFrame = frame.clone();
+                latestFrame = frame;
             }
 
             std::vector<YoloDetection> detectionsCopy;
@@ -128,11 +277,16 @@ int main()
             currentTime = static_cast<float>(cv::getTickCount()) / cv::getTickFrequency() * 1000.0f;
             if (currentTime >= endTime)
             {
-                gst->stopRecording(uploadToMongoDB);
-                gst->startRecordingDateTime();
+                // Next file starts at the current GOP; capture and the encoder keep running
+                gst->rotateRecording();
 
                 metricTracker->EndMetric();
                 std::time_t t = std::time(0);
+                if (uploadToMongoDB)
+                {
+                    // The previous wall-clock hour is complete now; the current one goes up partial
+                    metricTracker->QueueHourlyUploads(t - 3600, t);
+                }
                 std::tm tm = *std::localtime(&t);
                 if (tm.tm_hour == 0)
                 {
@@ -140,7 +294,9 @@ int main()
                     metricTracker->WriteDateTime(uploadToMongoDB);
                     metricTracker->ResetMetrics();
 
-                    model->resetTracks();
+                    // Cleared by the detection thread before its next frame
+                    model->requestTrackReset();
+                    countingEngine.Reset();
                 }
                 metricTracker->NewMetric();
 
@@ -148,6 +304,20 @@ int main()
             }
 
 #ifndef NDEBUG
+            if (!frame)
+            {
+                if (cv::waitKey(1) == 27)
+                    break; // ESC to exit
+                continue;
+            }
+            // Draw on a converted copy: the captured frame is YUV and shared with the detector
+            cv::Mat display;
+            if (frame->format == PixelFormat::NV12)
+                cv::cvtColor(frame->image, display, cv::COLOR_YUV2BGR_NV12);
+            else if (frame->format == PixelFormat::I420)
+                cv::cvtColor(frame->image, display, cv::COLOR_YUV2BGR_I420);
+            else
+                display = frame->image.clone();
 //             for (const auto &det : detectionsCopy)
 //             {
 //                 if (det.score < 0.3f)
@@ -159,9 +329,9 @@ int main()
 //                             cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 0), 2);
 //             }
 
-            cv::putText(frame, std::to_string(metricTracker->GetCurrentCount()), cv::Point(10, 30),
+            cv::putText(display, std::to_string(metricTracker->GetCurrentCount()), cv::Point(10, 30),
                         cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 255, 0), 2);
-            cv::imshow("camera", frame);
+            cv::imshow("camera", display);
             if (cv::waitKey(1) == 27)
                 break; // ESC to exit
 #else
@@ -177,10 +347,25 @@ int main()
 
         metricTracker->EndMetric();
         metricTracker->WriteDateTime(uploadToMongoDB);
+        if (uploadToMongoDB)
+        {
+            std::time_t now = std::time(0);
+            metricTracker->QueueHourlyUploads(now - 3600, now);
+        }
 
-        gst->stopRecording(uploadToMongoDB);
+        gst->stopRecording();
         running.store(false);
         detectThread.join();
+        liveStats.Stop();
+
+        // Only a short grace period: unfinished jobs are in the journal and resume
+        // on the next start, and a long wait would outlast the service stop timeout
+        if (!UploadQueue::GetInstance().WaitIdle(std::chrono::seconds(5)))
+        {
+            std::cerr << "Uploads still pending at exit; they will resume on next start.\n";
+        }
+        SpoolManager::GetInstance().Stop();
+        UploadQueue::GetInstance().Stop();
 
         return 0;
     }